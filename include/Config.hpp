@@ -33,15 +33,60 @@ public:
     uint16_t getPort() const { return port_; }
 
     /**
-     * @return Server name used in HTTP headers
+     * @return Path of the unix domain socket the server listens on, empty when it listens on a TCP port
      */
-    const std::string& getServerName() const { return server_name_; }
+    const std::string& getListenUnix() const { return listen_unix_; }
+
+    /**
+     * @return Permission bits of the unix domain socket
+     */
+    uint32_t getListenUnixMode() const { return listen_unix_mode_; }
+
+    /**
+     * @return Length of the accept queue of the listening socket, 0 for the system maximum (SOMAXCONN)
+     */
+    uint64_t getListenBacklog() const { return listen_backlog_; }
+
+    /**
+     * @return true if clients are only accepted once their first request bytes arrived (TCP_DEFER_ACCEPT)
+     */
+    bool getDeferredAccept() const { return deferred_accept_; }
+
+    /**
+     * @return Length of the TCP Fast Open queue of the listening socket, 0 if Fast Open is off
+     */
+    uint64_t getFastOpen() const { return fastopen_; }
+
+    /**
+     * @return true if the listening socket is bound with SO_REUSEPORT even with a single worker
+     */
+    bool getReusePort() const { return reuseport_; }
+
+    /**
+     * @return true if this block answers the requests on its port whose Host matches no server name
+     */
+    bool getDefaultServer() const { return default_server_; }
+
+    /**
+     * @return First server name, used in HTTP headers and as the address to bind to
+     */
+    const std::string& getServerName() const { return server_names_.front(); }
+
+    /**
+     * @return All server names, matched against the Host header of a request
+     */
+    const std::vector<std::string>& getServerNames() const { return server_names_; }
 
     /**
      * @return Root directory for serving files
      */
     const std::string& getRoot() const { return root_; }
 
+    /**
+     * @return Bundle packed from the root with webserv --pack that static files are served from, empty if none
+     */
+    const std::string& getBundle() const { return bundle_; }
+
     /**
      * @return Default index file when requesting a directory
      */
@@ -62,16 +107,170 @@ public:
      */
     const std::vector<std::shared_ptr<Location>>& getLocations() const { return locations_; }
 
+    /**
+     * @return Seconds an idle keep-alive connection is kept open (0 disables keep-alive)
+     */
+    uint64_t getKeepaliveTimeout() const { return keepalive_timeout_; }
+
+    /**
+     * @return Maximum number of requests served over one keep-alive connection
+     */
+    uint64_t getKeepaliveRequests() const { return keepalive_requests_; }
+
+    /**
+     * @return Seconds a client gets to send its request header
+     */
+    uint64_t getClientHeaderTimeout() const { return client_header_timeout_; }
+
+    /**
+     * @return Seconds a client may stay silent while sending its request body
+     */
+    uint64_t getClientBodyTimeout() const { return client_body_timeout_; }
+
+    /**
+     * @return Seconds the server gets to build and send a response
+     */
+    uint64_t getSendTimeout() const { return send_timeout_; }
+
+    /**
+     * @return Maximum number of clients connected to this server block at once, 0 for no limit
+     */
+    uint64_t getMaxConnections() const { return max_connections_; }
+
+    /**
+     * @return Bytes a client reads or sends per turn of the event loop before the other clients get theirs, 0 for no limit
+     */
+    uint64_t getIoQuantum() const { return io_quantum_; }
+
+    /**
+     * @return true if static files are send with sendfile() instead of through a buffer
+     */
+    bool getSendfile() const { return sendfile_; }
+
+    /**
+     * @return Bytes of a file sendfile() sends per turn of the event loop, 0 for no limit
+     */
+    uint64_t getSendfileMaxChunk() const { return sendfile_max_chunk_; }
+
+    /**
+     * @return Maximum number of paths whose metadata and fd stay cached per worker, 0 if the open file cache is off
+     */
+    uint64_t getOpenFileCacheMax() const { return open_file_cache_max_; }
+
+    /**
+     * @return Seconds a cached path stays in the open file cache without being used
+     */
+    uint64_t getOpenFileCacheInactive() const { return open_file_cache_inactive_; }
+
+    /**
+     * @return Seconds a cached path is trusted before it is checked on disk again
+     */
+    uint64_t getOpenFileCacheValid() const { return open_file_cache_valid_; }
+
+    /**
+     * @return true if paths that do not exist are cached as well
+     */
+    bool getOpenFileCacheErrors() const { return open_file_cache_errors_; }
+
+    /**
+     * @return Maximum number of clients connected to the whole process at once, 0 for no limit (main context)
+     */
+    uint64_t getGlobalMaxConnections() const { return global_max_connections_; }
+
+    /**
+     * @return Number of event loop threads (main context, same for every server block)
+     */
+    uint64_t getWorkerThreads() const { return worker_threads_; }
+
+    /**
+     * @return Number of worker processes started by a master process, 0 to serve from a single process (main context)
+     */
+    uint64_t getWorkerProcesses() const { return worker_processes_; }
+
+    /**
+     * @return Number of threads that take blocking file system calls off the event loops, 0 if none (main context)
+     */
+    uint64_t getAioThreads() const { return aio_threads_; }
+
+    /**
+     * @return Bytes of file contents every worker keeps in memory, 0 if the content cache is off (main context)
+     */
+    uint64_t getContentCacheSize() const { return content_cache_size_; }
+
+    /**
+     * @return Largest file the content cache keeps, larger ones are sent from disk (main context)
+     */
+    uint64_t getContentCacheMaxFile() const { return content_cache_max_file_; }
+
+    /**
+     * @return true if every worker thread is pinned to its own CPU (main context)
+     */
+    bool getWorkerCpuAffinity() const { return worker_cpu_affinity_; }
+
+    /**
+     * @return true if sockets are registered edge-triggered instead of level-triggered (main context)
+     */
+    bool getEdgeTriggered() const { return edge_triggered_; }
+
+    /**
+     * @return true if the event loop uses io_uring instead of epoll when the kernel supports it (main context)
+     */
+    bool getIoUring() const { return io_uring_; }
+
+    /**
+     * @return Microseconds the kernel busy polls the device queue of a client socket, 0 if off (main context)
+     */
+    uint64_t getBusyPoll() const { return busy_poll_; }
+
+    /**
+     * @return Microseconds the event loop spins on empty polls before it sleeps, 0 if off (main context)
+     */
+    uint64_t getBusyPollSpin() const { return busy_poll_spin_; }
+
 private:
     // Only ConfigBuilder can modify the configuration to ensure consistency
     friend class ConfigBuilder;
 
     // Server settings with sensible defaults
     uint16_t port_ = 9999;                      // Default port for development
-    std::string server_name_ = "localhost";      // Default server name
+    std::string listen_unix_;                   // TCP unless a unix socket path is set
+    uint32_t listen_unix_mode_ = 0666;          // Any local user can connect to a unix socket
+    uint64_t listen_backlog_ = 0;               // System maximum accept queue
+    bool deferred_accept_ = false;              // Accept as soon as the handshake is done
+    uint64_t fastopen_ = 0;                     // No TCP Fast Open by default
+    bool reuseport_ = false;                    // SO_REUSEPORT only with multiple workers
+    bool default_server_ = false;               // First block on a port is the default
+    std::vector<std::string> server_names_ = {"localhost"}; // Default server name
     std::string root_ = "/";                     // Root directory
+    std::string bundle_;                        // Static files come from the root on disk by default
     std::string index_ = "index.html";           // Standard index filename
     uint64_t client_max_body_size_ = 1024*1024; // 1MB default body size limit
+    uint64_t keepalive_timeout_ = 15;           // Idle keep-alive timeout in seconds
+    uint64_t keepalive_requests_ = 100;         // Requests per keep-alive connection
+    uint64_t client_header_timeout_ = 20;       // Request header timeout in seconds
+    uint64_t client_body_timeout_ = 60;         // Timeout between two reads of the body in seconds
+    uint64_t send_timeout_ = 20;                // Response timeout in seconds
+    uint64_t max_connections_ = 0;              // No limit per server block by default
+    uint64_t io_quantum_ = 256 * 1024;          // Bytes per client per turn of the event loop
+    bool sendfile_ = false;                     // Files go through a buffer by default
+    uint64_t sendfile_max_chunk_ = 2 * 1024 * 1024; // Bytes per sendfile() turn
+    uint64_t open_file_cache_max_ = 0;          // No open file cache by default
+    uint64_t open_file_cache_inactive_ = 60;    // Unused cache entries are dropped after a minute
+    uint64_t open_file_cache_valid_ = 60;       // Cache entries are checked on disk every minute
+    bool open_file_cache_errors_ = false;       // Missing paths are looked up every time by default
+
+    // Process wide settings from the main context
+    uint64_t worker_threads_ = 1;               // Single event loop by default
+    uint64_t worker_processes_ = 0;             // No master process by default
+    uint64_t aio_threads_ = 0;                  // File system calls on the event loop by default
+    uint64_t content_cache_size_ = 0;           // Files are read from disk for every response by default
+    uint64_t content_cache_max_file_ = 64 * 1024; // Only small files are kept in memory
+    bool worker_cpu_affinity_ = false;          // Let the scheduler place workers
+    bool edge_triggered_ = false;               // Level-triggered epoll by default
+    bool io_uring_ = false;                     // epoll event backend by default
+    uint64_t busy_poll_ = 0;                    // No socket busy polling by default
+    uint64_t busy_poll_spin_ = 0;               // Sleep in the event wait right away by default
+    uint64_t global_max_connections_ = 0;       // No process wide connection limit by default
 
     // Custom error pages mapping (code -> page path)
     std::map<uint16_t, std::string> error_pages_;
@@ -2,8 +2,10 @@
 # define SERVER_HPP
 
 # define MAX_EVENTS 1024
-# define TIMEOUT_MS 20000 // 20 seconds
 # define EPOLL_WAIT_TIME 10000 // 10 seconds
+# define ADMISSION_RETRY_MS 100 // how often paused listeners check for room
+# define CLIENT_HANGUP (EPOLLHUP | EPOLLERR) // the connection is gone, a EPOLLRDHUP alone is a client that still reads
+# define SERVICE_UNAVAILABLE "HTTP/1.1 503 Service Unavailable\r\nConnection: close\r\nRetry-After: 1\r\nContent-Length: 0\r\n\r\n"
 
 # include "Config.hpp"
 # include <string>
@@ -11,10 +13,24 @@
 # include "config/Location.hpp"
 # include <map>
 # include <cstdint>
+# include <atomic>
 # include "server/ServerValidator.hpp"
 # include "server/ServerRequestHandler.hpp"
 # include "server/ServerResponseHandler.hpp"
+# include "server/ServerConnectionTable.hpp"
+# include "server/ServerTimerWheel.hpp"
+# include "server/ServerIoUring.hpp"
+# include "server/ServerAdmission.hpp"
+# include "server/ServerReload.hpp"
+# include "server/ServerVirtualHosts.hpp"
+# include "server/ServerListenFds.hpp"
+# include "server/ServerUpgrade.hpp"
+# include "server/ServerCoroutine.hpp"
+# include "server/ServerCounters.hpp"
+# include "server/ServerAio.hpp"
+# include "server/ServerContentCache.hpp"
 # include <arpa/inet.h>
+# include <sys/un.h>
 
 struct configInfo
 {
@@ -26,43 +42,142 @@ struct configInfo
     std::string main_index_;
     std::vector<std::shared_ptr<Location>> locations_;
     std::map<uint16_t, std::string> error_pages_;
-    int server_fd_;
-    std::string server_name_;
-    uint16_t port_;
+    int server_fd_; // only the server block that owns the listener of a port has one, the others keep -1
+    std::string server_name_; // the address the listener is bound to, "unix:" and the path for a unix socket
+    uint16_t port_; // 0 for a unix socket
+    size_t index_;
+    bool paused_;
+    bool inherited_; // the listening socket is held by the listen fds, from socket activation or shared between the workers
+    std::shared_ptr<ServerVirtualHosts> hosts_; // the server names of every server block on the port of the listener
 };
 
-class Server
+/**
+ * @brief the server blocks of one config generation in a worker.
+ * The listeners always belong to the newest generation,
+ * every client holds the generation it was accepted in until it closes
+ */
+struct serverGeneration
+{
+    std::shared_ptr<const s_config_generation> config_;
+    std::vector<configInfo> servers_;
+};
+
+class Server : public ServerScheduler
 {
     public:
-        Server(std::vector<std::shared_ptr<Config>>& config);
+        Server(ServerReload& reload, ServerListenFds& listen_fds, ServerUpgrade& upgrade, ServerAioPool& aio, s_worker_counters& counters, size_t worker_id = 0);
         ~Server();
         int setupEpoll();
         int serverLoop();
+        void shareListeners();
+        void stop();
+        int watch(int owner_fd, int fd, uint32_t events, uint64_t timeout_ms, ServerAwait* await) override;
+        void unwatch(int fd) override;
+        bool offloading() const override;
+        int offload(s_aio_job* job) override;
+        void cancelOffload(s_aio_job* job) override;
+        ServerContentCache* contentCache() override;
     protected:
     private:
-        std::vector<configInfo> config_info_;
-        size_t conf_size_;
+        std::shared_ptr<serverGeneration> generation_;
+        ServerReload& reload_;
+        ServerListenFds& listen_fds_;
+        ServerUpgrade& upgrade_;
+        ServerAioPool& aio_;
+        s_worker_counters& counters_;
+        size_t worker_id_;
+        bool reuse_port_;
+        uint32_t trigger_mode_;
         ServerValidator validator_;
         int epoll_fd_;
         int stdout_pipe_[2];
         int stderr_pipe_[2];
-        std::unordered_map<int, int> client_timers_;
-
+        ServerConnectionTable connections_;
+        ServerTimerWheel timers_;
+        ServerIoUring uring_;
+        ServerAioQueue aio_done_; // the finished jobs of the aio threads for this worker
+        std::unique_ptr<ServerContentCache> content_cache_; // nullptr when content_cache is off or inotify is not available
+        size_t paused_listeners_;
+        int spare_fd_;
+        uint64_t fd_retry_at_;
+        int signal_fd_;
+        int wake_fd_;
+        uint64_t busy_poll_;
+        uint64_t spin_budget_us_;
+        uint64_t spin_hits_;
+        uint64_t spin_misses_;
+        size_t clients_;
+        bool draining_; // a upgrade took over, no new clients are accepted
+        bool accepting_;
+        bool drained_; // every client is finished after a upgrade
+        std::atomic<bool> stopping_; // the first worker stopped, the process exits
+        std::vector<epoll_event> run_queue_; // clients that used up their quantum, they go on in the next round
+        std::vector<epoll_event> run_turn_; // the run queue taken at the start of the round that is running
+        uint64_t run_round_; // counts the turns of the event loop
+        std::vector<std::pair<int, configInfo*>> stopped_listeners_; // closed by a upgrade, late io_uring accepts still land on them
 
-        int createServerSocket(std::string& server_name, uint16_t port, int& server_fd);
+        int createServerSocket(configInfo& config);
+        int createUnixSocket(configInfo& config);
+        bool isStaleUnixSocket(const sockaddr_un& server_addr);
+        void setListenOptions(configInfo& config);
         sockaddr_in setServerAddr(std::string& server_name, uint16_t port);
-        int bindServerSocket(sockaddr_in& server_addr, int server_fd);
-        int listenServer(int server_fd);
+        int bindServerSocket(const sockaddr* server_addr, socklen_t len, int server_fd);
+        int listenServer(int server_fd, uint64_t backlog);
         void setNonBlocking(int fd);
         int doEpollCtl(int mode, int fd, epoll_event* event);
         int setupPipe();
         int putCoutCerrInEpoll();
+        int setupReload();
+        int setupAio();
+        int setupContentCache();
+        std::shared_ptr<serverGeneration> makeGeneration(const std::shared_ptr<const s_config_generation>& config);
+        void adoptListener(configInfo& config);
+        void closeListeners();
+        size_t findListener(const std::vector<configInfo>& servers, const configInfo& config);
+        bool sameListen(const configInfo& first, const configInfo& second);
+        void setupVirtualHosts(std::vector<configInfo>& servers, configInfo& listener);
+        int watchListener(configInfo& config);
+        void setPipes(configInfo& config);
+        int handleSignal();
+        int handleWake();
+        int switchGeneration();
+        void closeIdleClients();
+        int startUpgrade();
+        int handleUpgrade(int status_fd);
+        bool drainWorker();
+        void stopListening();
+        void acceptBacklog(configInfo& config);
         int listenLoop();
+        int waitEvents(epoll_event events[], int timeout);
+        int pollEvents(epoll_event events[], int timeout);
+        void setupBusyPoll();
+        void setBusyPoll(int client_fd);
+        void logSpinCounters();
         int checkEvents(epoll_event event);
         int setupConnection(int server_fd, configInfo& config);
-        int setTimer(int client_fd);
-        int checkForTimeout(int fd, epoll_event& event);
-        int handleReadEvents(int fd, epoll_event& event);
+        int addClient(int client_fd, configInfo& config);
+        int acceptClients();
+        configInfo* acceptedOn(int listener_fd);
+        void pauseListener(configInfo& config);
+        void resumeListeners();
+        void shedConnection(int server_fd);
+        void rejectClient(int client_fd);
+        void closeClient(int fd);
+        int halfCloseClient(int fd, s_connection& conn, epoll_event& event);
+        uint32_t hangupEvents(const s_client_data& data);
+        int keepAliveClient(int fd, s_connection& conn, epoll_event& event);
+        int handleTimeout(int client_fd);
+        int resumeAwait(int fd, uint32_t events);
+        int resumeClient(int client_fd);
+        int handleAio();
+        ServerTask readFile(s_client_data& data);
+        uint64_t quantumOf(s_connection& conn);
+        void yieldClient(int fd, s_connection& conn, uint32_t events);
+        int runYielded();
+        int handleReadEvents(int fd, s_connection& conn, epoll_event& event);
+        int handleWriteEvents(int fd, s_connection& conn, epoll_event& event);
+        int flushClient(int fd, s_connection& conn, epoll_event& event);
+        configInfo& hostOf(s_connection& conn);
         std::string epollEventToString(uint32_t events);
         std::string getFdType(int fd);
 };
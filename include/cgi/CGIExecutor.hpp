@@ -4,6 +4,9 @@
 #include <string>
 #include <map>
 #include <vector>
+#include <sys/types.h>
+
+#define CGI_TIMEOUT_MS 20000 // 20 seconds
 
 /**
  * @brief CGI exit status enum
@@ -12,42 +15,94 @@ enum class CGIExitStatus {
     Success = 0,
     Timeout = -2,
     Error = -1,
-    KilledBySignal = -3
+    KilledBySignal = -3,
+    Running = -4
 };
 
 /**
  * @brief Handles CGI script execution and I/O management
- * 
+ *
  * This class is responsible for:
  * - Executing CGI scripts using fork and execve
- * - Managing pipes for script I/O
+ * - Managing non-blocking pipes for script I/O
  * - Setting up environment variables
+ * - Killing a script that is still running when the executor is destroyed,
+ *   together with the processes it started, the script leads its own process group
+ *
+ * The caller waits for the pipes and the exit of the script in its event loop,
+ * nothing in here blocks
  */
 class CGIExecutor {
 public:
-    CGIExecutor() = default;
-    ~CGIExecutor() = default;
+    CGIExecutor();
+    ~CGIExecutor();
+    CGIExecutor(const CGIExecutor& other) = delete;
+    CGIExecutor& operator=(const CGIExecutor& other) = delete;
 
     /**
-     * @brief Execute a CGI script
+     * @brief Start a CGI script
      * @param interpreter Path to the script interpreter (e.g., /usr/bin/python3)
      * @param script_path Path to the CGI script
-     * @param request_body Data to pass to script
      * @param env_vars Environment variables for the script
-     * @return Pair of {exit_code, output}
      * @throw std::runtime_error on execution failure
      */
-    std::pair<int, std::string> execute(
+    void start(
         const std::string& interpreter,
         const std::string& script_path,
-        const std::string& request_body,
         const std::map<std::string, std::string>& env_vars);
 
+    /**
+     * @return Write end of the standard input of the script, -1 once it is closed
+     */
+    int inputFd() const { return input_pipe_[1]; }
+
+    /**
+     * @return Read end of the standard output of the script
+     */
+    int outputFd() const { return output_pipe_[0]; }
+
+    /**
+     * @return Read end of the standard error of the script, -1 once it reached its end
+     */
+    int errorFd() const { return error_pipe_[0]; }
+
+    /**
+     * @return pidfd that becomes readable when the script exits, -1 if the kernel has no pidfd
+     */
+    int exitFd() const { return pidfd_; }
+
+    /**
+     * @brief Close the standard input of the script, it sees the end of the request body
+     */
+    void closeInput();
+
+    /**
+     * @brief Read what the script has written to its standard output so far
+     * @param output String the output is appended to
+     * @return Bytes read, 0 at the end of the output, -1 if nothing is there yet
+     */
+    ssize_t readOutput(std::string& output);
+
+    /**
+     * @brief Read what the script has written to its standard error so far, the pipe is closed at its end
+     * @param error String the errors are appended to
+     */
+    void readError(std::string& error);
+
+    /**
+     * @brief Collect the exit status of the script
+     * @param wait true to block until the script exits
+     * @return Exit code, or CGIExitStatus::Running if it has not exited
+     */
+    int reap(bool wait);
+
 private:
     // Pipe management
     int input_pipe_[2];   // For writing to script
     int output_pipe_[2];  // For reading from script
     int error_pipe_[2];   // For errors from script
+    pid_t pid_;
+    int pidfd_;
 
     /**
      * @brief Set up pipes for communication with CGI script
@@ -67,27 +122,6 @@ private:
      */
     std::vector<std::string> prepareEnvironment(
         const std::map<std::string, std::string>& env_vars) const;
-
-    /**
-     * @brief Read output from CGI script
-     * @return Script's output as string
-     */
-    std::string readOutput();
-
-    /**
-     * @brief Wait for child process to finish with timeout handling
-     * 
-     * @param pid PID of CGI child process
-     * @return int exit_code
-     */
-    int wait_for_child_with_timeout(pid_t pid);
-
-    /**
-     * @brief Read the error messeges from the CGI script
-     * 
-     * @return Script's error as string
-     */
-    std::string readError();
 };
 
-#endif // CGI_EXECUTOR_HPP
\ No newline at end of file
+#endif // CGI_EXECUTOR_HPP
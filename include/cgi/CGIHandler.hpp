@@ -26,17 +26,16 @@ public:
     ~CGIHandler() = default;
 
     /**
-     * @brief Process a CGI request
+     * @brief Start the script of a CGI request, its pipes are read and written through executor()
      * @param script_path Path to the CGI script
      * @param request_method HTTP method (GET/POST)
      * @param request_body Request body data (for POST)
      * @param query_string Query string from URL (for GET)
      * @param server_name Server's hostname
      * @param server_port Server's port
-     * @return Pair of {status_code, response_content}
      * @throw std::runtime_error on processing failure
      */
-    std::pair<int, std::string> handleRequest(
+    void start(
         const std::string& script_path,
         const std::string& request_method,
         const std::string& request_body,
@@ -44,6 +43,11 @@ public:
         const std::string& server_name,
         uint16_t server_port);
 
+    /**
+     * @return The executor running the script
+     */
+    CGIExecutor& executor() { return executor_; }
+
 private:
     CGIExecutor executor_;
     const Location& location_;
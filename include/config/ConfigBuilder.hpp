@@ -20,6 +20,12 @@ class ConfigBuilder {
 public:
     ConfigBuilder();
 
+    /**
+     * @brief Creates a builder that modifies an already built configuration
+     * @param config Configuration to modify
+     */
+    explicit ConfigBuilder(std::shared_ptr<Config> config);
+
     // Server configuration methods
     /**
      * @brief Sets the port number for the server
@@ -30,11 +36,60 @@ public:
     ConfigBuilder& setPort(uint16_t port);
 
     /**
-     * @brief Sets the server name for HTTP headers
-     * @param name Server name
+     * @brief Makes the server listen on a unix domain socket instead of a TCP port
+     * @param path Path of the socket file
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setListenUnix(const std::string& path);
+
+    /**
+     * @brief Sets the permission bits of the unix domain socket
+     * @param mode Permission bits, like 0660
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setListenUnixMode(uint32_t mode);
+
+    /**
+     * @brief Sets the length of the accept queue of the listening socket
+     * @param backlog Queue length, 0 for the system maximum
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setListenBacklog(uint64_t backlog);
+
+    /**
+     * @brief Enables accepting clients only once their first request bytes arrived
+     * @param enabled true to set TCP_DEFER_ACCEPT on the listening socket
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setDeferredAccept(bool enabled);
+
+    /**
+     * @brief Sets the TCP Fast Open queue length of the listening socket
+     * @param queue Queue length, 0 turns Fast Open off
      * @return Reference to this builder for method chaining
      */
-    ConfigBuilder& setServerName(const std::string& name);
+    ConfigBuilder& setFastOpen(uint64_t queue);
+
+    /**
+     * @brief Enables SO_REUSEPORT on the listening socket with a single worker
+     * @param enabled true to set SO_REUSEPORT
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setReusePort(bool enabled);
+
+    /**
+     * @brief Makes this block the default server of its port
+     * @param enabled true to answer requests whose Host matches no server name
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setDefaultServer(bool enabled);
+
+    /**
+     * @brief Sets the server names matched against the Host header
+     * @param names Exact names or names with a leading or trailing wildcard
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setServerNames(const std::vector<std::string>& names);
 
     /**
      * @brief Sets the root directory for serving files
@@ -43,6 +98,13 @@ public:
      */
     ConfigBuilder& setRoot(const std::string& root);
 
+    /**
+     * @brief Sets the bundle static files are served from
+     * @param bundle Bundle file path
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setBundle(const std::string& bundle);
+
     /**
      * @brief Sets the default index file
      * @param index Index filename
@@ -66,6 +128,176 @@ public:
      */
     ConfigBuilder& addErrorPage(uint16_t code, const std::string& page);
 
+    /**
+     * @brief Sets how long an idle keep-alive connection stays open
+     * @param seconds Timeout in seconds, 0 disables keep-alive
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setKeepaliveTimeout(uint64_t seconds);
+
+    /**
+     * @brief Sets the maximum number of requests per keep-alive connection
+     * @param requests Request cap, 0 disables keep-alive
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setKeepaliveRequests(uint64_t requests);
+
+    /**
+     * @brief Sets how many bytes a client reads or sends per turn of the event loop
+     * @param bytes Quantum in bytes, 0 lets a client run until its socket would block
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setIoQuantum(uint64_t bytes);
+
+    /**
+     * @brief Enables/disables sending static files with sendfile()
+     * @param enabled Whether sendfile() is used
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setSendfile(bool enabled);
+
+    /**
+     * @brief Sets how many bytes of a file sendfile() sends per turn of the event loop
+     * @param bytes Limit in bytes, 0 for no limit
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setSendfileMaxChunk(uint64_t bytes);
+
+    /**
+     * @brief Sets the size of the open file cache and how long unused entries stay in it
+     * @param max Number of cached paths, 0 turns the cache off
+     * @param inactive Seconds an entry stays without being used
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setOpenFileCache(uint64_t max, uint64_t inactive);
+
+    /**
+     * @brief Sets how long a cached path is trusted before it is checked on disk again
+     * @param seconds Validity in seconds
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setOpenFileCacheValid(uint64_t seconds);
+
+    /**
+     * @brief Enables/disables caching paths that do not exist
+     * @param enabled Whether missing paths are cached
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setOpenFileCacheErrors(bool enabled);
+
+    /**
+     * @brief Sets how long a client gets to send its request header
+     * @param seconds Timeout in seconds
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setClientHeaderTimeout(uint64_t seconds);
+
+    /**
+     * @brief Sets how long a client may stay silent while sending its request body
+     * @param seconds Timeout in seconds
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setClientBodyTimeout(uint64_t seconds);
+
+    /**
+     * @brief Sets how long the server gets to build and send a response
+     * @param seconds Timeout in seconds
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setSendTimeout(uint64_t seconds);
+
+    // Main context configuration methods
+    /**
+     * @brief Sets the number of event loop threads
+     * @param threads Number of worker threads
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setWorkerThreads(uint64_t threads);
+
+    /**
+     * @brief Sets the number of worker processes a master process starts
+     * @param processes Number of worker processes, 0 for a single process
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setWorkerProcesses(uint64_t processes);
+
+    /**
+     * @brief Sets the number of threads that run the blocking file system calls of the workers
+     * @param threads Number of aio threads, 0 to run them on the event loops
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setAioThreads(uint64_t threads);
+
+    /**
+     * @brief Sets how many bytes of file contents every worker keeps in memory
+     * @param bytes Size of the content cache, 0 turns it off
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setContentCacheSize(uint64_t bytes);
+
+    /**
+     * @brief Sets the largest file the content cache keeps
+     * @param bytes Size limit of a cached file
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setContentCacheMaxFile(uint64_t bytes);
+
+    /**
+     * @brief Enables/disables pinning every worker thread to its own CPU
+     * @param enabled Whether workers are pinned
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setWorkerCpuAffinity(bool enabled);
+
+    /**
+     * @brief Selects edge-triggered or level-triggered epoll registration
+     * @param enabled Whether sockets are registered edge-triggered
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setEdgeTriggered(bool enabled);
+
+    /**
+     * @brief Selects io_uring or epoll as the event backend
+     * @param enabled Whether io_uring is used
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setIoUring(bool enabled);
+
+    /**
+     * @brief Sets the maximum number of clients connected to this server block at once
+     * @param connections Connection limit, 0 for no limit
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setMaxConnections(uint64_t connections);
+
+    /**
+     * @brief Sets the maximum number of clients connected to the whole process at once
+     * @param connections Connection limit, 0 for no limit
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setGlobalMaxConnections(uint64_t connections);
+
+    /**
+     * @brief Sets the busy poll time of client sockets (SO_BUSY_POLL, SO_PREFER_BUSY_POLL)
+     * @param usecs Microseconds, 0 turns busy polling off
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setBusyPoll(uint64_t usecs);
+
+    /**
+     * @brief Sets how long the event loop spins on empty polls before it sleeps
+     * @param usecs Microseconds, 0 turns spinning off
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& setBusyPollSpin(uint64_t usecs);
+
+    /**
+     * @brief Copies the process wide settings of the main context into this configuration
+     * @param main Configuration holding the main context settings
+     * @return Reference to this builder for method chaining
+     */
+    ConfigBuilder& inheritMain(const Config& main);
+
     // Location configuration methods
     /**
      * @brief Starts a new location block configuration
@@ -109,6 +341,13 @@ public:
      */
     void setLocationAutoindex(bool enabled);
 
+    /**
+     * @brief Sets the quantum multiplier of responses from current location
+     * @param weight Multiplier of the io_quantum of the server
+     * @throws std::runtime_error if no location is being configured
+     */
+    void setLocationWeight(uint64_t weight);
+
     /**
      * @brief Configures a redirect for current location
      * @param code HTTP redirect code (301, 302, 303, 307, 308)
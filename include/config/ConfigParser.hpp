@@ -70,6 +70,13 @@ private:
     // Main parsing methods
     std::vector<std::shared_ptr<Config>> parseConfigs();
     std::shared_ptr<Config> parseServerBlock();
+
+    /**
+     * @brief Parses a directive outside of the server blocks
+     * @param builder Builder holding the process wide settings
+     * @throws ParseError on unknown or invalid main directives
+     */
+    void parseMainDirective(ConfigBuilder& builder);
     void parseServerBlockContent(ConfigBuilder& builder);
 
     /**
@@ -101,6 +108,7 @@ private:
     void parseServerDirective(ConfigBuilder& builder, const std::string& directive);
     void parseServerListen(ConfigBuilder& builder);
     void parseServerName(ConfigBuilder& builder);
+    void parseServerOpenFileCache(ConfigBuilder& builder);
     void parseServerRoot(ConfigBuilder& builder);
     void parseServerIndex(ConfigBuilder& builder);
     void parseServerBodySize(ConfigBuilder& builder);
@@ -20,16 +20,25 @@ public:
     // Constants for validation
     static constexpr size_t MAX_BODY_SIZE = 1024 * 1024 * 1024; // 1GB
     static constexpr size_t MAX_PATH_LENGTH = 4096;
+    static constexpr size_t MAX_UNIX_PATH_LENGTH = 107; // sun_path without the terminating null
+    static constexpr uint64_t MAX_TIMEOUT = 3600; // 1 hour
+    static constexpr uint64_t MAX_WORKER_THREADS = 256;
+    static constexpr uint64_t MAX_WORKER_PROCESSES = 256;
+    static constexpr uint64_t MAX_AIO_THREADS = 256;
+    static constexpr uint64_t MAX_LOCATION_WEIGHT = 64;
+    static constexpr uint64_t MAX_BUSY_POLL = 1000000; // 1 second in microseconds
+    static constexpr uint64_t MAX_OPEN_FILE_CACHE = 65536; // every cached file holds a fd
+    static constexpr uint64_t MAX_CONTENT_CACHE = 1024ULL * 1024 * 1024; // 1GB per worker
 
     // Main validation methods
     static void validate(const Config& config);
-    static void validateConfigs(const std::vector<std::unique_ptr<Config>>& configs);
+    static void validateConfigs(const std::vector<std::shared_ptr<Config>>& configs);
 
 private:
     ConfigValidator() = delete;  // Static class
 
     // Multi-server validation
-    static void validateNoDuplicatePorts(const std::vector<std::unique_ptr<Config>>& configs);
+    static void validateVirtualHosts(const std::vector<std::shared_ptr<Config>>& configs);
 
     // Path validation
     static void validatePath(const std::string& path, const std::string& context);
@@ -39,11 +48,20 @@ private:
 
     // HTTP validation
     static void validatePort(uint16_t port);
+    static void validateListenUnix(const Config& config);
     static void validateMethod(const std::string& method);
     static void validateMethods(const std::vector<std::string>& methods);
     static void validateErrorCode(uint16_t code);
     static void validateServerName(const std::string& name);
     static void validateClientMaxBodySize(uint64_t size);
+    static void validateKeepaliveTimeout(uint64_t seconds);
+    static void validateTimeout(uint64_t seconds, const std::string& context);
+    static void validateWorkerThreads(uint64_t threads);
+    static void validateWorkerProcesses(uint64_t processes);
+    static void validateAioThreads(uint64_t threads);
+    static void validateBusyPoll(uint64_t usecs, const std::string& context);
+    static void validateOpenFileCache(const Config& config);
+    static void validateContentCache(const Config& config);
 
     // Return directive validation
     static void validateReturnDirective(const Location::ReturnDirective& ret, const std::string& context);
@@ -65,7 +83,7 @@ private:
 // Define static regex patterns
 inline const std::regex ConfigValidator::path_pattern_("^[/a-zA-Z0-9._-]+$");
 inline const std::regex ConfigValidator::filename_pattern_("^[a-zA-Z0-9._-]+$");
-inline const std::regex ConfigValidator::server_name_pattern_("^[a-zA-Z0-9.-]+$");
+inline const std::regex ConfigValidator::server_name_pattern_("^(\\*\\.)?[a-zA-Z0-9.-]+$|^[a-zA-Z0-9.-]+\\.\\*$");
 
 // Define valid HTTP methods
 inline const std::set<std::string> ConfigValidator::valid_methods_ = {
@@ -5,6 +5,7 @@
 #include <vector>
 #include <optional>
 #include <regex>
+#include <cstdint>
 
 /**
  * @brief Location block configuration for URL-specific behavior
@@ -129,6 +130,11 @@ public:
      */
     bool getAutoindex() const;
 
+    /**
+     * @return Multiplier of the io quantum for responses from this location
+     */
+    uint64_t getWeight() const;
+
     /**
      * @return Return/redirect configuration
      */
@@ -182,6 +188,7 @@ private:
     std::string index_;                             ///< Default index file
     std::vector<std::string> allowed_methods_{"GET"}; ///< Default: GET only
     bool autoindex_ = false;                        ///< Default: directory listing off
+    uint64_t weight_ = 1;                           ///< Default: the io quantum of the server
     ReturnDirective return_directive_;              ///< Return/redirect configuration
     CGIConfig cgi_config_;                          ///< CGI processing settings
     std::regex regex_;                              ///< Compiled regex pattern for regex locations
@@ -0,0 +1,31 @@
+#ifndef SERVER_ADMISSION_HPP
+# define SERVER_ADMISSION_HPP
+
+# include "../Config.hpp"
+# include <atomic>
+# include <memory>
+# include <vector>
+# include <cstdint>
+
+/**
+ * @brief counts the connected clients of the process and of every server block,
+ * shared by all workers so max_connections holds for the process and not per thread.
+ * Every config generation has its own counts per server block,
+ * the count of the process is handed on to the next generation
+ */
+class ServerAdmission
+{
+    public:
+        ServerAdmission(const std::vector<std::shared_ptr<Config>>& configs, const ServerAdmission* previous = nullptr);
+        ~ServerAdmission();
+        bool admit(size_t server);
+        void release(size_t server);
+        bool full(size_t server) const;
+    private:
+        uint64_t max_total_;
+        std::vector<uint64_t> max_server_;
+        std::shared_ptr<std::atomic<uint64_t>> total_;
+        std::unique_ptr<std::atomic<uint64_t>[]> per_server_;
+};
+
+#endif
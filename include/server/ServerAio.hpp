@@ -0,0 +1,79 @@
+#ifndef SERVER_AIO_HPP
+# define SERVER_AIO_HPP
+
+# include <coroutine>
+# include <functional>
+# include <mutex>
+# include <condition_variable>
+# include <deque>
+# include <vector>
+# include <thread>
+# include <cstddef>
+
+class ServerAioQueue;
+
+/**
+ * @brief a blocking filesystem operation of a coroutine, run by a aio thread.
+ * The work only touches data that stays alive while the coroutine waits for it
+ */
+struct s_aio_job
+{
+    std::function<void()> work;
+    std::coroutine_handle<> handle; // the coroutine resumed when the work is done
+    int owner; // the client the coroutine answers
+    bool pending; // handed to the pool and not resumed yet
+    ServerAioQueue* done; // the completions of the worker that submitted it
+};
+
+/**
+ * @brief the finished jobs of one worker. The aio threads push them and write the eventfd,
+ * the worker pops them from its event loop and resumes their coroutines
+ */
+class ServerAioQueue
+{
+    public:
+        ServerAioQueue();
+        ~ServerAioQueue();
+        ServerAioQueue(const ServerAioQueue& other) = delete;
+        ServerAioQueue& operator=(const ServerAioQueue& other) = delete;
+        int setup();
+        int fd() const;
+        void push(s_aio_job* job);
+        s_aio_job* pop();
+        void remove(s_aio_job* job);
+        void clearEvent();
+    private:
+        std::mutex mutex_;
+        std::vector<s_aio_job*> jobs_;
+        int fd_;
+};
+
+/**
+ * @brief the aio threads of the process, shared by every worker.
+ * They take stat, open, opendir and read calls off the event loops,
+ * so a cold disk or a slow network filesystem stalls one request instead of every client of a worker.
+ * Without threads (aio_threads 0) nothing is offloaded and the work runs on the event loop
+ */
+class ServerAioPool
+{
+    public:
+        explicit ServerAioPool(size_t threads);
+        ~ServerAioPool();
+        ServerAioPool(const ServerAioPool& other) = delete;
+        ServerAioPool& operator=(const ServerAioPool& other) = delete;
+        bool active() const;
+        void submit(s_aio_job* job, ServerAioQueue& done);
+        void cancel(s_aio_job* job);
+    private:
+        std::mutex mutex_;
+        std::condition_variable work_ready_;
+        std::condition_variable work_done_;
+        std::deque<s_aio_job*> queue_;
+        std::vector<s_aio_job*> running_;
+        std::vector<std::thread> threads_;
+        bool stopping_;
+
+        void run();
+};
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef SERVER_BUNDLE_HPP
+# define SERVER_BUNDLE_HPP
+
+# include <string>
+# include <memory>
+# include <cstdint>
+# include <cstddef>
+
+# define BUNDLE_MAGIC "WSBNDL01" // the first bytes of a bundle, with the version of the layout
+
+/**
+ * @brief the start of a bundle file. The layout is written and read by the same build on the same host,
+ * so it is in host byte order
+ */
+struct s_bundle_header
+{
+    char magic[8];
+    uint64_t entry_count;
+    uint64_t slot_count; // a power of two, at least twice the entries
+    uint64_t slots_offset; // slot_count indexes into the entries, 0 for a empty slot and entry + 1 otherwise
+    uint64_t entries_offset;
+    uint64_t file_size;
+};
+
+/**
+ * @brief one way to send a file, offsets are from the start of the bundle
+ */
+struct s_bundle_variant
+{
+    uint64_t headers_offset; // the Content-Type, Content-Length and ETag lines and the empty line
+    uint64_t headers_length; // 0 if the variant does not exist
+    uint64_t body_offset;
+    uint64_t body_length;
+    uint64_t etag_offset; // the quoted ETag alone, for If-None-Match
+    uint64_t etag_length;
+};
+
+/**
+ * @brief a file of the bundle, found by the hash of its path below the root
+ */
+struct s_bundle_entry
+{
+    uint64_t hash;
+    uint64_t path_offset;
+    uint64_t path_length;
+    s_bundle_variant plain;
+    s_bundle_variant gzip; // packed from a file.gz next to the file
+};
+
+/**
+ * @brief a read only root packed into one file by webserv --pack and mapped into memory.
+ * A path is found in a open addressed hash index and its headers and body are sent straight from the mapping,
+ * so serving it makes no file system call. Mapping it at the start reads nothing, the pages come in on the first use.
+ * The bundle is checked once when it is mapped, lookups trust the offsets afterwards
+ */
+class ServerBundle
+{
+    public:
+        ~ServerBundle();
+        ServerBundle(const ServerBundle& other) = delete;
+        ServerBundle& operator=(const ServerBundle& other) = delete;
+        static std::shared_ptr<const ServerBundle> map(const std::string& bundle_path, const std::string& root);
+        static int pack(const std::string& root, const std::string& bundle_path);
+        const s_bundle_entry* find(const std::string& path) const;
+        const char* data(uint64_t offset) const;
+    private:
+        ServerBundle(const char* base, size_t size, const std::string& root);
+        const char* base_;
+        size_t size_;
+        std::string root_; // the root relative to the working directory, the way the paths of the validator start
+        const s_bundle_header* header_;
+        const uint64_t* slots_;
+        const s_bundle_entry* entries_;
+
+        bool check() const;
+        bool checkVariant(const s_bundle_variant& variant) const;
+        static uint64_t hash(const char* data, size_t size);
+        static std::string etag(const std::string& body);
+};
+
+#endif
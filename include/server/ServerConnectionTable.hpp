@@ -0,0 +1,54 @@
+#ifndef SERVER_CONNECTION_TABLE_HPP
+# define SERVER_CONNECTION_TABLE_HPP
+
+# include <vector>
+# include <memory>
+# include "server/ServerRequestHandler.hpp"
+
+struct configInfo;
+struct serverGeneration;
+
+enum e_fd_type
+{
+    FD_NONE,
+    FD_LISTENER,
+    FD_CLIENT,
+    FD_PIPE,
+    FD_SIGNAL,
+    FD_WAKE,
+    FD_UPGRADE,
+    FD_AWAIT,
+    FD_AIO,
+    FD_CONTENT_CACHE,
+};
+
+struct s_connection
+{
+    e_fd_type type = FD_NONE;
+    configInfo* server = nullptr;   // server block the fd belongs to
+    s_client_data* data = nullptr;  // request state, only set for clients
+    std::shared_ptr<serverGeneration> generation; // keeps the config of a client alive until it closes
+    ServerAwait* await = nullptr;   // the coroutine waiting on the fd, only set for FD_AWAIT
+    int owner = -1;                 // the client of that coroutine
+};
+
+/**
+ * @brief table of every fd the server has in its epoll, indexed by the fd itself
+ * so an event can be dispatched without searching the server blocks
+ */
+class ServerConnectionTable
+{
+    public:
+        ServerConnectionTable();
+        ~ServerConnectionTable();
+        s_connection& add(int fd, e_fd_type type, configInfo* server);
+        s_connection* get(int fd);
+        void remove(int fd);
+        size_t size() const;
+        int end() const;
+    private:
+        std::vector<s_connection> table_;
+        size_t count_;
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SERVER_CONTENT_CACHE_HPP
+# define SERVER_CONTENT_CACHE_HPP
+
+# include <string>
+# include <list>
+# include <unordered_map>
+# include <memory>
+# include <mutex>
+# include <vector>
+# include <cstdint>
+
+/**
+ * @brief a file kept in memory with the header lines of its response
+ */
+struct s_cached_content
+{
+    std::string headers; // the Content-Type and Content-Length lines and the empty line after them
+    std::string body;
+};
+
+/**
+ * @brief the contents of small static files of one worker, bounded by size bytes and dropped least recently used first.
+ * The directory of every cached file is watched with inotify, the worker reads the events from its event loop
+ * and drops a file as soon as it is changed, moved or removed, so a hit needs no file system call at all.
+ * Files larger than max_file are remembered as such and sent from disk.
+ * The aio threads look up files at the same time as the worker, so every call takes the lock
+ */
+class ServerContentCache
+{
+    public:
+        ServerContentCache(uint64_t size, uint64_t max_file);
+        ~ServerContentCache();
+        ServerContentCache(const ServerContentCache& other) = delete;
+        ServerContentCache& operator=(const ServerContentCache& other) = delete;
+        int setup();
+        int fd() const;
+        std::shared_ptr<const s_cached_content> lookup(const std::string& path, const std::string& content_type);
+        void handleEvents();
+    private:
+        struct s_entry
+        {
+            std::string path;
+            std::shared_ptr<const s_cached_content> content; // nullptr for a file too large to cache
+            uint64_t bytes; // what the entry counts against size
+        };
+
+        std::mutex mutex_;
+        std::list<s_entry> lru_; // the most recently used entry first
+        std::unordered_map<std::string, std::list<s_entry>::iterator> entries_;
+        std::unordered_map<int, std::vector<std::string>> watches_; // the names a watched directory is looked up by, per watch descriptor
+        std::unordered_map<std::string, int> watched_dirs_;
+        uint64_t size_;
+        uint64_t max_file_;
+        uint64_t used_;
+        uint64_t epoch_; // counts the events, a file read before one of them is not stored
+        int fd_;
+
+        int load(const std::string& path, const std::string& content_type, s_cached_content& content);
+        bool watch(const std::string& dir);
+        void store(const std::string& path, std::shared_ptr<const s_cached_content> content, uint64_t bytes);
+        void drop(const std::string& path);
+        void dropDirectory(int wd, bool remove_watch);
+        void clear();
+};
+
+#endif
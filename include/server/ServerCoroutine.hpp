@@ -0,0 +1,129 @@
+#ifndef SERVER_COROUTINE_HPP
+# define SERVER_COROUTINE_HPP
+
+# include "server/ServerAio.hpp"
+# include <coroutine>
+# include <functional>
+# include <vector>
+# include <cstddef>
+# include <cstdint>
+
+# define FRAME_POOL_CLASSES 5 // frames of 256, 512, 1024, 2048 and 4096 bytes are pooled
+# define FRAME_POOL_MIN 256
+# define FRAME_POOL_KEEP 1024 // free frames kept per size class
+
+/**
+ * @brief recycles the frames of coroutines, so starting one for a request does not go to the heap.
+ * Every worker thread has its own free lists, a frame is always freed by the worker that made it.
+ * Frames larger than the largest class use operator new
+ */
+class ServerFramePool
+{
+    public:
+        static void* allocate(size_t size);
+        static void release(void* frame, size_t size);
+    private:
+        static thread_local std::vector<void*> free_[FRAME_POOL_CLASSES];
+
+        static size_t sizeClass(size_t size);
+};
+
+/**
+ * @brief a coroutine that runs until its first co_await right away and is owned by its caller.
+ * The frame stays after the coroutine returned so the owner can see it is done,
+ * destroying the task destroys the frame, also when the coroutine is still suspended
+ */
+class ServerTask
+{
+    public:
+        struct promise_type
+        {
+            ServerTask get_return_object();
+            std::suspend_never initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+            void return_void() {}
+            void unhandled_exception();
+            static void* operator new(size_t size) { return ServerFramePool::allocate(size); }
+            static void operator delete(void* frame, size_t size) { ServerFramePool::release(frame, size); }
+        };
+
+        ServerTask();
+        explicit ServerTask(std::coroutine_handle<promise_type> handle);
+        ~ServerTask();
+        ServerTask(const ServerTask& other) = delete;
+        ServerTask& operator=(const ServerTask& other) = delete;
+        ServerTask(ServerTask&& other) noexcept;
+        ServerTask& operator=(ServerTask&& other) noexcept;
+        bool active() const;
+    private:
+        std::coroutine_handle<promise_type> handle_;
+};
+
+class ServerAwait;
+class ServerContentCache;
+
+/**
+ * @brief the event loop as seen by a coroutine, it wakes the coroutine when a fd is ready or its timeout passed,
+ * or when a aio thread finished its job. It also holds the content cache of the worker
+ */
+class ServerScheduler
+{
+    public:
+        virtual ~ServerScheduler() {}
+        virtual int watch(int owner_fd, int fd, uint32_t events, uint64_t timeout_ms, ServerAwait* await) = 0;
+        virtual void unwatch(int fd) = 0;
+        virtual bool offloading() const = 0;
+        virtual int offload(s_aio_job* job) = 0;
+        virtual void cancelOffload(s_aio_job* job) = 0;
+        virtual ServerContentCache* contentCache() = 0;
+};
+
+/**
+ * @brief suspends a coroutine until a fd is ready: EPOLLIN to recv or read a pipe, EPOLLOUT to send,
+ * EPOLLIN on a pidfd for the exit of a child. co_await gives the events that woke it up, 0 after the timeout.
+ * A pipe given as other_fd wakes it up as well when it can be read, so a child that fills it is not left blocked.
+ * A await that is destroyed while it waits, with the task of a client that is closed, stops watching the fd
+ */
+class ServerAwait
+{
+    public:
+        ServerAwait(ServerScheduler& scheduler, int owner_fd, int fd, uint32_t events, uint64_t timeout_ms, int other_fd = -1);
+        ~ServerAwait();
+        ServerAwait(const ServerAwait& other) = delete;
+        ServerAwait& operator=(const ServerAwait& other) = delete;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        uint32_t await_resume() const noexcept { return events_; }
+        void wake(int fd, uint32_t events);
+    private:
+        ServerScheduler& scheduler_;
+        int owner_fd_; // the client the coroutine answers
+        int fd_;
+        int other_fd_; // watched for EPOLLIN without a timeout, -1 for none
+        uint32_t events_;
+        uint64_t timeout_ms_;
+        bool watching_;
+        std::coroutine_handle<> handle_;
+};
+
+/**
+ * @brief suspends a coroutine while a aio thread runs blocking filesystem work for it.
+ * Without aio threads the work runs right away and the coroutine does not suspend.
+ * A await that is destroyed while the work is queued or running takes it back, waiting for it if it already runs
+ */
+class ServerAioAwait
+{
+    public:
+        ServerAioAwait(ServerScheduler& scheduler, int owner_fd, std::function<void()> work);
+        ~ServerAioAwait();
+        ServerAioAwait(const ServerAioAwait& other) = delete;
+        ServerAioAwait& operator=(const ServerAioAwait& other) = delete;
+        bool await_ready() const noexcept { return false; }
+        bool await_suspend(std::coroutine_handle<> handle);
+        void await_resume() const noexcept {}
+    private:
+        ServerScheduler& scheduler_;
+        s_aio_job job_;
+};
+
+#endif
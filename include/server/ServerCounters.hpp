@@ -0,0 +1,19 @@
+#ifndef SERVER_COUNTERS_HPP
+# define SERVER_COUNTERS_HPP
+
+# include <atomic>
+# include <cstdint>
+
+/**
+ * @brief the counters of one worker process, every worker thread of the process adds to them.
+ * With a master process they live in memory shared with the master, which adds them up,
+ * so they are lock free atomics and nothing else
+ */
+struct s_worker_counters
+{
+    std::atomic<uint64_t> accepted; // clients accepted
+    std::atomic<uint64_t> requests; // responses started
+    std::atomic<uint64_t> active; // clients connected right now
+};
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef SERVER_FILE_CACHE_HPP
+# define SERVER_FILE_CACHE_HPP
+
+# include "server/ServerOutputQueue.hpp"
+# include <string>
+# include <list>
+# include <unordered_map>
+# include <memory>
+# include <mutex>
+# include <cstdint>
+# include <cstddef>
+# include <sys/types.h>
+
+/**
+ * @brief what the open file cache knows about a path
+ */
+struct s_file_info
+{
+    bool found; // false for a path that does not exist, a negative entry
+    mode_t mode;
+    off_t size;
+    time_t mtime;
+    ino_t inode;
+    dev_t device;
+    std::shared_ptr<s_file_fd> file; // the opened regular file, nullptr for anything else or when open() failed
+    std::string headers; // the Content-Type and Content-Length lines of the file, empty until the first response built them
+};
+
+/**
+ * @brief the open_file_cache of a server block in one worker: a LRU of paths with their stat() result
+ * and a opened fd, so a hot file is looked up and sent without touching the file system.
+ * A entry is trusted for valid_ms, then it is checked with stat() again and reopened only if the file changed.
+ * Entries that are not used for inactive_ms are dropped, the least recently used one goes when max is reached.
+ * Paths that do not exist are cached as well when errors is on.
+ * The aio threads look up files at the same time as the worker, so every call takes the lock
+ */
+class ServerFileCache
+{
+    public:
+        ServerFileCache(size_t max, uint64_t inactive_ms, uint64_t valid_ms, bool errors);
+        ~ServerFileCache();
+        ServerFileCache(const ServerFileCache& other) = delete;
+        ServerFileCache& operator=(const ServerFileCache& other) = delete;
+        s_file_info lookup(const std::string& path);
+        void setHeaders(const std::string& path, const s_file_info& info, const std::string& headers);
+        void forget(const std::string& path);
+        static s_file_info load(const std::string& path, const s_file_info* previous = nullptr);
+    private:
+        struct s_entry
+        {
+            std::string path;
+            s_file_info info;
+            uint64_t checked_at; // when stat() last looked at the path
+            uint64_t used_at;
+        };
+
+        std::mutex mutex_;
+        std::list<s_entry> lru_; // the most recently used entry first
+        std::unordered_map<std::string, std::list<s_entry>::iterator> entries_;
+        size_t max_;
+        uint64_t inactive_ms_;
+        uint64_t valid_ms_;
+        bool errors_;
+
+        void store(const std::string& path, const s_file_info& info, uint64_t now);
+        void drop(const std::string& path);
+        void expire(uint64_t now);
+};
+
+#endif
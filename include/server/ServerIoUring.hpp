@@ -0,0 +1,96 @@
+#ifndef SERVER_IO_URING_HPP
+# define SERVER_IO_URING_HPP
+
+# include <sys/epoll.h>
+# include <vector>
+# include <utility>
+# include <cstdint>
+# include <cstddef>
+
+# if __has_include(<linux/io_uring.h>)
+#  define HAVE_IO_URING
+# endif
+
+# define URING_ENTRIES 1024 // submission queue size, the completion queue is 4 times larger
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+/**
+ * @brief io_uring replacement for the epoll fd of a worker.
+ * Clients and pipes get a multishot poll that keeps reporting readiness in the epoll_event format,
+ * interest changes are queued in the submission ring and handed to the kernel together with the wait,
+ * so they cost no extra system calls. Listeners are registered files with a multishot accept,
+ * the accepted clients are collected in accepted() instead of reporting the listener as readable,
+ * a accept that failed with EMFILE or ENFILE is reported there with the negative error.
+ * Listeners added after the start (on a reload) use their plain fd.
+ * The multishot poll only reports new readiness, so the server drains sockets like in edge-triggered mode
+ */
+class ServerIoUring
+{
+    public:
+        ServerIoUring();
+        ~ServerIoUring();
+        ServerIoUring(const ServerIoUring& other) = delete;
+        ServerIoUring& operator=(const ServerIoUring& other) = delete;
+        int setup();
+        bool active() const;
+        int control(int mode, int fd, epoll_event* event);
+        int addListeners(const std::vector<int>& listener_fds);
+        int addListener(int listener_fd);
+        void removeListener(int listener_fd);
+        int startAccept(int listener_fd);
+        int stopAccept(int listener_fd);
+        int wait(epoll_event events[], int max_events, int timeout_ms);
+        const std::vector<std::pair<int, int>>& accepted() const;
+    private:
+        struct s_uring_fd
+        {
+            uint32_t gen = 0;
+            uint32_t events = 0;
+            bool armed = false;
+            uint64_t batch = 0;
+            int slot = 0;
+        };
+
+        int ring_fd_;
+        unsigned sq_entries_;
+        void* sq_ptr_;
+        size_t sq_size_;
+        void* cq_ptr_;
+        size_t cq_size_;
+        io_uring_sqe* sqes_;
+        size_t sqes_size_;
+        unsigned* sq_head_;
+        unsigned* sq_tail_;
+        unsigned* sq_mask_;
+        unsigned* sq_array_;
+        unsigned* cq_head_;
+        unsigned* cq_tail_;
+        unsigned* cq_mask_;
+        io_uring_cqe* cqes_;
+        unsigned sq_local_tail_;
+        unsigned to_submit_;
+        uint64_t batch_;
+        bool fixed_listeners_;
+        bool accept_by_poll_;
+        std::vector<s_uring_fd> fds_;
+        std::vector<int> listeners_;
+        std::vector<int> listener_slots_;
+        std::vector<bool> accepting_;
+        std::vector<std::pair<int, int>> accepted_;
+
+        void teardown();
+        io_uring_sqe* getSqe();
+        void pushSqe();
+        int enter(unsigned min_complete, int timeout_ms);
+        int armPoll(int fd, uint32_t events);
+        int removePoll(int fd);
+        int armAccept(int listener_fd);
+        void handleCompletion(const io_uring_cqe& cqe, epoll_event events[], int& count);
+        s_uring_fd& entry(int fd);
+        size_t listenerIndex(int listener_fd) const;
+        static uint64_t userData(uint64_t kind, uint32_t gen, int fd);
+};
+
+#endif
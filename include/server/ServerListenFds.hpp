@@ -0,0 +1,47 @@
+#ifndef SERVER_LISTEN_FDS_HPP
+# define SERVER_LISTEN_FDS_HPP
+
+# include <string>
+# include <vector>
+# include <mutex>
+# include <cstdint>
+# include <cstddef>
+
+# define LISTEN_FDS_START 3 // the first fd passed with socket activation, SD_LISTEN_FDS_START
+
+struct s_listen_fd
+{
+    int fd;
+    std::string address; // the address the socket is bound to, "0.0.0.0" for every address, "unix:" and the path for a unix socket
+    uint16_t port; // 0 for a unix socket
+    size_t users; // the workers listening on it
+};
+
+/**
+ * @brief the listening sockets the process got from its supervisor with socket activation.
+ * When LISTEN_PID is the pid of the process, LISTEN_FDS listening sockets are open from fd 3 on.
+ * The server blocks take the socket with their address and port instead of binding a new one,
+ * so the supervisor keeps the accept queue alive while the server restarts.
+ * Workers that find no socket of their own share one, a inherited socket is never closed.
+ * A unix socket is created by the first worker and shared with the others the same way,
+ * binding its path again would take it from the first worker.
+ * A master process shares every listener it makes, its worker processes take them after the fork
+ */
+class ServerListenFds
+{
+    public:
+        ServerListenFds();
+        ~ServerListenFds();
+        ServerListenFds(const ServerListenFds& other) = delete;
+        ServerListenFds& operator=(const ServerListenFds& other) = delete;
+        int take(const std::string& address, uint16_t port);
+        void share(int fd, const std::string& address, uint16_t port);
+        std::vector<int> fds();
+    private:
+        std::mutex mutex_;
+        std::vector<s_listen_fd> fds_;
+
+        void inherit(int fd);
+};
+
+#endif
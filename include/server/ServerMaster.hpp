@@ -0,0 +1,69 @@
+#ifndef SERVER_MASTER_HPP
+# define SERVER_MASTER_HPP
+
+# include "../Config.hpp"
+# include "server/ServerListenFds.hpp"
+# include "server/ServerReload.hpp"
+# include "server/ServerUpgrade.hpp"
+# include "server/ServerCounters.hpp"
+# include <vector>
+# include <memory>
+# include <cstdint>
+# include <sys/types.h>
+
+# define WORKER_RESPAWN_MS 1000 // a worker process that dies sooner after its start is restarted after this delay
+
+struct s_worker_process
+{
+    pid_t pid; // -1 while it is not running
+    uint64_t started_at;
+    uint64_t restart_at; // when a worker process that died is started again
+};
+
+/**
+ * @brief the master process of worker_processes: it makes the listening sockets once
+ * and forks the worker processes, each running its own worker pool on those sockets.
+ * A worker process that dies is started again, so a crash takes down the clients of one process only.
+ * The master handles no clients itself, it reads its signals from a signalfd:
+ * SIGHUP checks the config file and passes the signal on, every worker process reloads it,
+ * SIGUSR2 upgrades the binary with the listening sockets of the master,
+ * SIGQUIT lets the workers finish their clients and SIGTERM or SIGINT stops them right away,
+ * SIGUSR1 logs the counters of every worker process.
+ * Worker processes get SIGTERM when the master dies
+ */
+class ServerMaster
+{
+    public:
+        ServerMaster(std::vector<std::shared_ptr<Config>>& configs, const char* config_path, ServerListenFds& listen_fds);
+        ~ServerMaster();
+        ServerMaster(const ServerMaster& other) = delete;
+        ServerMaster& operator=(const ServerMaster& other) = delete;
+        int run();
+    private:
+        const char* config_path_;
+        ServerListenFds& listen_fds_;
+        ServerReload reload_;
+        ServerUpgrade upgrade_;
+        std::vector<s_worker_process> workers_;
+        s_worker_counters* counters_; // one per worker process, shared with them
+        pid_t pid_;
+        int signal_fd_;
+        int upgrade_fd_;
+        bool stopping_;
+        uint64_t restarts_;
+
+        void openListeners();
+        void startWorker(size_t index);
+        int runWorker(size_t index);
+        void reapWorkers();
+        void restartWorkers();
+        int restartTimeout();
+        bool running();
+        void signalWorkers(int signo);
+        void stop(int signo);
+        int handleSignal();
+        void handleUpgrade();
+        void logCounters();
+};
+
+#endif
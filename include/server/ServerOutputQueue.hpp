@@ -0,0 +1,86 @@
+#ifndef SERVER_OUTPUT_QUEUE_HPP
+# define SERVER_OUTPUT_QUEUE_HPP
+
+# include <string>
+# include <fstream>
+# include <cstdint>
+# include <memory>
+# include <sys/types.h>
+
+# define OUTPUT_BUDGET 256 * 1024 // max bytes of a file a client holds in memory at once
+# define FILE_READAHEAD 2 * 1024 * 1024 // bytes of a sendfile() file the kernel is asked to read ahead
+
+enum e_flush_return
+{
+    FLUSH_DONE,
+    FLUSH_AGAIN,
+    FLUSH_ERROR,
+    FLUSH_READ, // the next piece of the file has to be read first
+    FLUSH_YIELD, // the quantum of the client is used up, the rest waits for its next turn
+};
+
+/**
+ * @brief a opened file that is closed once the last response sending it and the open file cache let go of it.
+ * sendfile() reads at its own offset, so any number of responses can send the same fd at once
+ */
+struct s_file_fd
+{
+    explicit s_file_fd(int file_fd);
+    ~s_file_fd();
+    s_file_fd(const s_file_fd& other) = delete;
+    s_file_fd& operator=(const s_file_fd& other) = delete;
+    int fd;
+};
+
+/**
+ * @brief the pending response of a client with a write cursor.
+ * Headers and generated bodies are queued as bytes, files are queued as a stream
+ * that is read in pieces of at most OUTPUT_BUDGET bytes when the previous piece is send,
+ * so a large download only uses a fixed amount of memory.
+ * flush() sends until the socket would block or the quantum of the client is used up
+ * and continues where it left off on the next call.
+ * The piece can also be read by readFile() outside of flush(), on a aio thread.
+ * A file attached as a fd goes from the page cache to the socket with sendfile(),
+ * without passing through the buffer. A file of the content cache or of a bundle is sent together with the header
+ * in one sendmsg() from the memory it is kept in
+ */
+class ServerOutputQueue
+{
+    public:
+        ServerOutputQueue();
+        ~ServerOutputQueue();
+        ServerOutputQueue(const ServerOutputQueue& other) = delete;
+        ServerOutputQueue& operator=(const ServerOutputQueue& other) = delete;
+        void append(const std::string& data);
+        void append(const char* data, size_t size);
+        void attachFile(std::ifstream&& file_stream, uint64_t size, bool chunked);
+        void attachFd(std::shared_ptr<s_file_fd> file, uint64_t size, uint64_t max_chunk);
+        void attachContent(std::shared_ptr<const void> owner, const char* content, size_t size);
+        e_flush_return flush(int client_fd, bool read_file = true, uint64_t quantum = 0);
+        void readFile();
+        bool empty() const;
+        void clear();
+    private:
+        std::string buffer_;
+        size_t offset_;
+        std::ifstream file_stream_;
+        uint64_t file_remaining_;
+        bool file_chunked_;
+        bool file_attached_;
+        bool file_failed_;
+        std::shared_ptr<s_file_fd> file_fd_; // the file send with sendfile(), nullptr if none
+        off_t file_offset_;
+        off_t advised_; // the end of the part of the file the kernel was asked to read ahead
+        uint64_t max_chunk_;
+        std::shared_ptr<const void> content_owner_; // keeps the memory of content_ alive
+        const char* content_; // a file of the content cache or a bundle, sent from where it is, nullptr if none
+        size_t content_size_;
+        size_t content_offset_;
+
+        bool refill();
+        e_flush_return sendFromFd(int client_fd, uint64_t quantum, uint64_t sent);
+        e_flush_return sendContent(int client_fd, uint64_t quantum);
+        void adviseReadahead();
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef SERVER_RELOAD_HPP
+# define SERVER_RELOAD_HPP
+
+# include "../Config.hpp"
+# include "server/ServerAdmission.hpp"
+# include <memory>
+# include <mutex>
+# include <vector>
+# include <cstdint>
+
+/**
+ * @brief one loaded version of the config file, never changed after it is made.
+ * The workers build their server blocks from it and keep it alive as long as they have clients of it
+ */
+struct s_config_generation
+{
+    uint64_t number;
+    std::vector<std::shared_ptr<Config>> configs;
+    std::shared_ptr<ServerAdmission> admission;
+};
+
+/**
+ * @brief holds the newest config generation of the process.
+ * On SIGHUP the first worker loads the config file again, on success the new generation
+ * replaces the current one and every worker is woken up through its eventfd to switch to it.
+ * A config with errors is logged and the running generation stays
+ */
+class ServerReload
+{
+    public:
+        ServerReload(const char* config_path, std::vector<std::shared_ptr<Config>>& configs);
+        ~ServerReload();
+        ServerReload(const ServerReload& other) = delete;
+        ServerReload& operator=(const ServerReload& other) = delete;
+        std::shared_ptr<const s_config_generation> current() const;
+        void addWorker(int wake_fd);
+        int reload();
+        void wakeWorkers();
+    private:
+        const char* config_path_;
+        mutable std::mutex mutex_;
+        std::shared_ptr<const s_config_generation> current_;
+        std::vector<int> wake_fds_;
+};
+
+#endif
@@ -6,12 +6,19 @@
 # include <string>
 # include <array>
 # include <sys/epoll.h>
+# include "server/ServerOutputQueue.hpp"
+# include "server/ServerVirtualHosts.hpp"
+# include "server/ServerCoroutine.hpp"
 # include "../Config.hpp"
 
 #define BUFFER_SIZE 1024 * 1024
+#define MAX_HEADER_SIZE 32 * 1024 // max bytes of a request header
+#define MAX_CHUNK_LINE 1024 // max bytes of a chunk size line
 
 enum e_reponses {
     E_ROK,
+    READ_INCOMPLETE,
+    READ_YIELD,
     MODIFY_CLIENT_WRITE,
     HANDLE_CLIENT_EMPTY,
     HANDLE_COUT_CERR_OUTPUT,
@@ -24,10 +31,21 @@ enum e_reponses {
     EXCEPTION,
 };
 
+enum e_parse_state
+{
+    PARSE_HEADER,
+    PARSE_BODY_LENGTH,
+    PARSE_BODY_CHUNKED,
+    PARSE_CHUNK_TRAILER,
+    PARSE_DONE,
+};
+
 struct s_client_data
 {
     s_client_data(std::shared_ptr<Config>& conf);
     s_client_data(const s_client_data& other);
+    void reset();
+    bool keepAlive() const;
     std::string request_type;
     std::string request_header;
     std::string request_body;
@@ -35,33 +53,51 @@ struct s_client_data
     std::string request_source;
     std::string http_version;
     bool chunked = false;
-    std::shared_ptr<Config>& config_;
+    bool keep_alive = true;
+    uint64_t requests_served = 0;
+    bool responding = false;
+    bool peer_closed = false;        // the client shut down its sending side, it still reads the response
+    std::string in_buffer; // received bytes that are not parsed yet
+    e_parse_state parse_state = PARSE_HEADER;
+    uint64_t body_remaining = 0; // body bytes still to come, for chunked the rest of the current chunk
+    ServerOutputQueue output;
+    std::shared_ptr<Config> config_; // the server block picked by the Host header of the current request
+    size_t server_index = 0;         // index of that server block in the config generation
+    int fd = -1;                     // the client socket
+    uint64_t weight = 1;             // quantum multiplier of the location answering the current request
+    uint64_t yielded = 0;            // the round of the run queue it waits for after using up its quantum, 0 if none
+    ServerTask task;                 // the coroutine building the response while it waits for a CGI script
 };
 
 class ServerRequestHandler
 {
     public:
-        ServerRequestHandler(uint64_t client_body_size);
+        ServerRequestHandler();
         ~ServerRequestHandler();
         s_client_data* getRequest(int fd);
         void removeNodeFromRequest(int fd);
-        e_reponses readRequest(int client_fd, std::string& request_buffer);
-        e_reponses handleClient(std::string& request_buffer, epoll_event& event);
+        e_reponses readRequest(int client_fd, uint64_t quantum = 0);
+        e_reponses handleClient(int client_fd, epoll_event& event);
         void setStdoutPipe(int out_pipe[]);
         void setStderrPipe(int err_pipe[]);
-        void setConfigForClient(std::shared_ptr<Config>& conf, int client_fd);
+        s_client_data* setConfigForClient(std::shared_ptr<Config>& conf, int client_fd);
+        void setVirtualHosts(const ServerVirtualHosts* hosts);
     private:
         std::unordered_map<int, s_client_data> request_;
-        uint64_t max_size_;
+        const ServerVirtualHosts* hosts_;
         int stdout_pipe_[2];
         int stderr_pipe_[2];
 
-        e_reponses readHeader(std::string& request_buffer, size_t header_end, int client_fd, char buffer[]);
+        e_reponses parseRequest(s_client_data& data, int client_fd);
+        e_reponses readHeader(std::string& request_buffer, size_t header_end, int client_fd);
         e_reponses setContentTypeRequest(std::string& request_buffer, size_t header_end, int client_fd);
         e_reponses setMethodSourceHttpVersion(std::string& request_buffer, int client_fd);
-        e_reponses handleChunkedRequest(size_t body_start, std::string& request_buffer, int client_fd, char buffer[]);
-        int useRecv(int client_fd, char buffer[], std::string& request_buffer);
-        e_reponses handleContentLength(size_t size, std::string& request_buffer, size_t body_start, int client_fd, char buffer[]);
+        void setConnectionRequest(const std::string& headers, int client_fd);
+        void setVirtualHost(const std::string& headers, int client_fd);
+        e_reponses handleChunkedRequest(s_client_data& data);
+        e_reponses handleChunkTrailer(s_client_data& data);
+        static bool parseChunkSize(const std::string& line, uint64_t& chunk_size);
+        e_reponses handleContentLength(s_client_data& data);
 };
 
 #endif
\ No newline at end of file
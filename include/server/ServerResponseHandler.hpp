@@ -4,9 +4,13 @@
 # include "server/ServerRequestHandler.hpp"
 # include "server/ServerResponseValidator.hpp"
 # include "cgi/CGIHandler.hpp"
+# include "server/ServerCoroutine.hpp"
+# include "server/ServerContentCache.hpp"
+# include "server/ServerBundle.hpp"
 # include "../Config.hpp"
 # include <sys/epoll.h>
 # include <vector>
+# include <sstream>
 
 # define STANDARD_LOG_FILE "log.log"
 # define STANDARD_ERROR_LOG_FILE "error.log"
@@ -16,10 +20,10 @@ enum e_server_request_return
     SRH_OK,
     SRH_INCORRECT_HTTP_VERSION,
     SRH_OPEN_DIR_FAILED,
-    SRH_SEND_ERROR,
     SRH_FSTREAM_ERROR,
     SRH_CGI_ERROR,
     SRH_DO_TIMEOUT,
+    SRH_SUSPENDED, // a coroutine finishes the response, the client waits without events
 };
 
 class ServerResponseHandler
@@ -27,41 +31,56 @@ class ServerResponseHandler
     public:
         ServerResponseHandler(const std::vector<std::shared_ptr<Location>>& locations, const std::string& root, const std::map<uint16_t, std::string>& error_map);
         ~ServerResponseHandler();
-        e_server_request_return handleResponse(int client_fd, s_client_data& client_data, std::vector<std::shared_ptr<Location>> locations);
-        e_server_request_return setupResponse(int client_fd, uint16_t code, const s_client_data& data, std::string location = "");
+        e_server_request_return handleResponse(s_client_data& client_data, std::vector<std::shared_ptr<Location>> locations);
+        e_server_request_return setupResponse(uint16_t code, s_client_data& data, std::string location = "");
         void handleCoutErrOutput(int fd);
         void setStdoutPipe(int stdout_pipe[]);
+        void setScheduler(ServerScheduler* scheduler);
+        void setFileCache(const Config& config);
+        void setBundle(const Config& config);
+        static std::string getContentType(const std::string& file_path);
     private:
         ServerResponseValidator SRV_;
+        std::shared_ptr<ServerFileCache> file_cache_; // shared with SRV_, nullptr when open_file_cache is off
+        std::shared_ptr<const ServerBundle> bundle_; // shared with SRV_, nullptr without a bundle
         const std::map<uint16_t, std::string>& error_pages_;
         int stdout_pipe_[2];
+        ServerScheduler* scheduler_;
         std::map<uint16_t, std::string> status_codes_;
 
-        e_server_request_return handleReturns(int client_fd, e_responeValReturn nr, s_client_data& data, std::vector<std::shared_ptr<Location>>::const_iterator& location_it);
+        e_server_request_return handleReturns(e_responeValReturn nr, s_client_data& data, std::vector<std::shared_ptr<Location>>::const_iterator& location_it);
         e_server_request_return buildDirectoryResponse(const std::string& path, std::string& body);
-        e_server_request_return sendResponse(int client_fd, const std::string& status, const std::string& file_location, const s_client_data& data, bool d_list = false);
-        std::string getContentType(const std::string& file_path);
-        e_server_request_return sendChunkedResponse(int client_fd, std::ifstream& file_stream);
-        e_server_request_return sendFile(int client_fd, std::ifstream& file_stream, std::streamsize size);
+        e_server_request_return sendResponse(const std::string& status, const std::string& file_location, s_client_data& data, bool d_list = false);
+        e_server_request_return queueFd(std::ostringstream& response, const std::string& status, const std::string& file_location, s_client_data& data);
+        bool queueCached(std::ostringstream& response, const std::string& file_location, s_client_data& data);
+        bool queueBundled(const std::string& status, const std::string& file_location, s_client_data& data);
+        static std::string headerValue(const std::string& headers, const std::string& name);
+        static bool acceptsGzip(const std::string& accept_encoding);
+        std::string diskPath(const std::string& file_location);
+        e_server_request_return openFailed(std::ostringstream& response, const std::string& status, const std::string& file_location, s_client_data& data);
         std::vector<std::string> sourceChunker(std::string& source);
         void logMsg(const char* msg, int fd);
 
         /**
          * @brief Handle CGI request processing
-         * @param client_fd Client socket
          * @param client_data Request data
          * @param location Location configuration
          * @param script_path Path to CGI script
-         * @return SRH_OK on success, error code otherwise
+         * @return SRH_SUSPENDED while the script runs, SRH_OK if the response is already queued
          */
         e_server_request_return handleCGI(
-            int client_fd,
-            const s_client_data& client_data,
-            const Location& location,
+            s_client_data& client_data,
+            const std::shared_ptr<Location>& location,
             const std::string& script_path);
-        e_server_request_return sendRedirectResponse(int client_fd, uint16_t code, std::string& location);
+        ServerTask runCGI(s_client_data& client_data, std::shared_ptr<Location> location, std::string script_path);
+        uint64_t timeLeft(uint64_t deadline);
+        e_server_request_return handleDisk(s_client_data& client_data, std::vector<std::shared_ptr<Location>>::const_iterator location_it, std::string& file_path);
+        ServerTask runDisk(s_client_data& client_data, std::vector<std::shared_ptr<Location>>::const_iterator location_it, std::string file_path);
+        e_server_request_return respondFromDisk(s_client_data& client_data, std::vector<std::shared_ptr<Location>>::const_iterator location_it, std::string& file_path);
+        e_server_request_return sendRedirectResponse(uint16_t code, std::string& location, s_client_data& data);
+        std::string connectionHeader(const s_client_data& data);
         void fillStatusCodes();
-        e_server_request_return removeFile(int client_fd, s_client_data& client_data);
+        e_server_request_return removeFile(s_client_data& client_data);
 };
 
 #endif
\ No newline at end of file
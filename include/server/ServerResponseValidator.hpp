@@ -7,6 +7,8 @@
 # include "../config/Location.hpp"
 # include "../Config.hpp"
 # include "ServerRequestHandler.hpp"
+# include "ServerFileCache.hpp"
+# include "ServerBundle.hpp"
 
 enum e_responeValReturn
 {
@@ -38,9 +40,15 @@ class ServerResponseValidator
         bool filePermission(const std::string& path);
         const std::string& getRoot() const;
         bool fileExists(const std::string& path);
+        void setFileCache(std::shared_ptr<ServerFileCache> file_cache);
+        void setBundle(std::shared_ptr<const ServerBundle> bundle);
     private:
         const std::vector<std::shared_ptr<Location>>& locations_;
         const std::string& root_;
+        std::shared_ptr<ServerFileCache> file_cache_; // nullptr when open_file_cache is off
+        std::shared_ptr<const ServerBundle> bundle_; // nullptr without a bundle
+
+        s_file_info statFile(const std::string& path);
 
         void setPossibleLocation(size_t token_size, std::vector<std::string>& token_location, std::map<size_t, std::shared_ptr<Location>>& found_location);
         void setPossibleRegexLocation(std::map<size_t, std::shared_ptr<Location>>& found_location, s_client_data& client_data);
@@ -0,0 +1,57 @@
+#ifndef SERVER_TIMER_WHEEL_HPP
+# define SERVER_TIMER_WHEEL_HPP
+
+# include <vector>
+# include <cstdint>
+# include <cstddef>
+
+# define TIMER_TICK_MS 100 // resolution of the wheel
+# define TIMER_WHEEL_SLOTS 512 // one revolution is 51.2 seconds
+
+enum e_timer_phase
+{
+    TIMER_HEADER,
+    TIMER_BODY,
+    TIMER_RESPONSE,
+    TIMER_KEEPALIVE,
+    TIMER_AWAIT, // a coroutine waits on the fd
+};
+
+/**
+ * @brief hashed timing wheel holding one timeout per client fd.
+ * Arming, re-arming and canceling are O(1) and need no extra file descriptors,
+ * the event loop uses nextTimeout() as the epoll_wait timeout and collects
+ * the clients that passed their deadline with expire()
+ */
+class ServerTimerWheel
+{
+    public:
+        ServerTimerWheel();
+        ~ServerTimerWheel();
+        void arm(int fd, uint64_t timeout_ms, e_timer_phase phase);
+        void cancel(int fd);
+        void expire(std::vector<int>& expired);
+        int nextTimeout() const;
+        e_timer_phase getPhase(int fd) const;
+        size_t size() const;
+        static uint64_t nowMs();
+        static uint64_t nowUs();
+    private:
+        struct s_timer_node
+        {
+            int prev = -1;
+            int next = -1;
+            uint64_t deadline_tick = 0;
+            e_timer_phase phase = TIMER_HEADER;
+            bool armed = false;
+        };
+
+        std::vector<s_timer_node> nodes_;
+        std::vector<int> slots_;
+        uint64_t current_tick_;
+        size_t count_;
+
+        void unlink(int fd);
+};
+
+#endif
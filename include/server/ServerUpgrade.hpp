@@ -0,0 +1,51 @@
+#ifndef SERVER_UPGRADE_HPP
+# define SERVER_UPGRADE_HPP
+
+# include <string>
+# include <vector>
+# include <atomic>
+# include <cstddef>
+# include <sys/types.h>
+
+# define UPGRADE_READY_ENV "WEBSERV_UPGRADE_FD" // the fd the new process reports its startup on
+
+enum e_upgrade_status
+{
+    UPGRADE_PENDING,
+    UPGRADE_READY,
+    UPGRADE_FAILED,
+};
+
+/**
+ * @brief replaces the running process with a new build of the server without closing the listening sockets.
+ * On SIGUSR2 the process forks and executes the binary it was started from again,
+ * the listening sockets are passed as LISTEN_FDS and a pipe as WEBSERV_UPGRADE_FD.
+ * The new process writes to the pipe once all its workers are set up, then the old process
+ * stops accepting, finishes its clients and exits. If the new process exits before it is ready
+ * the pipe is closed without a byte and the old process keeps serving.
+ * SIGQUIT drains the process the same way without a new process
+ */
+class ServerUpgrade
+{
+    public:
+        ServerUpgrade(const char* config_path, size_t workers);
+        ~ServerUpgrade();
+        ServerUpgrade(const ServerUpgrade& other) = delete;
+        ServerUpgrade& operator=(const ServerUpgrade& other) = delete;
+        int start(const std::vector<int>& listeners);
+        e_upgrade_status readStatus(int status_fd);
+        void notifyReady();
+        void stop();
+        bool draining() const;
+        void finishWorker();
+        bool finished() const;
+    private:
+        std::string binary_;
+        const char* config_path_;
+        int ready_fd_;
+        pid_t child_;
+        std::atomic<bool> draining_;
+        std::atomic<size_t> running_workers_;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SERVER_VIRTUAL_HOSTS_HPP
+# define SERVER_VIRTUAL_HOSTS_HPP
+
+# include "../Config.hpp"
+# include <unordered_map>
+# include <string>
+# include <memory>
+# include <cstddef>
+
+struct s_virtual_host
+{
+    size_t server = 0;              // index of the server block in its generation
+    std::shared_ptr<Config> config; // config of the server block
+};
+
+/**
+ * @brief picks the server block for a request from its Host header, for all server blocks on one port.
+ * The names are put in hash tables when the config is loaded: exact names,
+ * names with a leading wildcard (*.example.com) keyed by what follows the '*.'
+ * and names with a trailing wildcard (www.example.*) keyed by what comes before the '.*'.
+ * A lookup tries the exact name, then the longest leading and the longest trailing wildcard,
+ * every step is one hash lookup per label of the host. A host that matches nothing gets the default server
+ */
+class ServerVirtualHosts
+{
+    public:
+        ServerVirtualHosts(size_t default_server, const std::shared_ptr<Config>& default_config);
+        ~ServerVirtualHosts();
+        void add(const std::string& name, size_t server, const std::shared_ptr<Config>& config);
+        const s_virtual_host& find(const std::string& host) const;
+    private:
+        s_virtual_host default_;
+        std::unordered_map<std::string, s_virtual_host> exact_;
+        std::unordered_map<std::string, s_virtual_host> leading_;
+        std::unordered_map<std::string, s_virtual_host> trailing_;
+
+        static std::string normalize(const std::string& host);
+};
+
+#endif
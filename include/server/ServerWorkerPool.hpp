@@ -0,0 +1,40 @@
+#ifndef SERVER_WORKER_POOL_HPP
+# define SERVER_WORKER_POOL_HPP
+
+# include "Server.hpp"
+# include <vector>
+# include <memory>
+# include <thread>
+# include <pthread.h>
+
+/**
+ * @brief runs one Server event loop per worker thread.
+ * Every worker has its own epoll, its own SO_REUSEPORT listening sockets
+ * and its own connection table, so the workers share nothing but the config generations,
+ * the connection counts for max_connections, the aio threads and the sockets inherited with socket activation.
+ * On SIGUSR2 the process hands its listening sockets to a new executable and drains.
+ * When the first worker stops the others are stopped and joined before the workers are destroyed.
+ * Under a master process every worker process runs its own pool
+ */
+class ServerWorkerPool
+{
+    public:
+        ServerWorkerPool(std::vector<std::shared_ptr<Config>>& configs, const char* config_path, ServerListenFds& listen_fds, s_worker_counters& counters, size_t first_cpu = 0);
+        ~ServerWorkerPool();
+        int run();
+    private:
+        ServerListenFds& listen_fds_;
+        ServerReload reload_;
+        ServerUpgrade upgrade_;
+        ServerAioPool aio_; // before the workers, which cancel their jobs when they close their clients
+        std::vector<std::unique_ptr<Server>> workers_;
+        std::vector<std::thread> threads_; // the threads of every worker but the first
+        size_t worker_count_;
+        bool pin_cpus_;
+        size_t first_cpu_; // the CPU of the first worker, the workers of a worker process come after those of the ones before it
+
+        void pinToCpu(pthread_t thread, size_t worker_id);
+        void stopWorkers();
+};
+
+#endif
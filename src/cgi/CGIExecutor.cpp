@@ -1,23 +1,59 @@
 #include "cgi/CGIExecutor.hpp"
 #include <unistd.h>
 #include <sys/wait.h>
+#include <sys/syscall.h>
 #include <stdexcept>
 #include <cstring>
-#include <sstream>
+#include <cerrno>
 #include <fcntl.h>
-#include <thread>
+#include <signal.h>
 
+CGIExecutor::CGIExecutor() : pid_(-1), pidfd_(-1)
+{
+    for (int i = 0; i < 2; ++i) {
+        input_pipe_[i] = -1;
+        output_pipe_[i] = -1;
+        error_pipe_[i] = -1;
+    }
+}
 
-#define TIMEOUT_MS 20000 // 20 seconds
+CGIExecutor::~CGIExecutor()
+{
+    // The request is gone before the script finished, nobody reads its output anymore.
+    // Whatever the script started goes with it, a shell script would leave its commands running
+    if (pid_ != -1) {
+        if (kill(-pid_, SIGKILL) == -1) {
+            kill(pid_, SIGKILL);
+        }
+        reap(true);
+    }
+    closePipes();
+    if (pidfd_ != -1) {
+        close(pidfd_);
+    }
+}
 
-std::pair<int, std::string> CGIExecutor::execute(
+void CGIExecutor::start(
     const std::string& interpreter,
     const std::string& script_path,
-    const std::string& request_body,
     const std::map<std::string, std::string>& env_vars)
 {
     setupPipes();
 
+    // Everything the child needs is prepared before the fork
+    std::vector<std::string> env_strings = prepareEnvironment(env_vars);
+    std::vector<const char*> env_array;
+    for (const auto& str : env_strings) {
+        env_array.push_back(str.c_str());
+    }
+    env_array.push_back(nullptr);
+    std::string new_script_path = script_path.substr(1, script_path.size());
+    const char* args[] = {
+        interpreter.c_str(),
+        new_script_path.c_str(),
+        nullptr
+    };
+
     pid_t pid = fork();
     if (pid == -1) {
         closePipes();
@@ -25,121 +61,123 @@ std::pair<int, std::string> CGIExecutor::execute(
     }
 
     if (pid == 0) {  // Child process
-        // Close unused pipe ends
-        close(input_pipe_[1]);   // Close write end of input
-        close(output_pipe_[0]);  // Close read end of output
-        close(error_pipe_[0]);  // Cloase read end of error
-
-        // Redirect stdin to input pipe
-        if (dup2(input_pipe_[0], STDIN_FILENO) == -1) {
-            exit(EXIT_FAILURE);
-        }
-
-        // Redirect stdout to output pipe
-        if (dup2(output_pipe_[1], STDOUT_FILENO) == -1) {
-            exit(EXIT_FAILURE);
-        }
-
-        // Redirect stderr to error pipe
-        if (dup2(error_pipe_[1], STDERR_FILENO) == -1) {
-            exit(EXIT_FAILURE);
-        }
-
-        // Prepare environment
-        std::vector<std::string> env_strings = prepareEnvironment(env_vars);
-        std::vector<const char*> env_array;
-        for (const auto& str : env_strings) {
-            env_array.push_back(str.c_str());
+        setpgid(0, 0);
+        // The server blocks SIGHUP and SIGUSR2 in every thread, the script starts with no blocked signals.
+        // A worker process ignores SIGUSR1 and SIGUSR2, ignored signals would stay ignored in the script
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigprocmask(SIG_SETMASK, &signals, nullptr);
+        signal(SIGUSR1, SIG_DFL);
+        signal(SIGUSR2, SIG_DFL);
+
+        // Redirect stdin, stdout and stderr to the pipes, dup2 clears close-on-exec
+        if (dup2(input_pipe_[0], STDIN_FILENO) == -1 ||
+            dup2(output_pipe_[1], STDOUT_FILENO) == -1 ||
+            dup2(error_pipe_[1], STDERR_FILENO) == -1) {
+            _exit(EXIT_FAILURE);
         }
-        env_array.push_back(nullptr);
-        std::string new_script_path = script_path.substr(1, script_path.size());
-
-        // Prepare arguments
-        const char* args[] = {
-            interpreter.c_str(),
-            new_script_path.c_str(),
-            nullptr
-        };
         execve(interpreter.c_str(), const_cast<char* const*>(args), const_cast<char* const*>(env_array.data()));
-        exit(EXIT_FAILURE);  // Only reached if execve fails
+        _exit(EXIT_FAILURE);  // Only reached if execve fails
     }
 
-
-    // Parent process
+    // Parent process, the group is set on both sides so a kill right after the fork finds it
+    setpgid(pid, pid);
+    pid_ = pid;
+#ifdef SYS_pidfd_open
+    pidfd_ = static_cast<int>(syscall(SYS_pidfd_open, pid, 0));
+#endif
     close(input_pipe_[0]);   // Close read end of input
     close(output_pipe_[1]);  // Close write end of output
-    close(error_pipe_[1]);  // Close write end of error
-
-    // Write request body to script if present
-    if (!request_body.empty()) {
-        if (write(input_pipe_[1], request_body.data(), request_body.length()) == -1) {
-            close(input_pipe_[1]); close(output_pipe_[0]); close(error_pipe_[0]);
-            kill(pid, SIGKILL);
-            int status;
-            waitpid(pid, &status, 0);
-            throw std::runtime_error("Write failed: to CGI has not been successful\n");
-        }
+    close(error_pipe_[1]);   // Close write end of error
+    input_pipe_[0] = -1;
+    output_pipe_[1] = -1;
+    error_pipe_[1] = -1;
+}
+
+void CGIExecutor::closeInput()
+{
+    if (input_pipe_[1] != -1) {
+        close(input_pipe_[1]);
+        input_pipe_[1] = -1;
     }
-    close(input_pipe_[1]);  // Close after writing
+}
 
-    int exit_code = wait_for_child_with_timeout(pid);
+ssize_t CGIExecutor::readOutput(std::string& output)
+{
+    char buffer[4096];
+    ssize_t bytes_read = read(output_pipe_[0], buffer, sizeof(buffer));
+    if (bytes_read > 0) {
+        output.append(buffer, bytes_read);
+        return bytes_read;
+    }
+    if (bytes_read == -1 && (errno == EAGAIN || errno == EINTR)) {
+        return -1;
+    }
+    return 0;  // End of output, or a read error that ends it as well
+}
 
-    // Read script output
-    std::string output = readOutput();
-    if (output.empty())
-        output = readError();
+void CGIExecutor::readError(std::string& error)
+{
+    if (error_pipe_[0] == -1) {
+        return;
+    }
+    char buffer[4096];
+    ssize_t bytes_read;
 
-    return {exit_code, output};
+    while ((bytes_read = read(error_pipe_[0], buffer, sizeof(buffer))) > 0) {
+        error.append(buffer, bytes_read);
+    }
+    if (bytes_read == 0 || (errno != EAGAIN && errno != EINTR)) {
+        close(error_pipe_[0]);  // A pipe at its end would wake every wait on it
+        error_pipe_[0] = -1;
+    }
 }
 
-int CGIExecutor::wait_for_child_with_timeout(pid_t pid)
+int CGIExecutor::reap(bool wait)
 {
-    const int interval_ms = 100;
-    const int timeout_ms = TIMEOUT_MS;
-
-    int elapsed = 0;
+    if (pid_ == -1) {
+        return static_cast<int>(CGIExitStatus::Error);
+    }
     int status;
-
-    while (true) {
-        pid_t result = waitpid(pid, &status, WNOHANG);
-        if (result == -1) {
-            return static_cast<int>(CGIExitStatus::Error);
-        }
-        if (result == pid) {
-            if (WIFEXITED(status)) return WEXITSTATUS(status);
-            if (WIFSIGNALED(status)) return static_cast<int>(CGIExitStatus::KilledBySignal);
-            return static_cast<int>(CGIExitStatus::Error);
-        }
-
-        if (elapsed >= timeout_ms) {
-            kill(pid, SIGKILL);
-            waitpid(pid, &status, 0);
-            return static_cast<int>(CGIExitStatus::Timeout);
-        }
-
-        std::this_thread::sleep_for(std::chrono::milliseconds(interval_ms));
-        elapsed += interval_ms;
+    pid_t result = waitpid(pid_, &status, wait ? 0 : WNOHANG);
+    if (result == 0) {
+        return static_cast<int>(CGIExitStatus::Running);
+    }
+    pid_ = -1;
+    if (result == -1) {
+        return static_cast<int>(CGIExitStatus::Error);
     }
+    if (WIFEXITED(status)) return WEXITSTATUS(status);
+    if (WIFSIGNALED(status)) return static_cast<int>(CGIExitStatus::KilledBySignal);
+    return static_cast<int>(CGIExitStatus::Error);
 }
 
 void CGIExecutor::setupPipes()
 {
-    if (pipe(input_pipe_) == -1 || pipe(output_pipe_) == -1 || pipe(error_pipe_) == -1) {
-        throw std::runtime_error("Pipe creation failed: " + std::string(strerror(errno)));
+    // Close-on-exec so other scripts and upgrades do not hold them, non-blocking for the event loop
+    if (pipe2(input_pipe_, O_CLOEXEC | O_NONBLOCK) == -1 ||
+        pipe2(output_pipe_, O_CLOEXEC | O_NONBLOCK) == -1 ||
+        pipe2(error_pipe_, O_CLOEXEC | O_NONBLOCK) == -1) {
+        int error = errno;
+        closePipes();
+        throw std::runtime_error("Pipe creation failed: " + std::string(strerror(error)));
     }
 
-    // Set pipes to non-blocking mode
-    fcntl(output_pipe_[0], F_SETFL, O_NONBLOCK);
+    // The script gets blocking ends, only the server side is non-blocking
+    fcntl(input_pipe_[0], F_SETFL, 0);
+    fcntl(output_pipe_[1], F_SETFL, 0);
+    fcntl(error_pipe_[1], F_SETFL, 0);
 }
 
 void CGIExecutor::closePipes()
 {
-    close(input_pipe_[0]);
-    close(input_pipe_[1]);
-    close(output_pipe_[0]);
-    close(output_pipe_[1]);
-    close(error_pipe_[0]);
-    close(error_pipe_[1]);
+    for (int* fd : {&input_pipe_[0], &input_pipe_[1], &output_pipe_[0],
+                    &output_pipe_[1], &error_pipe_[0], &error_pipe_[1]}) {
+        if (*fd != -1) {
+            close(*fd);
+            *fd = -1;
+        }
+    }
 }
 
 std::vector<std::string> CGIExecutor::prepareEnvironment(
@@ -154,31 +192,3 @@ std::vector<std::string> CGIExecutor::prepareEnvironment(
 
     return result;
 }
-
-std::string CGIExecutor::readOutput()
-{
-    std::stringstream output;
-    char buffer[4096];
-    ssize_t bytes_read;
-
-    while ((bytes_read = read(output_pipe_[0], buffer, sizeof(buffer))) > 0) {
-        output.write(buffer, bytes_read);
-    }
-
-    close(output_pipe_[0]);
-    return output.str();
-}
-
-std::string CGIExecutor::readError()
-{
-    std::stringstream error;
-    char buffer[4096];
-    ssize_t bytes_read;
-
-    while ((bytes_read = read(error_pipe_[0], buffer, sizeof(buffer))) > 0) {
-        error.write(buffer, bytes_read);
-    }
-
-    close(error_pipe_[0]);
-    return error.str();
-}
\ No newline at end of file
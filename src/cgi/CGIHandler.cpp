@@ -11,7 +11,7 @@ CGIHandler::CGIHandler(const Location& location)
     }
 }
 
-std::pair<int, std::string> CGIHandler::handleRequest(
+void CGIHandler::start(
     const std::string& script_path,
     const std::string& request_method,
     const std::string& request_body,
@@ -32,8 +32,8 @@ std::pair<int, std::string> CGIHandler::handleRequest(
         request_body.length()
     );
 
-    // Execute the script
-    return executor_.execute(interpreter, script_path, request_body, env_vars);
+    // Start the script, the body is written to it by the caller
+    executor_.start(interpreter, script_path, env_vars);
 }
 
 std::string CGIHandler::getInterpreter(const std::string& script_path) const
@@ -2,13 +2,51 @@
 
 ConfigBuilder::ConfigBuilder() : config_(std::make_shared<Config>()) {}
 
+ConfigBuilder::ConfigBuilder(std::shared_ptr<Config> config) : config_(config) {}
+
 ConfigBuilder& ConfigBuilder::setPort(uint16_t port) {
     config_->port_ = port;
     return *this;
 }
 
-ConfigBuilder& ConfigBuilder::setServerName(const std::string& name) {
-    config_->server_name_ = name;
+ConfigBuilder& ConfigBuilder::setListenUnix(const std::string& path) {
+    config_->listen_unix_ = path;
+    config_->port_ = 0;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setListenUnixMode(uint32_t mode) {
+    config_->listen_unix_mode_ = mode;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setListenBacklog(uint64_t backlog) {
+    config_->listen_backlog_ = backlog;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setDeferredAccept(bool enabled) {
+    config_->deferred_accept_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setFastOpen(uint64_t queue) {
+    config_->fastopen_ = queue;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setReusePort(bool enabled) {
+    config_->reuseport_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setDefaultServer(bool enabled) {
+    config_->default_server_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setServerNames(const std::vector<std::string>& names) {
+    config_->server_names_ = names;
     return *this;
 }
 
@@ -17,6 +55,11 @@ ConfigBuilder& ConfigBuilder::setRoot(const std::string& root) {
     return *this;
 }
 
+ConfigBuilder& ConfigBuilder::setBundle(const std::string& bundle) {
+    config_->bundle_ = bundle;
+    return *this;
+}
+
 ConfigBuilder& ConfigBuilder::setIndex(const std::string& index) {
     config_->index_ = index;
     return *this;
@@ -32,6 +75,137 @@ ConfigBuilder& ConfigBuilder::addErrorPage(uint16_t code, const std::string& pag
     return *this;
 }
 
+ConfigBuilder& ConfigBuilder::setKeepaliveTimeout(uint64_t seconds) {
+    config_->keepalive_timeout_ = seconds;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setKeepaliveRequests(uint64_t requests) {
+    config_->keepalive_requests_ = requests;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setIoQuantum(uint64_t bytes) {
+    config_->io_quantum_ = bytes;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setSendfile(bool enabled) {
+    config_->sendfile_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setSendfileMaxChunk(uint64_t bytes) {
+    config_->sendfile_max_chunk_ = bytes;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setOpenFileCache(uint64_t max, uint64_t inactive) {
+    config_->open_file_cache_max_ = max;
+    config_->open_file_cache_inactive_ = inactive;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setOpenFileCacheValid(uint64_t seconds) {
+    config_->open_file_cache_valid_ = seconds;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setOpenFileCacheErrors(bool enabled) {
+    config_->open_file_cache_errors_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setClientHeaderTimeout(uint64_t seconds) {
+    config_->client_header_timeout_ = seconds;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setClientBodyTimeout(uint64_t seconds) {
+    config_->client_body_timeout_ = seconds;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setSendTimeout(uint64_t seconds) {
+    config_->send_timeout_ = seconds;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setWorkerThreads(uint64_t threads) {
+    config_->worker_threads_ = threads;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setWorkerProcesses(uint64_t processes) {
+    config_->worker_processes_ = processes;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setAioThreads(uint64_t threads) {
+    config_->aio_threads_ = threads;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setContentCacheSize(uint64_t bytes) {
+    config_->content_cache_size_ = bytes;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setContentCacheMaxFile(uint64_t bytes) {
+    config_->content_cache_max_file_ = bytes;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setWorkerCpuAffinity(bool enabled) {
+    config_->worker_cpu_affinity_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setEdgeTriggered(bool enabled) {
+    config_->edge_triggered_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setIoUring(bool enabled) {
+    config_->io_uring_ = enabled;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setMaxConnections(uint64_t connections) {
+    config_->max_connections_ = connections;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setGlobalMaxConnections(uint64_t connections) {
+    config_->global_max_connections_ = connections;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setBusyPoll(uint64_t usecs) {
+    config_->busy_poll_ = usecs;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::setBusyPollSpin(uint64_t usecs) {
+    config_->busy_poll_spin_ = usecs;
+    return *this;
+}
+
+ConfigBuilder& ConfigBuilder::inheritMain(const Config& main) {
+    config_->worker_threads_ = main.worker_threads_;
+    config_->worker_processes_ = main.worker_processes_;
+    config_->aio_threads_ = main.aio_threads_;
+    config_->content_cache_size_ = main.content_cache_size_;
+    config_->content_cache_max_file_ = main.content_cache_max_file_;
+    config_->worker_cpu_affinity_ = main.worker_cpu_affinity_;
+    config_->edge_triggered_ = main.edge_triggered_;
+    config_->io_uring_ = main.io_uring_;
+    config_->global_max_connections_ = main.global_max_connections_;
+    config_->busy_poll_ = main.busy_poll_;
+    config_->busy_poll_spin_ = main.busy_poll_spin_;
+    return *this;
+}
+
 void ConfigBuilder::startLocation(const std::string& path, Location::MatchType type) {
     current_location_ = std::make_shared<Location>(path, type);
     current_location_->index_ = config_.get()->getIndex();
@@ -57,6 +231,11 @@ void ConfigBuilder::setLocationAutoindex(bool enabled) {
     current_location_->autoindex_ = enabled;
 }
 
+void ConfigBuilder::setLocationWeight(uint64_t weight) {
+    ensureLocationContext("setLocationWeight");
+    current_location_->weight_ = weight;
+}
+
 void ConfigBuilder::setLocationRedirect(unsigned int code, const std::string& url) {
     ensureLocationContext("setLocationRedirect");
     if (!Location::isValidRedirectCode(code)) {
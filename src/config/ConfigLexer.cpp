@@ -61,7 +61,9 @@ Token ConfigLexer::readIdentifier() {
                c == '\\' || c == '|' ||                         // Regex escapes and alternation
                c == '[' || c == ']' ||                         // Character classes
                c == '(' || c == ')' ||                         // Groups
-               c == '^' || c == '$' || c == '+';              // Regex operators
+               c == '^' || c == '$' || c == '+' ||            // Regex operators
+               c == '*' ||                                     // Wildcard server names
+               c == ':';                                       // unix: listen addresses
     };
     return readWhile(isValidIdentChar, TokenType::IDENTIFIER);
 }
@@ -149,7 +151,8 @@ Token ConfigLexer::nextToken() {
     }
 
     if (std::isalpha(static_cast<unsigned char>(current_char_)) || 
-        current_char_ == '_' || current_char_ == '/' || current_char_ == '\\') {
+        current_char_ == '_' || current_char_ == '/' || current_char_ == '\\' ||
+        current_char_ == '*' || current_char_ == '.') {
         return readIdentifier();
     }
 
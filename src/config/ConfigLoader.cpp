@@ -19,11 +19,9 @@ std::vector<std::shared_ptr<Config>> ConfigLoader::load(const char* path) {
         // Parse configuration from file
         std::vector<std::shared_ptr<Config>> configs = ConfigParser::parse(config_file);
 
-        // Validate each server configuration
-        for (const auto& config : configs) {
-            ConfigValidator::validate(*config);
-        }
-        
+        // Validate each server configuration and the server blocks sharing a port
+        ConfigValidator::validateConfigs(configs);
+
         return configs;
     } catch (const ConfigParser::ParseError& e) {
         // Add file path context to parsing errors
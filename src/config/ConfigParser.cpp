@@ -96,12 +96,17 @@ void ConfigParser::handleDirective(const std::string& directive,
 
 std::vector<std::shared_ptr<Config>> ConfigParser::parseConfigs() {
     std::vector<std::shared_ptr<Config>> configs;
+    ConfigBuilder main_builder;
     advance();
 
     while (current_token_.type != TokenType::END_OF_FILE) {
-        if (current_token_.value != "server") {
+        if (current_token_.type != TokenType::IDENTIFIER) {
             throw ParseError("Expected 'server' block", current_token_);
         }
+        if (current_token_.value != "server") {
+            parseMainDirective(main_builder);
+            continue;
+        }
         advance();
 
         configs.push_back(parseServerBlock());
@@ -111,9 +116,79 @@ std::vector<std::shared_ptr<Config>> ConfigParser::parseConfigs() {
         throw ParseError("No server blocks found in configuration", current_token_);
     }
 
+    // Main context settings apply to every server block, wherever they were written
+    std::shared_ptr<Config> main = main_builder.build();
+    for (auto& config : configs) {
+        ConfigBuilder(config).inheritMain(*main);
+    }
+
     return configs;
 }
 
+void ConfigParser::parseMainDirective(ConfigBuilder& builder) {
+    Token directive_token = current_token_;
+    std::string directive = expectIdentifier("Expected directive name");
+    if (directive == "worker_threads") {
+        uint64_t threads = readNumber("Expected number of worker threads");
+        builder.setWorkerThreads(threads);
+        expectSemicolon();
+    } else if (directive == "worker_processes") {
+        uint64_t processes = readNumber("Expected number of worker processes");
+        builder.setWorkerProcesses(processes);
+        expectSemicolon();
+    } else if (directive == "aio_threads") {
+        uint64_t threads = readNumber("Expected number of aio threads");
+        builder.setAioThreads(threads);
+        expectSemicolon();
+    } else if (directive == "content_cache") {
+        uint64_t bytes = readNumber("Expected content cache size in bytes");
+        builder.setContentCacheSize(bytes);
+        expectSemicolon();
+    } else if (directive == "content_cache_max_file") {
+        uint64_t bytes = readNumber("Expected largest cached file in bytes");
+        builder.setContentCacheMaxFile(bytes);
+        expectSemicolon();
+    } else if (directive == "worker_cpu_affinity") {
+        handleDirective(directive, builder,
+            [](ConfigBuilder& b, const std::string& value) { b.setWorkerCpuAffinity(value == "on"); },
+            [](const Token& token) {
+                if (token.value != "on" && token.value != "off") {
+                    throw ParseError("worker_cpu_affinity value must be 'on' or 'off'", token, true);
+                }
+            });
+    } else if (directive == "epoll_mode") {
+        handleDirective(directive, builder,
+            [](ConfigBuilder& b, const std::string& value) { b.setEdgeTriggered(value == "edge"); },
+            [](const Token& token) {
+                if (token.value != "edge" && token.value != "level") {
+                    throw ParseError("epoll_mode value must be 'edge' or 'level'", token, true);
+                }
+            });
+    } else if (directive == "event_backend") {
+        handleDirective(directive, builder,
+            [](ConfigBuilder& b, const std::string& value) { b.setIoUring(value == "io_uring"); },
+            [](const Token& token) {
+                if (token.value != "epoll" && token.value != "io_uring") {
+                    throw ParseError("event_backend value must be 'epoll' or 'io_uring'", token, true);
+                }
+            });
+    } else if (directive == "max_connections") {
+        uint64_t connections = readNumber("Expected maximum number of connections");
+        builder.setGlobalMaxConnections(connections);
+        expectSemicolon();
+    } else if (directive == "busy_poll") {
+        uint64_t usecs = readNumber("Expected busy poll time in microseconds");
+        builder.setBusyPoll(usecs);
+        expectSemicolon();
+    } else if (directive == "busy_poll_spin") {
+        uint64_t usecs = readNumber("Expected spin time in microseconds");
+        builder.setBusyPollSpin(usecs);
+        expectSemicolon();
+    } else {
+        throw ParseError("Expected 'server' block", directive_token);
+    }
+}
+
 std::shared_ptr<Config> ConfigParser::parseServerBlock() {
     ConfigBuilder builder;
     parseServerBlockContent(builder);
@@ -193,6 +268,10 @@ void ConfigParser::parseLocationDirective(ConfigBuilder& builder, const std::str
         parseLocationMethods(builder);
     } else if (directive == "autoindex") {
         parseLocationAutoindex(builder);
+    } else if (directive == "weight") {
+        uint64_t weight = readNumber("Expected location weight");
+        builder.setLocationWeight(weight);
+        expectSemicolon();
     } else if (directive == "return") {
         parseLocationReturn(builder);
     } else if (directive == "cgi_path") {
@@ -284,20 +363,126 @@ void ConfigParser::parseLocationCGIExt(ConfigBuilder& builder) {
     expectSemicolon();
 }
 
-void ConfigParser::parseServerDirective(ConfigBuilder& builder, const std::string& directive) {
-    if (directive == "listen") {
+void ConfigParser::parseServerListen(ConfigBuilder& builder) {
+    bool unix_socket = current_token_.type == TokenType::IDENTIFIER && current_token_.value.rfind("unix:", 0) == 0;
+    if (unix_socket) {
+        Token address = current_token_;
+        std::string path = expectIdentifier("Expected unix socket path").substr(5);
+        if (path.empty()) {
+            throw ParseError("Expected unix socket path after unix:", address);
+        }
+        builder.setListenUnix(path);
+    } else {
         uint64_t port = readNumber("Expected port number");
         if (port > 65535) {
             throw ParseError("Port number out of range", valueToken);
         }
         builder.setPort(static_cast<uint16_t>(port));
+    }
+
+    // Optional socket parameters: default_server backlog=N deferred fastopen=N reuseport mode=0660
+    while (current_token_.type == TokenType::IDENTIFIER) {
+        Token param = current_token_;
+        std::string name = expectIdentifier("Expected listen parameter");
+        if (name == "mode") {
+            if (!unix_socket) {
+                throw ParseError("mode is only valid for unix sockets", param);
+            }
+            if (current_token_.type != TokenType::MODIFIER || current_token_.value != "=") {
+                throw ParseError("Expected '=' after mode", current_token_);
+            }
+            advance();
+            Token mode = current_token_;
+            if (mode.type != TokenType::NUMBER || mode.value.size() > 4 ||
+                mode.value.find_first_not_of("01234567") != std::string::npos) {
+                throw ParseError("Expected octal permissions for mode, like 0660", mode);
+            }
+            builder.setListenUnixMode(static_cast<uint32_t>(std::stoul(mode.value, nullptr, 8)));
+            advance();
+        } else if (name == "default_server") {
+            builder.setDefaultServer(true);
+        } else if (name == "deferred") {
+            builder.setDeferredAccept(true);
+        } else if (name == "reuseport") {
+            builder.setReusePort(true);
+        } else if (name == "backlog" || name == "fastopen") {
+            if (current_token_.type != TokenType::MODIFIER || current_token_.value != "=") {
+                throw ParseError("Expected '=' after " + name, current_token_);
+            }
+            advance();
+            uint64_t value = readNumber("Expected number for " + name);
+            if (value > 65535) {
+                throw ParseError(name + " value out of range", valueToken);
+            }
+            if (name == "backlog") {
+                if (value == 0) {
+                    throw ParseError("backlog must be at least 1", valueToken);
+                }
+                builder.setListenBacklog(value);
+            } else {
+                builder.setFastOpen(value);
+            }
+        } else {
+            throw ParseError("Unknown listen parameter: " + name, param);
+        }
+    }
+    expectSemicolon();
+}
+
+void ConfigParser::parseServerName(ConfigBuilder& builder) {
+    auto names = readValueList("Expected server name(s)");
+    if (names.empty()) {
+        throw ParseError("Expected at least one server name", valueToken, true);
+    }
+    builder.setServerNames(names);
+    expectSemicolon();
+}
+
+void ConfigParser::parseServerOpenFileCache(ConfigBuilder& builder) {
+    // open_file_cache off | max=N [inactive=seconds]
+    if (current_token_.type == TokenType::IDENTIFIER && current_token_.value == "off") {
+        advance();
+        builder.setOpenFileCache(0, 60);
         expectSemicolon();
+        return;
+    }
+    uint64_t max = 0;
+    uint64_t inactive = 60;
+    while (current_token_.type == TokenType::IDENTIFIER) {
+        Token param = current_token_;
+        std::string name = expectIdentifier("Expected open_file_cache parameter");
+        if (name != "max" && name != "inactive") {
+            throw ParseError("Unknown open_file_cache parameter: " + name, param);
+        }
+        if (current_token_.type != TokenType::MODIFIER || current_token_.value != "=") {
+            throw ParseError("Expected '=' after " + name, current_token_);
+        }
+        advance();
+        uint64_t value = readNumber("Expected number for " + name);
+        if (name == "max") {
+            max = value;
+        } else {
+            inactive = value;
+        }
+    }
+    if (max == 0) {
+        throw ParseError("open_file_cache needs max=N or off", current_token_);
+    }
+    builder.setOpenFileCache(max, inactive);
+    expectSemicolon();
+}
+
+void ConfigParser::parseServerDirective(ConfigBuilder& builder, const std::string& directive) {
+    if (directive == "listen") {
+        parseServerListen(builder);
     } else if (directive == "server_name") {
-        handleDirective(directive, builder,
-            [](ConfigBuilder& b, const std::string& value) { b.setServerName(value); });
+        parseServerName(builder);
     } else if (directive == "root") {
         handleDirective(directive, builder,
             [](ConfigBuilder& b, const std::string& value) { b.setRoot(value); });
+    } else if (directive == "bundle") {
+        handleDirective(directive, builder,
+            [](ConfigBuilder& b, const std::string& value) { b.setBundle(value); });
     } else if (directive == "index") {
         handleDirective(directive, builder,
             [](ConfigBuilder& b, const std::string& value) { b.setIndex(value); });
@@ -313,6 +498,60 @@ void ConfigParser::parseServerDirective(ConfigBuilder& builder, const std::strin
         std::string page = readValue("Expected error page path");
         builder.addErrorPage(static_cast<uint16_t>(code), page);
         expectSemicolon();
+    } else if (directive == "keepalive_timeout") {
+        uint64_t seconds = readNumber("Expected keepalive timeout in seconds");
+        builder.setKeepaliveTimeout(seconds);
+        expectSemicolon();
+    } else if (directive == "keepalive_requests") {
+        uint64_t requests = readNumber("Expected keepalive request count");
+        builder.setKeepaliveRequests(requests);
+        expectSemicolon();
+    } else if (directive == "client_header_timeout") {
+        uint64_t seconds = readNumber("Expected client header timeout in seconds");
+        builder.setClientHeaderTimeout(seconds);
+        expectSemicolon();
+    } else if (directive == "client_body_timeout") {
+        uint64_t seconds = readNumber("Expected client body timeout in seconds");
+        builder.setClientBodyTimeout(seconds);
+        expectSemicolon();
+    } else if (directive == "send_timeout") {
+        uint64_t seconds = readNumber("Expected send timeout in seconds");
+        builder.setSendTimeout(seconds);
+        expectSemicolon();
+    } else if (directive == "max_connections") {
+        uint64_t connections = readNumber("Expected maximum number of connections");
+        builder.setMaxConnections(connections);
+        expectSemicolon();
+    } else if (directive == "io_quantum") {
+        uint64_t bytes = readNumber("Expected io quantum in bytes");
+        builder.setIoQuantum(bytes);
+        expectSemicolon();
+    } else if (directive == "sendfile") {
+        handleDirective(directive, builder,
+            [](ConfigBuilder& b, const std::string& value) { b.setSendfile(value == "on"); },
+            [](const Token& token) {
+                if (token.value != "on" && token.value != "off") {
+                    throw ParseError("sendfile value must be 'on' or 'off'", token, true);
+                }
+            });
+    } else if (directive == "sendfile_max_chunk") {
+        uint64_t bytes = readNumber("Expected sendfile max chunk in bytes");
+        builder.setSendfileMaxChunk(bytes);
+        expectSemicolon();
+    } else if (directive == "open_file_cache") {
+        parseServerOpenFileCache(builder);
+    } else if (directive == "open_file_cache_valid") {
+        uint64_t seconds = readNumber("Expected open file cache validity in seconds");
+        builder.setOpenFileCacheValid(seconds);
+        expectSemicolon();
+    } else if (directive == "open_file_cache_errors") {
+        handleDirective(directive, builder,
+            [](ConfigBuilder& b, const std::string& value) { b.setOpenFileCacheErrors(value == "on"); },
+            [](const Token& token) {
+                if (token.value != "on" && token.value != "off") {
+                    throw ParseError("open_file_cache_errors value must be 'on' or 'off'", token, true);
+                }
+            });
     } else {
         throw ParseError("Unknown server directive: " + directive, current_token_);
     }
@@ -24,11 +24,49 @@ void ConfigPrinter::print(std::ostream& out, const Config& config) {
 }
 
 void ConfigPrinter::printServerInfo(std::ostream& out, const Config& config) {
-    out << "Port: " << config.getPort() << NEWLINE
-        << "Server name: " << config.getServerName() << NEWLINE
+    if (config.getListenUnix().empty()) {
+        out << "Port: " << config.getPort() << NEWLINE;
+    } else {
+        out << "Unix socket: " << config.getListenUnix() << " mode "
+            << std::oct << config.getListenUnixMode() << std::dec << NEWLINE;
+    }
+    out << "Listen options: backlog " << config.getListenBacklog() << " (0 is SOMAXCONN)"
+        << (config.getDeferredAccept() ? ", deferred" : "")
+        << ", fastopen " << config.getFastOpen()
+        << (config.getReusePort() ? ", reuseport" : "")
+        << (config.getDefaultServer() ? ", default_server" : "") << NEWLINE
+        << "Server names:";
+    for (const auto& name : config.getServerNames()) {
+        out << " " << name;
+    }
+    out << NEWLINE
         << "Root: " << config.getRoot() << NEWLINE
+        << "Bundle: " << (config.getBundle().empty() ? "none" : config.getBundle()) << NEWLINE
         << "Index: " << config.getIndex() << NEWLINE
         << "Client max body size: " << config.getClientMaxBodySize() << " bytes" << NEWLINE
+        << "Keepalive: " << config.getKeepaliveTimeout() << "s, "
+        << config.getKeepaliveRequests() << " requests" << NEWLINE
+        << "Timeouts: header " << config.getClientHeaderTimeout() << "s, body "
+        << config.getClientBodyTimeout() << "s, send "
+        << config.getSendTimeout() << "s" << NEWLINE
+        << "Worker threads: " << config.getWorkerThreads()
+        << (config.getWorkerCpuAffinity() ? " (pinned)" : "") << NEWLINE
+        << "Worker processes: " << config.getWorkerProcesses() << " (0 is a single process)" << NEWLINE
+        << "Aio threads: " << config.getAioThreads() << " (0 is on the event loop)" << NEWLINE
+        << "Content cache: " << config.getContentCacheSize() << " bytes per worker (0 is off), files up to "
+        << config.getContentCacheMaxFile() << " bytes" << NEWLINE
+        << "Epoll mode: " << (config.getEdgeTriggered() ? "edge" : "level") << NEWLINE
+        << "Event backend: " << (config.getIoUring() ? "io_uring" : "epoll") << NEWLINE
+        << "Busy poll: " << config.getBusyPoll() << "us, spin "
+        << config.getBusyPollSpin() << "us (0 is off)" << NEWLINE
+        << "Max connections: " << config.getMaxConnections() << " (process "
+        << config.getGlobalMaxConnections() << ", 0 is no limit)" << NEWLINE
+        << "IO quantum: " << config.getIoQuantum() << " bytes (0 is no limit)" << NEWLINE
+        << "Sendfile: " << (config.getSendfile() ? "on" : "off") << ", max chunk "
+        << config.getSendfileMaxChunk() << " bytes (0 is no limit)" << NEWLINE
+        << "Open file cache: " << config.getOpenFileCacheMax() << " paths (0 is off), inactive "
+        << config.getOpenFileCacheInactive() << "s, valid " << config.getOpenFileCacheValid() << "s, errors "
+        << (config.getOpenFileCacheErrors() ? "on" : "off") << NEWLINE
         << "Number of locations: " << config.getLocations().size();
 }
 
@@ -86,6 +124,7 @@ void ConfigPrinter::printLocation(std::ostream& out, const Location& location) {
     }
     
     out << INDENT << "Autoindex: " << (location.getAutoindex() ? "on" : "off") << NEWLINE;
+    out << INDENT << "Weight: " << location.getWeight() << NEWLINE;
     
     printMethods(out, location.getAllowedMethods());
     
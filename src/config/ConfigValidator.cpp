@@ -1,6 +1,7 @@
 #include "Config.hpp"
+#include <cctype>
 
-void ConfigValidator::validateConfigs(const std::vector<std::unique_ptr<Config>>& configs) {
+void ConfigValidator::validateConfigs(const std::vector<std::shared_ptr<Config>>& configs) {
     if (configs.empty()) {
         throw ValidationError("No server configurations found");
     }
@@ -11,26 +12,57 @@ void ConfigValidator::validateConfigs(const std::vector<std::unique_ptr<Config>>
     }
 
     // Then validate inter-server requirements
-    validateNoDuplicatePorts(configs);
+    validateVirtualHosts(configs);
 }
 
-void ConfigValidator::validateNoDuplicatePorts(const std::vector<std::unique_ptr<Config>>& configs) {
-    std::set<uint16_t> used_ports;
+void ConfigValidator::validateVirtualHosts(const std::vector<std::shared_ptr<Config>>& configs) {
+    // Server blocks on the same port or unix socket share one socket and are picked by the Host header
+    std::set<std::string> default_ports;
+    std::set<std::pair<std::string, std::string>> used_names;
     for (const auto& config : configs) {
-        uint16_t port = config->getPort();
-        if (!used_ports.insert(port).second) {
-            throw ValidationError("Duplicate port number found: " + std::to_string(port));
+        std::string port = config->getListenUnix().empty() ? "port " + std::to_string(config->getPort())
+                                                            : "unix:" + config->getListenUnix();
+        if (config->getDefaultServer() && !default_ports.insert(port).second) {
+            throw ValidationError("Duplicate default_server on " + port);
+        }
+        for (std::string name : config->getServerNames()) {
+            for (char& ch : name) {
+                ch = std::tolower(static_cast<unsigned char>(ch));
+            }
+            if (!used_names.insert({port, name}).second) {
+                throw ValidationError("Duplicate server name " + name + " on " + port);
+            }
         }
     }
 }
 
 void ConfigValidator::validate(const Config& config) {
     // Validate server settings
-    validatePort(config.getPort());
-    validateServerName(config.getServerName());
+    if (config.getListenUnix().empty()) {
+        validatePort(config.getPort());
+    } else {
+        validateListenUnix(config);
+    }
+    for (const auto& name : config.getServerNames()) {
+        validateServerName(name);
+    }
     validatePath(config.getRoot(), "server root");
+    if (!config.getBundle().empty()) {
+        validatePath(config.getBundle(), "server bundle");
+    }
     validateFilename(config.getIndex(), "server index");
     validateClientMaxBodySize(config.getClientMaxBodySize());
+    validateKeepaliveTimeout(config.getKeepaliveTimeout());
+    validateTimeout(config.getClientHeaderTimeout(), "Client header timeout");
+    validateTimeout(config.getClientBodyTimeout(), "Client body timeout");
+    validateTimeout(config.getSendTimeout(), "Send timeout");
+    validateWorkerThreads(config.getWorkerThreads());
+    validateWorkerProcesses(config.getWorkerProcesses());
+    validateAioThreads(config.getAioThreads());
+    validateBusyPoll(config.getBusyPoll(), "Busy poll");
+    validateBusyPoll(config.getBusyPollSpin(), "Busy poll spin");
+    validateOpenFileCache(config);
+    validateContentCache(config);
 
     // Validate error pages
     for (const auto& [code, path] : config.getErrorPages()) {
@@ -75,6 +107,16 @@ void ConfigValidator::validatePort(uint16_t port) {
     }
 }
 
+void ConfigValidator::validateListenUnix(const Config& config) {
+    validatePath(config.getListenUnix(), "listen unix socket");
+    if (config.getListenUnix().length() > MAX_UNIX_PATH_LENGTH) {
+        throw ValidationError("listen unix socket: Path exceeds " + std::to_string(MAX_UNIX_PATH_LENGTH) + " characters: " + config.getListenUnix());
+    }
+    if (config.getDeferredAccept() || config.getFastOpen() > 0 || config.getReusePort()) {
+        throw ValidationError("deferred, fastopen and reuseport only work on TCP ports, not on unix:" + config.getListenUnix());
+    }
+}
+
 void ConfigValidator::validateMethod(const std::string& method) {
     if (valid_methods_.find(method) == valid_methods_.end()) {
         throw ValidationError("Invalid HTTP method: " + method);
@@ -115,6 +157,73 @@ void ConfigValidator::validateClientMaxBodySize(uint64_t size) {
     }
 }
 
+void ConfigValidator::validateKeepaliveTimeout(uint64_t seconds) {
+    if (seconds > MAX_TIMEOUT) {
+        throw ValidationError("Keepalive timeout exceeds maximum allowed (" +
+            std::to_string(MAX_TIMEOUT) + " seconds)");
+    }
+}
+
+void ConfigValidator::validateTimeout(uint64_t seconds, const std::string& context) {
+    if (seconds == 0) {
+        throw ValidationError(context + " cannot be 0");
+    }
+    if (seconds > MAX_TIMEOUT) {
+        throw ValidationError(context + " exceeds maximum allowed (" +
+            std::to_string(MAX_TIMEOUT) + " seconds)");
+    }
+}
+
+void ConfigValidator::validateBusyPoll(uint64_t usecs, const std::string& context) {
+    if (usecs > MAX_BUSY_POLL) {
+        throw ValidationError(context + " exceeds maximum allowed (" +
+            std::to_string(MAX_BUSY_POLL) + " microseconds)");
+    }
+}
+
+void ConfigValidator::validateWorkerThreads(uint64_t threads) {
+    if (threads == 0) {
+        throw ValidationError("Worker threads cannot be 0");
+    }
+    if (threads > MAX_WORKER_THREADS) {
+        throw ValidationError("Worker threads exceeds maximum allowed (" +
+            std::to_string(MAX_WORKER_THREADS) + ")");
+    }
+}
+
+void ConfigValidator::validateWorkerProcesses(uint64_t processes) {
+    if (processes > MAX_WORKER_PROCESSES) {
+        throw ValidationError("Worker processes exceeds maximum allowed (" +
+            std::to_string(MAX_WORKER_PROCESSES) + ")");
+    }
+}
+
+void ConfigValidator::validateAioThreads(uint64_t threads) {
+    if (threads > MAX_AIO_THREADS) {
+        throw ValidationError("Aio threads exceeds maximum allowed (" +
+            std::to_string(MAX_AIO_THREADS) + ")");
+    }
+}
+
+void ConfigValidator::validateOpenFileCache(const Config& config) {
+    if (config.getOpenFileCacheMax() > MAX_OPEN_FILE_CACHE) {
+        throw ValidationError("Open file cache max exceeds maximum allowed (" +
+            std::to_string(MAX_OPEN_FILE_CACHE) + ")");
+    }
+    validateTimeout(config.getOpenFileCacheInactive(), "Open file cache inactive");
+    validateTimeout(config.getOpenFileCacheValid(), "Open file cache valid");
+}
+
+void ConfigValidator::validateContentCache(const Config& config) {
+    if (config.getContentCacheSize() > MAX_CONTENT_CACHE) {
+        throw ValidationError("Content cache exceeds maximum allowed (" +
+            std::to_string(MAX_CONTENT_CACHE) + " bytes)");
+    }
+    if (config.getContentCacheSize() > 0 && config.getContentCacheMaxFile() == 0) {
+        throw ValidationError("Content cache max file cannot be 0");
+    }
+}
+
 void ConfigValidator::validateReturnDirective(const Location::ReturnDirective& ret, const std::string& context) {
     if (ret.type == Location::ReturnType::NONE) {
         return;  // No return directive to validate
@@ -176,6 +285,11 @@ void ConfigValidator::validateLocation(const Location& location) {
     
     validateMethods(location.getAllowedMethods());
 
+    if (location.getWeight() == 0 || location.getWeight() > MAX_LOCATION_WEIGHT) {
+        throw ValidationError("Location " + location.getPath() + " weight must be between 1 and " +
+            std::to_string(MAX_LOCATION_WEIGHT));
+    }
+
     // Validate return directive if present
     if (location.hasReturn()) {
         validateReturnDirective(location.getReturn(), 
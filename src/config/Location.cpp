@@ -21,6 +21,7 @@ Location::Location(const Location& other)
     , index_(other.index_)
     , allowed_methods_(other.allowed_methods_)
     , autoindex_(other.autoindex_)
+    , weight_(other.weight_)
     , return_directive_(other.return_directive_)
     , cgi_config_(other.cgi_config_)
     , regex_(other.regex_) {}
@@ -33,6 +34,7 @@ Location& Location::operator=(const Location& other) {
         index_ = other.index_;
         allowed_methods_ = other.allowed_methods_;
         autoindex_ = other.autoindex_;
+        weight_ = other.weight_;
         return_directive_ = other.return_directive_;
         cgi_config_ = other.cgi_config_;
         regex_ = other.regex_;
@@ -64,6 +66,10 @@ bool Location::getAutoindex() const {
     return autoindex_;
 }
 
+uint64_t Location::getWeight() const {
+    return weight_;
+}
+
 const Location::ReturnDirective& Location::getReturn() const {
     return return_directive_;
 }
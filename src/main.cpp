@@ -1,18 +1,25 @@
 #include "Config.hpp"
 #include <iostream>
 #include "Server.hpp"
+#include "server/ServerWorkerPool.hpp"
+#include "server/ServerMaster.hpp"
+#include "server/ServerBundle.hpp"
 #include <signal.h>
 
 int main(int argc, char* argv[]) {
     ::signal(SIGPIPE, SIG_IGN);
-    (void) argc;
+    if (argc == 4 && std::string(argv[1]) == "--pack") // webserv --pack <root> <bundle>
+        return ServerBundle::pack(argv[2], argv[3]) == 0 ? 0 : 1;
     try {
         std::vector<std::shared_ptr<Config>> configs = ConfigLoader::load(argv[1]);
-        Server server(configs);
-        int nr = server.setupEpoll();
-        if (nr != 0)
-            return nr * -1;
-        nr = server.serverLoop();
+        ServerListenFds listen_fds;
+        if (configs[0]->getWorkerProcesses() > 0) {
+            ServerMaster master(configs, argv[1], listen_fds);
+            return master.run() * -1;
+        }
+        s_worker_counters counters{};
+        ServerWorkerPool workers(configs, argv[1], listen_fds, counters);
+        int nr = workers.run();
         return nr * -1;
         // ConfigPrinter::printConfigs(std::cout, configs);
     }
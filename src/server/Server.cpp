@@ -6,33 +6,61 @@
 #include <errno.h>
 #include <iostream>
 #include <unistd.h>
-#include <sys/timerfd.h>
 #include <sys/stat.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <sys/un.h>
 
-Server::Server(std::vector<std::shared_ptr<Config>>& config) : validator_()
+Server::Server(ServerReload& reload, ServerListenFds& listen_fds, ServerUpgrade& upgrade, ServerAioPool& aio, s_worker_counters& counters, size_t worker_id) : reload_(reload), listen_fds_(listen_fds), upgrade_(upgrade), aio_(aio), counters_(counters), validator_()
 {
-    conf_size_ = config.size();
-    config_info_.reserve(conf_size_);
+    paused_listeners_ = 0;
+    spare_fd_ = -1;
+    fd_retry_at_ = 0;
+    signal_fd_ = -1;
+    wake_fd_ = -1;
+    worker_id_ = worker_id;
+    spin_hits_ = 0;
+    spin_misses_ = 0;
+    clients_ = 0;
+    draining_ = false;
+    accepting_ = true;
+    drained_ = false;
+    stopping_ = false;
+    run_round_ = 1;
+    std::shared_ptr<const s_config_generation> config = reload.current();
+    busy_poll_ = config->configs[0]->getBusyPoll();
+    spin_budget_us_ = config->configs[0]->getBusyPollSpin();
+    reuse_port_ = config->configs[0]->getWorkerThreads() > 1 || config->configs[0]->getWorkerProcesses() > 0;
+    trigger_mode_ = config->configs[0]->getEdgeTriggered() ? static_cast<uint32_t>(EPOLLET) : 0;
+    generation_ = makeGeneration(config);
+    if (generation_ == nullptr)
+        throw std::runtime_error("failed to setup server socket");
+}
 
-    for (size_t i = 0; i < conf_size_; ++i)
+Server::~Server()
+{
+    // coroutines still waiting stop watching their fds while the event loop is still there
+    for (int fd = 0; fd < connections_.end(); ++fd)
     {
-        configInfo con_info(config[i]);
-        if (createServerSocket(con_info.server_name_, con_info.port_, con_info.server_fd_))
-        {
-            if (i > 0)
-                for (size_t j = 0; j < i; ++j)
-                    close(config_info_[j].server_fd_);
-            std::cerr << "create server socket error\n";
-            throw std::runtime_error("failed to setup server socket");
-        }
-        config_info_.push_back({con_info});
+        s_connection* conn = connections_.get(fd);
+        if (conn != nullptr && conn->type == FD_CLIENT)
+            conn->data->task = ServerTask();
     }
-}
-
-Server::~Server() {};
+    if (spare_fd_ != -1)
+        close(spare_fd_);
+    if (signal_fd_ != -1)
+        close(signal_fd_);
+    if (wake_fd_ != -1)
+        close(wake_fd_);
+};
 
 /**
- * @brief Creates the epoll that will hold all events to listen to. 
+ * @brief Creates the epoll that will hold all events to listen to,
+ * or the io_uring when it is configured and the kernel supports it.
  * Sets up the server socket, and adds the needed fd to the epoll
  * 
  * @return 0 when done,
@@ -41,52 +69,101 @@ Server::~Server() {};
  */
 int Server::setupEpoll()
 {
-    epoll_fd_ = epoll_create(MAX_EVENTS);
-    if (epoll_fd_ == -1)
+    epoll_fd_ = -1;
+    // reserved so a client can still be turned away when the process runs out of fds
+    spare_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    std::vector<configInfo>& servers = generation_->servers_;
+    if (servers[0].config_->getIoUring())
+    {
+        if (uring_.setup() == 0)
+            trigger_mode_ = EPOLLET; // multishot polls only report new readiness
+        else
+            std::cerr << "io_uring not available, falling back to epoll\n";
+    }
+    if (!uring_.active())
+        epoll_fd_ = epoll_create(MAX_EVENTS);
+    if (!uring_.active() && epoll_fd_ == -1)
     {
         std::cerr << "epoll_create error\n";
         int nr = validator_.checkErrno(errno);
-        for (configInfo& con : config_info_)
-            close(con.server_fd_);
+        closeListeners();
         return nr;
     }
+    setupBusyPoll();
+
+    // only the first worker captures the standard output and standard error of the process
+    int nr = 0;
+    if (worker_id_ == 0)
+    {
+        if (setupPipe() != 0)
+        {
+            std::cerr << "creating pipes for STDOUT and STDERR failed\n";
+            close(epoll_fd_);
+            closeListeners();
+            return -1;
+        }
+        nr = putCoutCerrInEpoll();
+        if (nr != 0)
+        {
+            close(stdout_pipe_[0]);
+            close(stderr_pipe_[0]);
+            close(epoll_fd_);
+            closeListeners();
+            return nr;
+        }
+    }
+    else
+    {
+        stdout_pipe_[0] = -1;
+        stdout_pipe_[1] = -1;
+        stderr_pipe_[0] = -1;
+        stderr_pipe_[1] = -1;
+    }
 
-    if (setupPipe() != 0)
+    if (setupReload() != 0)
     {
-        std::cerr << "creating pipes for STDOUT and STDERR failed\n";
+        std::cerr << "setting up config reloading failed\n";
         close(epoll_fd_);
-        for(configInfo& con : config_info_)
-            close(con.server_fd_);
+        closeListeners();
         return -1;
     }
-    int nr = putCoutCerrInEpoll();
-    if (nr != 0)
+    if (setupAio() != 0)
     {
-        close(stdout_pipe_[0]);
-        close(stderr_pipe_[0]);
+        std::cerr << "setting up the aio completions failed\n";
         close(epoll_fd_);
-        for(configInfo& con : config_info_)
-            close(con.server_fd_);
-        return nr;
+        closeListeners();
+        return -1;
     }
-
-    for (size_t i = 0; i < conf_size_; ++i)
+    if (setupContentCache() != 0)
     {
-        epoll_event event{};
-        event.events = EPOLLIN;
-        event.data.fd = config_info_[i].server_fd_;
+        std::cerr << "setting up the content cache failed\n";
+        close(epoll_fd_);
+        closeListeners();
+        return -1;
+    }
 
-        nr = doEpollCtl(EPOLL_CTL_ADD, config_info_[i].server_fd_, &event);
-        if (nr != 0)
+    std::vector<int> listener_fds;
+    for (configInfo& server : servers)
+    {
+        setPipes(server);
+        if (server.server_fd_ == -1) // answers on the listener of another server block
+            continue;
+        if (uring_.active())
+            listener_fds.push_back(server.server_fd_);
+        else if ((nr = watchListener(server)) != 0)
         {
-            std::cerr << "adding server_fd " << i << "failed\n";
+            std::cerr << "adding server_fd " << server.index_ << "failed\n";
             close(epoll_fd_);
-            for(configInfo& con : config_info_)
-                close(con.server_fd_);
-        }  
-        config_info_[i].responseHandler_.setStdoutPipe(stdout_pipe_);
-        config_info_[i].requestHandler_.setStdoutPipe(stdout_pipe_);
-        config_info_[i].requestHandler_.setStderrPipe(stderr_pipe_);
+            closeListeners();
+            return nr;
+        }
+        connections_.add(server.server_fd_, FD_LISTENER, &server);
+    }
+    if (uring_.active() && uring_.addListeners(listener_fds) != 0)
+    {
+        std::cerr << "starting accept on the io_uring failed\n";
+        closeListeners();
+        return -1;
     }
     return 0;
 }
@@ -97,48 +174,164 @@ int Server::serverLoop()
     int nr = listenLoop();
     if (nr < 0)
     {
-        close(stdout_pipe_[0]);
-        close(stderr_pipe_[0]);
+        if (worker_id_ == 0)
+        {
+            close(stdout_pipe_[0]);
+            close(stderr_pipe_[0]);
+        }
         close(epoll_fd_);
-        for(configInfo& con : config_info_)
-            close(con.server_fd_);
+        closeListeners();
         return nr;
     }
-    close(stdout_pipe_[0]);
-    close(stderr_pipe_[0]);
+    if (worker_id_ == 0)
+    {
+        close(stdout_pipe_[0]);
+        close(stderr_pipe_[0]);
+    }
     return 0;
 }
+
+/**
+ * @brief hands the listeners this worker created to the listen fds.
+ * A master process makes the listeners once this way, the worker processes it starts take them from there
+ */
+void Server::shareListeners()
+{
+    for (configInfo& con : generation_->servers_)
+    {
+        if (con.server_fd_ == -1 || con.inherited_)
+            continue;
+        listen_fds_.share(con.server_fd_, con.server_name_, con.port_);
+        con.inherited_ = true;
+    }
+}
+
+/**
+ * @brief makes the worker leave its event loop after the current round, its clients are dropped.
+ * Called from the thread of the first worker once that one stopped, the process exits after it
+ */
+void Server::stop()
+{
+    stopping_ = true;
+    uint64_t one = 1;
+    if (wake_fd_ != -1 && write(wake_fd_, &one, sizeof(one)) == -1)
+        std::cerr << "waking worker " << worker_id_ << " to stop failed\n";
+}
 // private functions
 
 /**
  * @brief makes the server socket and sets it up to the given port,
- * It also makes the server fd non blocking
+ * It also makes the server fd non blocking.
+ * With multiple workers every worker binds its own socket with SO_REUSEPORT
+ * and the kernel spreads the new connections over them,
+ * the reuseport listen parameter sets it with a single worker too
  * 
- * @param server_name the name of the server
- * @param port on what port the server socket will listen
- * @param server_fd variable that will hold the file descriptor of the server
+ * @param config the server block, its server_fd_ will hold the file descriptor of the server
  * @return 0 when done,
  * @return -1 on error,
  * @return -2 on critical error
  */
-int Server::createServerSocket(std::string& server_name, uint16_t port, int& server_fd)
+int Server::createServerSocket(configInfo& config)
 {
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (config.port_ == 0)
+        return createUnixSocket(config);
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    config.server_fd_ = server_fd;
     if (server_fd == -1)
         return 1;
     int opt = 1;
     setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
-    sockaddr_in server_addr = setServerAddr(server_name, port);
-    int nr = bindServerSocket(server_addr, server_fd);
+    if (reuse_port_ || config.config_->getReusePort())
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt));
+    sockaddr_in server_addr = setServerAddr(config.server_name_, config.port_);
+    int nr = bindServerSocket(reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr), server_fd);
+    if (nr != 0)
+        return nr;
+    setListenOptions(config);
+    nr = listenServer(server_fd, config.config_->getListenBacklog());
+    if (nr != 0)
+        return nr;
+    setNonBlocking(server_fd);
+    return 0;
+}
+
+/**
+ * @brief creates the listening unix domain socket of a server block and sets its permissions.
+ * A socket file left behind by a server that is gone is replaced, one that still accepts is not.
+ * The socket is shared through the listen fds, so the other workers listen on it too
+ * instead of binding the path again
+ * 
+ * @param config the server block with a unix socket path
+ * @return 0 when done,
+ * @return 1 if the socket could not be created,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::createUnixSocket(configInfo& config)
+{
+    const std::string& path = config.config_->getListenUnix();
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    config.server_fd_ = server_fd;
+    if (server_fd == -1)
+        return 1;
+    sockaddr_un server_addr{};
+    server_addr.sun_family = AF_UNIX;
+    path.copy(server_addr.sun_path, sizeof(server_addr.sun_path) - 1);
+    if (isStaleUnixSocket(server_addr))
+        unlink(server_addr.sun_path);
+    int nr = bindServerSocket(reinterpret_cast<sockaddr*>(&server_addr), sizeof(server_addr), server_fd);
     if (nr != 0)
         return nr;
-    nr = listenServer(server_fd);
+    if (chmod(server_addr.sun_path, config.config_->getListenUnixMode()) < 0)
+        std::cerr << "setting the permissions of " << path << " failed\n";
+    nr = listenServer(server_fd, config.config_->getListenBacklog());
     if (nr != 0)
         return nr;
     setNonBlocking(server_fd);
+    listen_fds_.share(server_fd, config.server_name_, config.port_);
+    config.inherited_ = true;
     return 0;
 }
 
+/**
+ * @brief checks if a unix socket file is left over, a connect to it is refused when nobody listens
+ * 
+ * @param server_addr the address of the unix socket
+ * @return true if the file is a socket nobody listens on
+ */
+bool Server::isStaleUnixSocket(const sockaddr_un& server_addr)
+{
+    struct stat st;
+    if (lstat(server_addr.sun_path, &st) != 0 || !S_ISSOCK(st.st_mode))
+        return false;
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe == -1)
+        return false;
+    bool stale = connect(probe, reinterpret_cast<const sockaddr*>(&server_addr), sizeof(server_addr)) < 0 && errno == ECONNREFUSED;
+    close(probe);
+    return stale;
+}
+
+/**
+ * @brief sets the listen parameters that can also change on a socket that already listens.
+ * With deferred the kernel holds a new client back until its first bytes arrive,
+ * at most for the client header timeout, so accepting it never gives a empty read.
+ * A failing option is logged, the socket works without it. Unix sockets have no TCP options
+ * 
+ * @param config the server block with the listening socket
+ */
+void Server::setListenOptions(configInfo& config)
+{
+    if (config.port_ == 0)
+        return;
+    int defer = config.config_->getDeferredAccept() ? static_cast<int>(config.config_->getClientHeaderTimeout()) : 0;
+    if (setsockopt(config.server_fd_, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer, sizeof(defer)) < 0)
+        std::cerr << "setting TCP_DEFER_ACCEPT on port " << config.port_ << " failed\n";
+    int fastopen = static_cast<int>(config.config_->getFastOpen());
+    if (fastopen > 0 && setsockopt(config.server_fd_, IPPROTO_TCP, TCP_FASTOPEN, &fastopen, sizeof(fastopen)) < 0)
+        std::cerr << "setting TCP_FASTOPEN on port " << config.port_ << " failed\n";
+}
+
 /**
  * @brief sets the server address information for the server.
  * 
@@ -158,14 +351,16 @@ sockaddr_in Server::setServerAddr(std::string& server_name, uint16_t port)
 /**
  * @brief binds the server socket and the server address info together
  * 
- * @param server_addr the server address information
+ * @param server_addr the server address information, a sockaddr_in or a sockaddr_un
+ * @param len the size of the address
+ * @param server_fd the server socket
  * @return 0 when done,
  * @return -1 on error,
  * @return -2 on critical error
  */
-int Server::bindServerSocket(sockaddr_in& server_addr, int server_fd)
+int Server::bindServerSocket(const sockaddr* server_addr, socklen_t len, int server_fd)
 {
-    if (bind(server_fd, (sockaddr*)&server_addr, sizeof(server_addr)) < 0)
+    if (bind(server_fd, server_addr, len) < 0)
     {
         std::cerr << "bind error\n";
         int nr = validator_.checkErrno(errno);
@@ -178,13 +373,15 @@ int Server::bindServerSocket(sockaddr_in& server_addr, int server_fd)
 /**
  * @brief makes it so the server listen to inkoming requests
  * 
+ * @param server_fd the server socket
+ * @param backlog the length of the accept queue, 0 for SOMAXCONN
  * @return 0 when done,
  * @return -1 on error,
  * @return -2 on critical error
  */
-int Server::listenServer(int server_fd)
+int Server::listenServer(int server_fd, uint64_t backlog)
 {
-    if (listen(server_fd, SOMAXCONN) < 0)
+    if (listen(server_fd, backlog == 0 ? SOMAXCONN : static_cast<int>(backlog)) < 0)
     {
         std::cerr << "listen errro\n";
         int nr = validator_.checkErrno(errno);
@@ -220,6 +417,15 @@ void Server::setNonBlocking(int fd)
  */
 int Server::doEpollCtl(int mode, int fd, epoll_event* event)
 {
+    if (uring_.active())
+    {
+        if (uring_.control(mode, fd, event) != 0)
+        {
+            std::cerr << "io_uring poll update failed\n";
+            return -1;
+        }
+        return 0;
+    }
     if (epoll_ctl(epoll_fd_, mode, fd, event) == -1)
     {
         std::cerr << "first round epoll_ctl error\n";
@@ -290,362 +496,1526 @@ int Server::putCoutCerrInEpoll()
     int nr = doEpollCtl(EPOLL_CTL_ADD, stdout_pipe_[0], &std_event);
     if (nr < 0)
         return nr;
+    connections_.add(stdout_pipe_[0], FD_PIPE, nullptr);
     
     std_event.data.fd = stderr_pipe_[0];
     nr = doEpollCtl(EPOLL_CTL_ADD, stderr_pipe_[0], &std_event);
     if (nr < 0)
         return nr;
+    connections_.add(stderr_pipe_[0], FD_PIPE, nullptr);
     return 0;
 }
 
 /**
- * @brief the main loop that listens to the events that need to be handled
+ * @brief makes the eventfd the worker is woken up on when a new config generation is loaded.
+ * The first worker also gets SIGHUP, SIGUSR2 and SIGQUIT as a signalfd, they are blocked in every thread
  * 
  * @return 0 when done,
  * @return -1 on error,
  * @return -2 on critical error
  */
-int Server::listenLoop()
+int Server::setupReload()
 {
-    epoll_event events[MAX_EVENTS];
-    while (true)
-    {
-        int event_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
-        for (int i = 0; i < event_count; ++i)
-        {
-            int nr = checkEvents(events[i]);
-            if (nr == -2)
-                return nr;
-        }
-    }
-    close(epoll_fd_);
-    for(configInfo& con : config_info_)
-        close(con.server_fd_);
+    wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd_ == -1)
+        return validator_.checkErrno(errno);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = wake_fd_;
+    int nr = doEpollCtl(EPOLL_CTL_ADD, wake_fd_, &event);
+    if (nr != 0)
+        return nr;
+    connections_.add(wake_fd_, FD_WAKE, nullptr);
+    reload_.addWorker(wake_fd_);
+    if (worker_id_ != 0)
+        return 0;
+
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGQUIT);
+    signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd_ == -1)
+        return validator_.checkErrno(errno);
+    event.data.fd = signal_fd_;
+    nr = doEpollCtl(EPOLL_CTL_ADD, signal_fd_, &event);
+    if (nr != 0)
+        return nr;
+    connections_.add(signal_fd_, FD_SIGNAL, nullptr);
     return 0;
 }
 
 /**
- * @brief checks what action to take on the based on the fd of the event.
- * If it's  a new fd then a new connection is being made.
- * If the events hold the status of EPOLLIN than first it will check if the fd is a timeout fd
- * if it isn't than a read event needs to be handeled.
- * If the events hold the status of EPOLLOUT than first it will check if the fd is a timeout fd 
- * if it isn't than a write events needs to be handeled.
+ * @brief makes the eventfd the aio threads report finished jobs of this worker on, when there are aio threads
  * 
- * @param event the event with the fd and the events needed for handeling
  * @return 0 when done,
  * @return -1 on error,
  * @return -2 on critical error
  */
-int Server::checkEvents(epoll_event event)
+int Server::setupAio()
 {
+    if (!aio_.active())
+        return 0;
+    if (aio_done_.setup() != 0)
+        return validator_.checkErrno(errno);
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = aio_done_.fd();
+    int nr = doEpollCtl(EPOLL_CTL_ADD, aio_done_.fd(), &event);
+    if (nr != 0)
+        return nr;
+    connections_.add(aio_done_.fd(), FD_AIO, nullptr);
+    return 0;
+}
 
-    int fd = event.data.fd;
-    for (configInfo& con : config_info_)
-    {
-        if (fd == con.server_fd_) // new conection
-        {
-            if (setupConnection(con.server_fd_, con) == -2)
-            {
-                close(epoll_fd_);
-                for (configInfo& con : config_info_)
-                    close(con.server_fd_);
-                return -2;
-            }
-            return 0;
-        }
-    }
-    if (event.events & EPOLLIN || event.events & EPOLLOUT) // timeout
+/**
+ * @brief makes the content cache of this worker when content_cache is set,
+ * its inotify fd reports changes of the cached files to the event loop.
+ * Without inotify the files are read from disk for every response
+ * 
+ * @return 0 when done,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::setupContentCache()
+{
+    const Config& config = *generation_->servers_[0].config_;
+    if (config.getContentCacheSize() == 0)
+        return 0;
+    content_cache_ = std::make_unique<ServerContentCache>(config.getContentCacheSize(), config.getContentCacheMaxFile());
+    if (content_cache_->setup() != 0)
     {
-        int nr = checkForTimeout(fd, event);
-        if (nr != 1)
-            return nr;
+        std::cerr << "inotify not available, serving without the content cache\n";
+        content_cache_.reset();
+        return 0;
     }
-    if (event.events & EPOLLIN) // read event
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = content_cache_->fd();
+    int nr = doEpollCtl(EPOLL_CTL_ADD, content_cache_->fd(), &event);
+    if (nr != 0)
+        return nr;
+    connections_.add(content_cache_->fd(), FD_CONTENT_CACHE, nullptr);
+    return 0;
+}
+
+/**
+ * @brief builds the server blocks of a config generation.
+ * Server blocks on the same port share one listening socket, owned by the default server of the port,
+ * the Host header of a request picks the server block that answers it.
+ * A listener on the same address and port as one of the running generation
+ * takes over its listening socket, so no client waiting in the backlog is lost.
+ * The other listeners take a socket inherited with socket activation or bind a new socket
+ * 
+ * @param config the config generation
+ * @return the server blocks,
+ * @return nullptr if a socket could not be made, the sockets made so far are closed again
+ */
+std::shared_ptr<serverGeneration> Server::makeGeneration(const std::shared_ptr<const s_config_generation>& config)
+{
+    std::shared_ptr<serverGeneration> generation = std::make_shared<serverGeneration>();
+    generation->config_ = config;
+    std::vector<configInfo>& servers = generation->servers_;
+    servers.reserve(config->configs.size());
+    for (size_t i = 0; i < config->configs.size(); ++i)
     {
-        return handleReadEvents(fd, event);
+        std::shared_ptr<Config> conf = config->configs[i];
+        configInfo con_info(conf);
+        con_info.index_ = i;
+        servers.push_back({con_info});
     }
-    else if (event.events & EPOLLOUT) // write 
+    std::vector<int> created;
+    for (size_t i = 0; i < servers.size(); ++i)
     {
-        std::vector<configInfo>::iterator it = config_info_.begin();
-        std::vector<configInfo>::iterator ite = config_info_.end();
-        while (it != ite)
+        configInfo& con_info = servers[i];
+        if (findListener(servers, con_info) != i)
+            continue;
+        setupVirtualHosts(servers, con_info);
+        for (size_t j = 0; generation_ != nullptr && j < generation_->servers_.size(); ++j)
         {
-            if (it->requestHandler_.getRequest(fd) != nullptr)
-                break;
-            ++it;
+            configInfo& running = generation_->servers_[j];
+            if (running.server_fd_ == -1 || running.server_name_ != con_info.server_name_ || running.port_ != con_info.port_)
+                continue;
+            con_info.server_fd_ = running.server_fd_;
+            con_info.inherited_ = running.inherited_;
+            con_info.paused_ = running.paused_;
+            adoptListener(con_info);
         }
-        if (it == ite)
-            return -2;
-        e_server_request_return nr = it->responseHandler_.handleResponse(fd, *(it->requestHandler_.getRequest(fd)), it->config_->getLocations());
-        // TODO remove if statement for eval
-        if (nr != SRH_DO_TIMEOUT && nr != SRH_OK)
+        if (con_info.server_fd_ == -1)
         {
-            if (nr == SRH_INCORRECT_HTTP_VERSION)
+            con_info.server_fd_ = listen_fds_.take(con_info.server_name_, con_info.port_);
+            con_info.inherited_ = con_info.server_fd_ != -1;
+            if (con_info.inherited_)
             {
-                e_server_request_return srhr = it->responseHandler_.setupResponse(fd, 505, *(it->requestHandler_.getRequest(fd)));
-                doEpollCtl(EPOLL_CTL_DEL, fd, &event);
-                doEpollCtl(EPOLL_CTL_DEL, client_timers_[fd], nullptr);
-                close(fd);
-                close(client_timers_[fd]);
-                it->requestHandler_.removeNodeFromRequest(fd);
-                client_timers_.erase(fd);
-                if (srhr != SRH_OK)
-                    return -2;
-                return 0;
+                setNonBlocking(con_info.server_fd_);
+                adoptListener(con_info);
             }
-            else
-                it->responseHandler_.setupResponse(fd, 500, *(it->requestHandler_.getRequest(fd)));
         }
-        doEpollCtl(EPOLL_CTL_DEL, fd, &event);
-        doEpollCtl(EPOLL_CTL_DEL, client_timers_[fd], nullptr);
-        close(fd);
-        close(client_timers_[fd]);
-        it->requestHandler_.removeNodeFromRequest(fd);
-        client_timers_.erase(fd);
-        if (nr != SRH_OK)
-            return -2;
-        return 0;
-    }
-    else
-    {
-        std::vector<configInfo>::iterator it = config_info_.begin();
-        std::vector<configInfo>::iterator ite = config_info_.end();
-        while (it != ite)
+        if (con_info.server_fd_ == -1)
         {
-            if (it->requestHandler_.getRequest(fd) != nullptr)
-                break;
-            ++it;
+            if (createServerSocket(con_info))
+            {
+                std::cerr << "create server socket error\n";
+                for (int fd : created)
+                    close(fd);
+                return nullptr;
+            }
+            created.push_back(con_info.server_fd_);
         }
-        if (it == ite)
-            return -2;
-        std::cerr << "epoll_event is [" << epollEventToString(event.events) << "] fd type is [" << getFdType(fd) << "\n";
-        int nr = doEpollCtl(EPOLL_CTL_DEL, fd, &event);
-        doEpollCtl(EPOLL_CTL_DEL, client_timers_[fd], nullptr);
-        close(fd);
-        close(client_timers_[fd]);
-        it->requestHandler_.removeNodeFromRequest(fd);
-        client_timers_.erase(fd);
-        if (nr != SRH_OK)
-            return -2;
-        return 0;
-
     }
-    return -2;
+    return generation;
 }
 
 /**
- * @brief when a new client connecting we set the socket and the event represending the client up
+ * @brief sets the listen parameters of the config on a socket that already listens,
+ * a socket taken over from the last generation or inherited from the supervisor.
+ * reuseport only changes with a new socket
  * 
- * @param server_fd the file descripter where the request came from, aka the server
- * @return 0 when dome,
- * @return -1 on error,
- * @return -2 on critical error
+ * @param config the server block that takes the socket
  */
-int Server::setupConnection(int server_fd, configInfo& config)
+void Server::adoptListener(configInfo& config)
 {
-    sockaddr_in clientAddr{};
-    socklen_t clientLen = sizeof(clientAddr);
-    int client_fd = accept(server_fd, (sockaddr*)&clientAddr, &clientLen);
-    if (client_fd != -1)
-    {
-        config.requestHandler_.setConfigForClient(config.config_, client_fd);
-        setNonBlocking(client_fd);
-        epoll_event client_event{};
-        client_event.events = EPOLLIN;
-        client_event.data.fd = client_fd;
-        int nr = doEpollCtl(EPOLL_CTL_ADD, client_fd, &client_event);
-        if (nr != 0)
-        {
-            std::cerr << "setup connecton new client to epoll failed\n";
-            return nr;
-        }
-        nr = setTimer(client_fd);
-        if (nr != 0)
-            return nr;
-        return 0;
-    }
-    else
+    setListenOptions(config);
+    uint64_t backlog = config.config_->getListenBacklog();
+    if (listen(config.server_fd_, backlog == 0 ? SOMAXCONN : static_cast<int>(backlog)) < 0)
+        std::cerr << "changing the backlog of port " << config.port_ << " failed\n";
+}
+
+/**
+ * @brief closes the listening sockets of the current generation,
+ * inherited sockets belong to the supervisor and stay open
+ */
+void Server::closeListeners()
+{
+    for (configInfo& con : generation_->servers_)
     {
-        std::cerr << "accept error\n";
-        return validator_.checkErrno(errno);
+        if (con.server_fd_ != -1 && !con.inherited_)
+            close(con.server_fd_);
     }
 }
 
 /**
- * @brief sets a timeout timer for the client so we dont have hanging connections
+ * @brief finds the server block that owns the listener of a port,
+ * the one with default_server or else the first server block on the port
  * 
- * @param client_fd the client fd the timer is for
- * @return 0 when done,
- * @return -1 on error,
- * @return -2 on critical error
+ * @param servers the server blocks of a generation
+ * @param config a server block on the port
+ * @return the index of the server block
  */
-int Server::setTimer(int client_fd)
+size_t Server::findListener(const std::vector<configInfo>& servers, const configInfo& config)
 {
-    int timer_fd = timerfd_create(CLOCK_MONOTONIC, 0);
-    if (timer_fd == -1)
+    size_t first = servers.size();
+    for (size_t i = 0; i < servers.size(); ++i)
     {
-        std::cerr << "failed to create timerfd\n";
-        return -1;
+        if (!sameListen(servers[i], config))
+            continue;
+        if (servers[i].config_->getDefaultServer())
+            return i;
+        if (first == servers.size())
+            first = i;
     }
+    return first;
+}
 
-    itimerspec timeout{};
-    timeout.it_value.tv_sec = TIMEOUT_MS / 1000; // timeout in seconds
-    timeout.it_value.tv_nsec = (TIMEOUT_MS % 1000) * 1000000; // timeout in nanoseconds
-    timeout.it_interval.tv_sec = 0; //timer needs to go once, no periodic triggering
-    timeout.it_interval.tv_nsec = 0;
-
-    timerfd_settime(timer_fd, 0, &timeout, nullptr);
+/**
+ * @brief server blocks share a listener when they have the same port,
+ * server blocks on unix sockets when they have the same path
+ * 
+ * @return true if both server blocks are served by the same listener
+ */
+bool Server::sameListen(const configInfo& first, const configInfo& second)
+{
+    return first.port_ == second.port_ && (first.port_ != 0 || first.server_name_ == second.server_name_);
+}
 
-    epoll_event timer_event{};
-    timer_event.data.fd = timer_fd;
-    timer_event.events = EPOLLIN;
-    int nr = doEpollCtl(EPOLL_CTL_ADD, timer_fd, &timer_event);
-    if (nr != 0)
+/**
+ * @brief fills the server name table of a listener with the names of every server block on its port.
+ * The listener binds to localhost only when all of those server blocks are localhost,
+ * otherwise to every address
+ * 
+ * @param servers the server blocks of a generation
+ * @param listener the server block that owns the listener of the port
+ */
+void Server::setupVirtualHosts(std::vector<configInfo>& servers, configInfo& listener)
+{
+    listener.hosts_ = std::make_shared<ServerVirtualHosts>(listener.index_, listener.config_);
+    for (configInfo& con : servers)
     {
-        std::cerr << "add timer fd to epoll failed\n";
-        return nr;
+        if (!sameListen(con, listener))
+            continue;
+        for (const std::string& name : con.config_->getServerNames())
+            listener.hosts_->add(name, con.index_, con.config_);
+        if (con.server_name_ != listener.server_name_)
+            listener.server_name_ = "0.0.0.0";
     }
-    client_timers_[client_fd] = timer_fd;
-    return 0;
+    listener.requestHandler_.setVirtualHosts(listener.hosts_.get());
 }
 
 /**
- * @brief checks if the fd is a timer fd, if it is that means a timeout has happend
+ * @brief starts accepting clients on the listening socket of a server block
  * 
- * @param fd the file descriptor of the timer
- * @param event the epoll event from the fd
- * @return 1 when the fd is not a timer fd,
- * @return 0 when timeout response is send,
+ * @param config the server block
+ * @return 0 when done,
  * @return -1 on error,
  * @return -2 on critical error
  */
-int Server::checkForTimeout(int fd, epoll_event& event)
+int Server::watchListener(configInfo& config)
 {
-    for (const std::pair<int, int> timer : client_timers_)
-    {
-        if (timer.second == fd)
-        {
-            int client_fd = timer.first;
+    if (uring_.active())
+        return uring_.addListener(config.server_fd_);
+    epoll_event event{};
+    event.events = EPOLLIN | trigger_mode_;
+    event.data.fd = config.server_fd_;
+    return doEpollCtl(EPOLL_CTL_ADD, config.server_fd_, &event);
+}
 
-            uint64_t expirations;
-            ssize_t bytes_read = read(fd, &expirations, sizeof(expirations));
-            if (bytes_read < 0)
-            {
-                std::cerr << "Timeout read failed\n";
-                return -2;
-            }
-            std::vector<configInfo>::iterator it = config_info_.begin();
-            std::vector<configInfo>::iterator ite = config_info_.end();
-            while (it != ite)
-            {
-                if (it->requestHandler_.getRequest(fd) != nullptr)
-                    break;
-                ++it;
-            }
-            if (it == ite)
-                return -1;
-            int nr = it->responseHandler_.setupResponse(client_fd, 408, *(it->requestHandler_.getRequest(fd)));
-            std::cout << "client timeout for " << client_fd << " reached\n";
-            doEpollCtl(EPOLL_CTL_DEL, client_fd, &event);
-            doEpollCtl(EPOLL_CTL_DEL, fd, nullptr);
-            close(client_fd);
-            close(fd);
-            client_timers_.erase(client_fd);
-            it->requestHandler_.removeNodeFromRequest(client_fd);
-            if (nr == SRH_OK)
-                return 0;
-            return nr;
-        }
-    }
-    return 1;
+/**
+ * @brief gives the handlers of a server block the pipes of the standard output and standard error,
+ * and the worker the coroutines of its responses wait in
+ * 
+ * @param config the server block
+ */
+void Server::setPipes(configInfo& config)
+{
+    config.responseHandler_.setScheduler(this);
+    config.responseHandler_.setStdoutPipe(stdout_pipe_);
+    config.requestHandler_.setStdoutPipe(stdout_pipe_);
+    config.requestHandler_.setStderrPipe(stderr_pipe_);
 }
 
 /**
- * @brief reads into the request from the client and stores it for later handling
+ * @brief reads the pending signals, a SIGHUP loads the config file again,
+ * a SIGUSR2 starts the binary again with the listening sockets,
+ * a SIGQUIT stops accepting and exits once the open connections are finished
  * 
- * @param fd the client file descriptor
- * @param event the epoll event from the client
- * @return 0 when request is stored,
- * @return -1 on eror,
- * @return -2 on critical error
+ * @return 0 when done
  */
-int Server::handleReadEvents(int fd, epoll_event& event)
+int Server::handleSignal()
 {
-    std::string request_buffer;
-    int timer_fd = -1;
-    std::vector<configInfo>::iterator it = config_info_.begin();
-    std::vector<configInfo>::iterator ite = config_info_.end();
-    if (fd != stdout_pipe_[0] && fd != stderr_pipe_[0])
+    signalfd_siginfo info;
+    while (read(signal_fd_, &info, sizeof(info)) == sizeof(info))
     {
-        while (it != ite)
+        if (info.ssi_signo == SIGHUP)
         {
-            if (it->requestHandler_.getRequest(fd) != nullptr)
-                break;
-            ++it;
+            std::cerr << "SIGHUP received, reloading the config\n";
+            reload_.reload();
         }
-        if (it == ite)
-            return -1;
-    }
-    e_reponses function_response = it->requestHandler_.readRequest(fd, request_buffer);
-    if (function_response != E_ROK)
-    {
-        request_buffer.clear();
-        if (function_response == READ_HEADER_BODY_TOO_LARGE)
+        else if (info.ssi_signo == SIGUSR2)
         {
-            timer_fd = client_timers_.at(fd);
-            int return_value = it->responseHandler_.setupResponse(fd, 413, *(it->requestHandler_.getRequest(fd)));
-            doEpollCtl(EPOLL_CTL_DEL, timer_fd, nullptr);
-            doEpollCtl(EPOLL_CTL_DEL, fd, &event);
-            it->requestHandler_.removeNodeFromRequest(fd);
-            client_timers_.erase(fd);
-            close(fd);
-            close(timer_fd);
-            return return_value;
+            std::cerr << "SIGUSR2 received, upgrading the binary\n";
+            startUpgrade();
         }
-        else if (function_response == HANDLE_COUT_CERR_OUTPUT)
+        else if (info.ssi_signo == SIGQUIT)
         {
-            it->responseHandler_.handleCoutErrOutput(fd);
-            return 0;
+            std::cerr << "SIGQUIT received, finishing the open connections\n";
+            upgrade_.stop();
+            reload_.wakeWorkers();
         }
-        std::cerr << "function_response is [" << function_response << "]\n";
-        timer_fd = client_timers_.at(fd);
-        it->responseHandler_.setupResponse(fd, 400, *(it->requestHandler_.getRequest(fd)));
-        doEpollCtl(EPOLL_CTL_DEL, fd, &event);
-        doEpollCtl(EPOLL_CTL_DEL, timer_fd, nullptr);
-        it->requestHandler_.removeNodeFromRequest(fd);
-        client_timers_.erase(timer_fd);
-        close(fd);
-        close(timer_fd);
-        return -1;
     }
-    function_response = it->requestHandler_.handleClient(request_buffer, event);
-    if (function_response == MODIFY_CLIENT_WRITE)
-    {
-        if (doEpollCtl(EPOLL_CTL_MOD, fd, &event) != 0)
-        {
+    return 0;
+}
+
+/**
+ * @brief hands the listening sockets of this worker to a new process of the binary
+ * and watches the pipe it reports its startup on
+ * 
+ * @return 0 when the new process is started,
+ * @return -1 if it could not be started, the process keeps serving
+ */
+int Server::startUpgrade()
+{
+    std::vector<int> listeners;
+    for (configInfo& con : generation_->servers_)
+    {
+        if (con.server_fd_ != -1)
+            listeners.push_back(con.server_fd_);
+    }
+    int status_fd = upgrade_.start(listeners);
+    if (status_fd == -1)
+    {
+        std::cerr << "upgrade not started, keeping the running process\n";
+        return -1;
+    }
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.fd = status_fd;
+    if (doEpollCtl(EPOLL_CTL_ADD, status_fd, &event) != 0)
+    {
+        close(status_fd);
+        return -1;
+    }
+    connections_.add(status_fd, FD_UPGRADE, nullptr);
+    return 0;
+}
+
+/**
+ * @brief reads the startup report of the new process,
+ * once it is ready every worker is woken up to start draining
+ * 
+ * @param status_fd the pipe the new process reports on
+ * @return 0 when done
+ */
+int Server::handleUpgrade(int status_fd)
+{
+    e_upgrade_status status = upgrade_.readStatus(status_fd);
+    if (status == UPGRADE_PENDING)
+        return 0;
+    doEpollCtl(EPOLL_CTL_DEL, status_fd, nullptr);
+    connections_.remove(status_fd);
+    close(status_fd);
+    if (status == UPGRADE_READY)
+        reload_.wakeWorkers();
+    return 0;
+}
+
+/**
+ * @brief handles a wake up from another worker,
+ * it is either a new config generation or a upgrade that took over
+ * 
+ * @return 0 when done,
+ * @return -1 if the new generation could not be set up
+ */
+int Server::handleWake()
+{
+    uint64_t count;
+    if (read(wake_fd_, &count, sizeof(count)) != sizeof(count))
+        return 0;
+    if (stopping_)
+        return 0;
+    logSpinCounters();
+    if (upgrade_.draining())
+    {
+        draining_ = true;
+        return 0;
+    }
+    return switchGeneration();
+}
+
+/**
+ * @brief switches the worker to the newest config generation.
+ * New clients are accepted in the new server blocks, the clients of the old generation
+ * finish their request with the old config and are closed after it.
+ * Listeners that are not in the new config are closed
+ * 
+ * @return 0 when done,
+ * @return -1 if the new generation could not be set up, the worker keeps the running one
+ */
+int Server::switchGeneration()
+{
+    std::shared_ptr<const s_config_generation> config = reload_.current();
+    if (config->number == generation_->config_->number)
+        return 0;
+    std::shared_ptr<serverGeneration> next = makeGeneration(config);
+    if (next == nullptr)
+    {
+        std::cerr << "worker " << worker_id_ << " keeps config generation " << generation_->config_->number << "\n";
+        return -1;
+    }
+    for (configInfo& running : generation_->servers_)
+    {
+        if (running.server_fd_ == -1)
+            continue;
+        bool kept = false;
+        for (configInfo& con : next->servers_)
+            kept = kept || con.server_fd_ == running.server_fd_;
+        if (kept)
+            continue;
+        if (running.paused_)
+            --paused_listeners_;
+        if (uring_.active())
+            uring_.removeListener(running.server_fd_);
+        else
+            doEpollCtl(EPOLL_CTL_DEL, running.server_fd_, nullptr);
+        connections_.remove(running.server_fd_);
+        if (!running.inherited_)
+            close(running.server_fd_);
+    }
+    for (configInfo& con : next->servers_)
+    {
+        setPipes(con);
+        if (con.server_fd_ == -1)
+            continue;
+        if (connections_.get(con.server_fd_) == nullptr && watchListener(con) != 0)
+            std::cerr << "listening on port " << con.port_ << " failed\n";
+        connections_.add(con.server_fd_, FD_LISTENER, &con);
+    }
+    generation_ = next;
+    closeIdleClients();
+    std::cerr << "worker " << worker_id_ << " switched to config generation " << config->number << "\n";
+    return 0;
+}
+
+/**
+ * @brief closes the keep-alive clients of old config generations that wait for a next request,
+ * so the old generations do not stay alive for as long as the clients stay connected.
+ * While draining every idle client is closed
+ */
+void Server::closeIdleClients()
+{
+    for (int fd = 0; fd < connections_.end(); ++fd)
+    {
+        s_connection* conn = connections_.get(fd);
+        if (conn == nullptr || conn->type != FD_CLIENT || (conn->generation == generation_ && !draining_))
+            continue;
+        if (timers_.getPhase(fd) == TIMER_KEEPALIVE && conn->data->in_buffer.empty())
+            closeClient(fd);
+    }
+}
+
+/**
+ * @brief the main loop that listens to the events that need to be handled
+ * 
+ * @return 0 when done,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::listenLoop()
+{
+    epoll_event events[MAX_EVENTS];
+    std::vector<int> expired;
+    while (true)
+    {
+        int timeout = timers_.nextTimeout();
+        if ((paused_listeners_ > 0 || draining_) && (timeout < 0 || timeout > ADMISSION_RETRY_MS))
+            timeout = ADMISSION_RETRY_MS;
+        run_turn_.swap(run_queue_); // clients that yield from here on wait for the next round
+        ++run_round_;
+        if (!run_turn_.empty())
+            timeout = 0;
+        int event_count = waitEvents(events, timeout);
+        for (int i = 0; i < event_count; ++i)
+        {
+            int nr = checkEvents(events[i]);
+            if (nr == -2)
+                return nr;
+        }
+        if (runYielded() == -2)
+            return -2;
+        if (acceptClients() == -2)
+            return -2;
+        timers_.expire(expired);
+        for (int fd : expired)
+        {
+            if (handleTimeout(fd) == -2)
+                return -2;
+        }
+        expired.clear();
+        if (paused_listeners_ > 0)
+            resumeListeners();
+        if (stopping_)
+            break;
+        if (draining_ && drainWorker())
+            break;
+    }
+    close(epoll_fd_);
+    closeListeners();
+    return 0;
+}
+
+/**
+ * @brief stops accepting once a upgrade took over or on SIGQUIT, and finishes the worker when its last client is gone.
+ * The first worker returns last, the process exits with it
+ * 
+ * @return true when the worker can stop
+ */
+bool Server::drainWorker()
+{
+    if (accepting_)
+    {
+        stopListening();
+        closeIdleClients();
+        accepting_ = false;
+        std::cerr << "worker " << worker_id_ << " stopped accepting, " << clients_ << " clients left\n";
+        return false; // one more wait submits the io_uring accept cancels and takes their last clients
+    }
+    if (clients_ > 0)
+        return false;
+    if (!drained_)
+    {
+        drained_ = true;
+        upgrade_.finishWorker();
+        std::cerr << "worker " << worker_id_ << " drained\n";
+    }
+    return worker_id_ != 0 || upgrade_.finished();
+}
+
+/**
+ * @brief takes the listeners out of the worker and closes them.
+ * The clients already waiting in their backlog are accepted first, the new process
+ * does not get the SO_REUSEPORT sockets of the other workers and the kernel would reset them.
+ * A multishot accept of the io_uring can still complete before its cancel,
+ * so the server of a stopped listener is remembered for those clients
+ */
+void Server::stopListening()
+{
+    for (configInfo& con : generation_->servers_)
+    {
+        if (con.server_fd_ == -1)
+            continue;
+        if (uring_.active())
+        {
+            uring_.removeListener(con.server_fd_);
+            stopped_listeners_.push_back(std::make_pair(con.server_fd_, &con));
+        }
+        else
+            doEpollCtl(EPOLL_CTL_DEL, con.server_fd_, nullptr);
+        connections_.remove(con.server_fd_);
+        if (con.paused_)
+            --paused_listeners_;
+        con.paused_ = false;
+        acceptBacklog(con);
+    }
+    closeListeners();
+    for (configInfo& con : generation_->servers_)
+        con.server_fd_ = -1;
+}
+
+/**
+ * @brief accepts every client waiting on a listener that is closed next, clients over max_connections get a 503
+ * 
+ * @param config the server the listener belongs to
+ */
+void Server::acceptBacklog(configInfo& config)
+{
+    while (true)
+    {
+        int client_fd = accept4(config.server_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd == -1)
+            return;
+        if (!generation_->config_->admission->admit(config.index_))
+            rejectClient(client_fd);
+        else if (addClient(client_fd, config) != 0)
+            return;
+    }
+}
+
+/**
+ * @brief waits for the next events. With busy_poll_spin the loop first polls without sleeping
+ * for up to the spin budget, a event found while spinning is a hit and skips the wake up from sleep,
+ * a spin that finds nothing is a miss and the loop sleeps for the rest of the timeout
+ * 
+ * @param events the array the events are written to
+ * @param timeout milliseconds to wait at most, -1 to wait until there is a event
+ * @return the number of events,
+ * @return -1 on error
+ */
+int Server::waitEvents(epoll_event events[], int timeout)
+{
+    if (spin_budget_us_ == 0 || timeout == 0)
+        return pollEvents(events, timeout);
+    uint64_t budget = spin_budget_us_;
+    if (timeout > 0 && budget > static_cast<uint64_t>(timeout) * 1000)
+        budget = static_cast<uint64_t>(timeout) * 1000;
+    uint64_t start = ServerTimerWheel::nowUs();
+    do
+    {
+        int event_count = pollEvents(events, 0);
+        if (event_count != 0)
+        {
+            ++spin_hits_;
+            return event_count;
+        }
+    } while (ServerTimerWheel::nowUs() - start < budget);
+    ++spin_misses_;
+    if (timeout > 0)
+        timeout -= static_cast<int>(budget / 1000);
+    return pollEvents(events, timeout);
+}
+
+/**
+ * @brief one wait on the io_uring or the epoll
+ * 
+ * @param events the array the events are written to
+ * @param timeout milliseconds to wait at most, 0 to return right away, -1 to wait until there is a event
+ * @return the number of events,
+ * @return -1 on error
+ */
+int Server::pollEvents(epoll_event events[], int timeout)
+{
+    if (uring_.active())
+        return uring_.wait(events, MAX_EVENTS, timeout);
+    return epoll_wait(epoll_fd_, events, MAX_EVENTS, timeout);
+}
+
+/**
+ * @brief lets epoll_wait busy poll the device queues of the clients when busy_poll is set,
+ * EPIOCSPARAMS comes with glibc 2.40 and Linux 6.9, without it only the sockets are set up with setBusyPoll
+ */
+void Server::setupBusyPoll()
+{
+    if (busy_poll_ == 0 || uring_.active())
+        return;
+#ifdef EPIOCSPARAMS
+    epoll_params params{};
+    params.busy_poll_usecs = static_cast<uint32_t>(busy_poll_);
+    params.busy_poll_budget = 8;
+    params.prefer_busy_poll = 1;
+    if (ioctl(epoll_fd_, EPIOCSPARAMS, &params) < 0)
+        std::cerr << "setting busy poll on the epoll failed\n";
+#endif
+}
+
+/**
+ * @brief sets SO_BUSY_POLL and SO_PREFER_BUSY_POLL on a client socket when busy_poll is set,
+ * a busy poll time above the net.core.busy_read sysctl needs CAP_NET_ADMIN.
+ * A failing option is logged once, the client works without it
+ * 
+ * @param client_fd the file descriptor of the client
+ */
+void Server::setBusyPoll(int client_fd)
+{
+    if (busy_poll_ == 0)
+        return;
+    int usecs = static_cast<int>(busy_poll_);
+    int prefer = 1;
+    if (setsockopt(client_fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) < 0
+        || setsockopt(client_fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) < 0)
+    {
+        std::cerr << "setting busy poll on client " << client_fd << " failed, turning it off\n";
+        busy_poll_ = 0;
+    }
+}
+
+/**
+ * @brief logs how often spinning found events, written every time the worker is woken up for a reload
+ */
+void Server::logSpinCounters()
+{
+    if (spin_budget_us_ == 0)
+        return;
+    std::cerr << "worker " << worker_id_ << " busy poll spin hits " << spin_hits_ << ", misses " << spin_misses_ << "\n";
+}
+
+/**
+ * @brief checks what action to take on the based on the fd of the event.
+ * The fd is looked up in the connection table to see what kind of fd it is.
+ * If it's a server fd then a new connection is being made.
+ * If it's a client fd the read or write event gets handeled.
+ * 
+ * @param event the event with the fd and the events needed for handeling
+ * @return 0 when done,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::checkEvents(epoll_event event)
+{
+    int fd = event.data.fd;
+    s_connection* conn = connections_.get(fd);
+    if (conn == nullptr)
+    {
+        std::cerr << "event for unknown fd " << fd << "\n";
+        doEpollCtl(EPOLL_CTL_DEL, fd, nullptr);
+        return -1;
+    }
+    switch (conn->type)
+    {
+        case FD_LISTENER: // new conection
+            if (setupConnection(fd, *conn->server) == -2)
+            {
+                close(epoll_fd_);
+                closeListeners();
+                return -2;
+            }
+            return 0;
+        case FD_PIPE:
+            generation_->servers_[0].responseHandler_.handleCoutErrOutput(fd);
+            return 0;
+        case FD_SIGNAL:
+            return handleSignal();
+        case FD_WAKE:
+            return handleWake();
+        case FD_UPGRADE:
+            return handleUpgrade(fd);
+        case FD_AWAIT:
+            return resumeAwait(fd, event.events);
+        case FD_AIO:
+            return handleAio();
+        case FD_CONTENT_CACHE:
+            content_cache_->handleEvents();
+            return 0;
+        case FD_CLIENT:
+            conn->data->yielded = 0; // a event of a client in the run queue is its turn
+            if ((event.events & CLIENT_HANGUP) && (conn->data->responding || conn->data->task.active()))
+            {
+                closeClient(fd); // destroys the coroutine of the request, which kills its CGI script
+                return 0;
+            }
+            if ((event.events & EPOLLRDHUP) && (conn->data->responding || conn->data->task.active()))
+            {
+                if (!conn->data->peer_closed)
+                    return halfCloseClient(fd, *conn, event);
+                if (!(event.events & EPOLLOUT))
+                    return 0; // io_uring reports EPOLLRDHUP whether it is asked for or not
+            }
+            if (event.events & EPOLLIN) // read event
+                return handleReadEvents(fd, *conn, event);
+            if (event.events & EPOLLOUT) // write
+                return handleWriteEvents(fd, *conn, event);
+            std::cerr << "epoll_event is [" << epollEventToString(event.events) << "] fd type is [" << getFdType(fd) << "\n";
+            closeClient(fd);
+            return 0;
+        default:
+            return -2;
+    }
+}
+
+/**
+ * @brief removes the client from the epoll, stops its timer and closes it
+ * 
+ * @param fd the file descriptor of the client
+ */
+void Server::closeClient(int fd)
+{
+    s_connection* conn = connections_.get(fd);
+    if (conn == nullptr)
+        return;
+    configInfo* server = conn->server;
+    doEpollCtl(EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    timers_.cancel(fd);
+    server->requestHandler_.removeNodeFromRequest(fd);
+    if (conn->type == FD_CLIENT)
+    {
+        conn->generation->config_->admission->release(server->index_);
+        --clients_;
+        counters_.active.fetch_sub(1, std::memory_order_relaxed);
+    }
+    connections_.remove(fd); // the last client of a old generation releases it
+}
+
+/**
+ * @brief a client that shut down its sending side while its response is built or send still reads it.
+ * The client stops being watched for EPOLLRDHUP, which would be reported on every wait from now on,
+ * and is closed after the response. A client that is really gone shows up when sending fails
+ * 
+ * @param fd the file descriptor of the client
+ * @param conn the connection table entry of the client
+ * @param event the epoll event from the client
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::halfCloseClient(int fd, s_connection& conn, epoll_event& event)
+{
+    s_client_data& data = *conn.data;
+    data.peer_closed = true;
+    data.keep_alive = false;
+    bool sending = data.responding && !data.task.active(); // a coroutine or aio read only waits for a hang up
+    epoll_event modified{};
+    modified.events = (sending ? static_cast<uint32_t>(EPOLLOUT) : 0) | trigger_mode_;
+    modified.data.fd = fd;
+    if (doEpollCtl(EPOLL_CTL_MOD, fd, &modified) != 0)
+    {
+        closeClient(fd);
+        return -1;
+    }
+    if (sending && (event.events & EPOLLOUT))
+        return handleWriteEvents(fd, conn, modified);
+    return 0;
+}
+
+/**
+ * @param data the request data of the client
+ * @return EPOLLRDHUP while the client is watched for shutting down its sending side, 0 after it did
+ */
+uint32_t Server::hangupEvents(const s_client_data& data)
+{
+    return data.peer_closed ? 0 : static_cast<uint32_t>(EPOLLRDHUP);
+}
+
+/**
+ * @brief puts a client back into reading mode after its response is send,
+ * so the next request can come in over the same connection.
+ * A request that was pipelined behind the last one is handled right away
+ * 
+ * @param fd the file descriptor of the client
+ * @param conn the connection table entry of the client
+ * @param event the epoll event from the client
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::keepAliveClient(int fd, s_connection& conn, epoll_event& event)
+{
+    conn.data->reset();
+    event.events = EPOLLIN | EPOLLRDHUP | trigger_mode_;
+    event.data.fd = fd;
+    if (doEpollCtl(EPOLL_CTL_MOD, fd, &event) != 0)
+    {
+        std::cerr << "modify client to keep-alive failed\n";
+        closeClient(fd);
+        return -1;
+    }
+    timers_.arm(fd, hostOf(conn).config_->getKeepaliveTimeout() * 1000, TIMER_KEEPALIVE);
+    if (!conn.data->in_buffer.empty())
+        return handleReadEvents(fd, conn, event);
+    return 0;
+}
+
+/**
+ * @brief when new clients are connecting we accept them and set up the events represending them.
+ * In edge-triggered mode the server socket is drained until accept4() has nothing left,
+ * in level-triggered mode one client is accepted per event.
+ * At max_connections or without free fds the listener is paused instead of staying readable
+ * 
+ * @param server_fd the file descripter where the request came from, aka the server
+ * @return 0 when dome,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::setupConnection(int server_fd, configInfo& config)
+{
+    while (true)
+    {
+        if (!generation_->config_->admission->admit(config.index_))
+        {
+            pauseListener(config);
+            return 0;
+        }
+        int client_fd = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd == -1)
+        {
+            generation_->config_->admission->release(config.index_);
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return 0;
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                shedConnection(server_fd);
+                pauseListener(config);
+                return 0;
+            }
+            std::cerr << "accept error\n";
+            return validator_.checkErrno(errno);
+        }
+        int nr = addClient(client_fd, config);
+        if (nr != 0)
+            return nr;
+        if (trigger_mode_ != EPOLLET)
+            return 0;
+    }
+}
+
+/**
+ * @brief sets up the clients accepted by the multishot accepts of the io_uring,
+ * clients over max_connections get a 503 and their listener is paused
+ * 
+ * @return 0 when done,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::acceptClients()
+{
+    for (const std::pair<int, int>& client : uring_.accepted())
+    {
+        configInfo* server = acceptedOn(client.first);
+        if (server == nullptr)
+        {
+            if (client.second >= 0)
+                close(client.second);
+            continue;
+        }
+        configInfo& config = *server;
+        bool stopped = config.server_fd_ == -1;
+        if (client.second < 0) // EMFILE or ENFILE
+        {
+            if (!stopped)
+            {
+                shedConnection(client.first);
+                pauseListener(config);
+            }
+            continue;
+        }
+        if (!generation_->config_->admission->admit(config.index_))
+        {
+            rejectClient(client.second);
+            if (!stopped)
+                pauseListener(config);
+            continue;
+        }
+        if (addClient(client.second, config) == -2)
+            return -2;
+    }
+    return 0;
+}
+
+/**
+ * @brief finds the server of the listener a io_uring accept completed on
+ * 
+ * @param listener_fd the listener of the accept
+ * @return the server, also for listeners stopped by a upgrade,
+ * @return nullptr if the listener is gone
+ */
+configInfo* Server::acceptedOn(int listener_fd)
+{
+    for (const std::pair<int, configInfo*>& stopped : stopped_listeners_)
+    {
+        if (stopped.first == listener_fd)
+            return stopped.second;
+    }
+    s_connection* listener = connections_.get(listener_fd);
+    if (listener == nullptr || listener->type != FD_LISTENER)
+        return nullptr;
+    return listener->server;
+}
+
+/**
+ * @brief stops listening for new clients on a server, the waiting clients stay in the listen backlog
+ * 
+ * @param config the server that is paused
+ */
+void Server::pauseListener(configInfo& config)
+{
+    if (config.paused_)
+        return;
+    if (uring_.active())
+        uring_.stopAccept(config.server_fd_);
+    else
+    {
+        epoll_event event{};
+        event.events = 0;
+        event.data.fd = config.server_fd_;
+        doEpollCtl(EPOLL_CTL_MOD, config.server_fd_, &event);
+    }
+    config.paused_ = true;
+    ++paused_listeners_;
+    std::cerr << "no room for clients on port " << config.port_ << ", pausing accept\n";
+}
+
+/**
+ * @brief listens for new clients again on paused servers that have room.
+ * After running out of file descriptors it waits ADMISSION_RETRY_MS first,
+ * a io_uring accept fails right away while no fd is free
+ */
+void Server::resumeListeners()
+{
+    if (ServerTimerWheel::nowMs() < fd_retry_at_)
+        return;
+    for (configInfo& config : generation_->servers_)
+    {
+        if (!config.paused_ || generation_->config_->admission->full(config.index_))
+            continue;
+        if (uring_.active())
+            uring_.startAccept(config.server_fd_);
+        else
+        {
+            epoll_event event{};
+            event.events = EPOLLIN | trigger_mode_;
+            event.data.fd = config.server_fd_;
+            doEpollCtl(EPOLL_CTL_MOD, config.server_fd_, &event);
+        }
+        config.paused_ = false;
+        --paused_listeners_;
+    }
+}
+
+/**
+ * @brief when the process is out of file descriptors the reserved fd is given up
+ * to accept one waiting client and turn it away, then it is reserved again
+ * 
+ * @param server_fd the listener with the waiting client
+ */
+void Server::shedConnection(int server_fd)
+{
+    std::cerr << "out of file descriptors, turning a client away\n";
+    fd_retry_at_ = ServerTimerWheel::nowMs() + ADMISSION_RETRY_MS;
+    if (spare_fd_ == -1)
+        return;
+    close(spare_fd_);
+    int client_fd = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (client_fd != -1)
+        rejectClient(client_fd);
+    spare_fd_ = open("/dev/null", O_RDONLY | O_CLOEXEC);
+}
+
+/**
+ * @brief answers a client that can not be served with a 503 and closes it
+ * 
+ * @param client_fd the file descriptor of the client
+ */
+void Server::rejectClient(int client_fd)
+{
+    send(client_fd, SERVICE_UNAVAILABLE, sizeof(SERVICE_UNAVAILABLE) - 1, MSG_NOSIGNAL);
+    close(client_fd);
+}
+
+/**
+ * @brief registers a accepted client in the connection table, the epoll and the timer wheel
+ * 
+ * @param client_fd the file descriptor of the new client
+ * @param config the server the client connected to
+ * @return 0 when done,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::addClient(int client_fd, configInfo& config)
+{
+    s_connection& conn = connections_.add(client_fd, FD_CLIENT, &config);
+    ++clients_;
+    counters_.accepted.fetch_add(1, std::memory_order_relaxed);
+    counters_.active.fetch_add(1, std::memory_order_relaxed);
+    conn.data = config.requestHandler_.setConfigForClient(config.config_, client_fd);
+    conn.data->server_index = config.index_;
+    conn.generation = generation_;
+    epoll_event client_event{};
+    client_event.events = EPOLLIN | EPOLLRDHUP | trigger_mode_;
+    client_event.data.fd = client_fd;
+    int nr = doEpollCtl(EPOLL_CTL_ADD, client_fd, &client_event);
+    if (nr != 0)
+    {
+        std::cerr << "setup connecton new client to epoll failed\n";
+        closeClient(client_fd);
+        return nr;
+    }
+    timers_.arm(client_fd, config.config_->getClientHeaderTimeout() * 1000, TIMER_HEADER);
+    if (config.port_ != 0) // a unix socket has no device queue to poll
+        setBusyPoll(client_fd);
+    return 0;
+}
+
+/**
+ * @brief handles a client whose timer expired, the client gets a timeout response and is closed.
+ * Idle keep-alive clients and clients that stopped reading a response that is partly send
+ * are closed without a response
+ * 
+ * @param client_fd the file descriptor of the client
+ * @return 0 when timeout response is send,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int Server::handleTimeout(int client_fd)
+{
+    s_connection* client = connections_.get(client_fd);
+    if (client == nullptr)
+        return -1;
+    if (client->type == FD_AWAIT)
+        return resumeAwait(client_fd, 0);
+    s_client_data& data = *client->data;
+    if (timers_.getPhase(client_fd) == TIMER_KEEPALIVE)
+    {
+        std::cout << "keep-alive timeout for " << client_fd << " reached\n";
+        closeClient(client_fd);
+        return 0;
+    }
+    if (data.responding)
+    {
+        std::cout << "send timeout for " << client_fd << " reached\n";
+        closeClient(client_fd);
+        return 0;
+    }
+    data.keep_alive = false;
+    int nr = hostOf(*client).responseHandler_.setupResponse(408, data);
+    data.output.flush(client_fd); // best effort, the client is closed either way
+    std::cout << "client timeout for " << client_fd << " reached\n";
+    closeClient(client_fd);
+    if (nr == SRH_OK)
+        return 0;
+    return nr;
+}
+
+/**
+ * @brief lets the event loop wake a coroutine when a fd is ready or the timeout passed
+ * 
+ * @param owner_fd the client the coroutine answers
+ * @param fd the fd the coroutine waits on
+ * @param events the epoll events it waits for
+ * @param timeout_ms milliseconds to wait at most, 0 without a timeout
+ * @param await the suspended await that is woken up
+ * @return 0 when done,
+ * @return -1 if the fd can not be watched
+ */
+int Server::watch(int owner_fd, int fd, uint32_t events, uint64_t timeout_ms, ServerAwait* await)
+{
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    if (doEpollCtl(EPOLL_CTL_ADD, fd, &event) != 0)
+        return -1;
+    s_connection& conn = connections_.add(fd, FD_AWAIT, nullptr);
+    conn.await = await;
+    conn.owner = owner_fd;
+    if (timeout_ms > 0)
+        timers_.arm(fd, timeout_ms, TIMER_AWAIT);
+    return 0;
+}
+
+/**
+ * @brief stops watching a fd of a coroutine, when it is woken up or destroyed
+ * 
+ * @param fd the fd the coroutine waited on
+ */
+void Server::unwatch(int fd)
+{
+    doEpollCtl(EPOLL_CTL_DEL, fd, nullptr);
+    timers_.cancel(fd);
+    connections_.remove(fd);
+}
+
+/**
+ * @brief wakes the coroutine waiting on a fd, when it returns its client gets the response
+ * 
+ * @param fd the fd the coroutine waited on
+ * @param events the events of the fd, 0 if its timeout passed
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::resumeAwait(int fd, uint32_t events)
+{
+    s_connection* conn = connections_.get(fd);
+    ServerAwait* await = conn->await;
+    int owner = conn->owner;
+    unwatch(fd);
+    await->wake(fd, events);
+    return resumeClient(owner);
+}
+
+/**
+ * @return true if blocking filesystem work goes to aio threads
+ */
+bool Server::offloading() const
+{
+    return aio_.active();
+}
+
+/**
+ * @return the content cache of this worker, nullptr if there is none
+ */
+ServerContentCache* Server::contentCache()
+{
+    return content_cache_.get();
+}
+
+/**
+ * @brief hands blocking filesystem work of a coroutine to the aio threads
+ * 
+ * @param job the work and the coroutine that waits for it
+ * @return 0 when it is queued,
+ * @return -1 if there are no aio threads, the caller does the work itself
+ */
+int Server::offload(s_aio_job* job)
+{
+    if (!aio_.active())
+        return -1;
+    job->pending = true;
+    aio_.submit(job, aio_done_);
+    return 0;
+}
+
+/**
+ * @brief takes back the job of a coroutine that is destroyed before it was resumed
+ * 
+ * @param job the job
+ */
+void Server::cancelOffload(s_aio_job* job)
+{
+    aio_.cancel(job);
+    job->pending = false;
+}
+
+/**
+ * @brief resumes the coroutines whose aio job is done, one at a time,
+ * a coroutine that closes a client can not leave a job of that client behind
+ * 
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::handleAio()
+{
+    aio_done_.clearEvent();
+    int result = 0;
+    s_aio_job* job;
+    while ((job = aio_done_.pop()) != nullptr)
+    {
+        int owner = job->owner;
+        job->pending = false;
+        job->handle.resume();
+        if (resumeClient(owner) != 0)
+            result = -1;
+    }
+    return result;
+}
+
+/**
+ * @brief reads the next piece of the file of a response on a aio thread,
+ * the client only waits for a hang up until it is in the output queue
+ * 
+ * @param data the client, it outlives the coroutine
+ */
+ServerTask Server::readFile(s_client_data& data)
+{
+    co_await ServerAioAwait(*this, data.fd, [&data]() { data.output.readFile(); });
+}
+
+/**
+ * @brief sends the response a coroutine built once it returned
+ * 
+ * @param client_fd the client of the coroutine
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::resumeClient(int client_fd)
+{
+    s_connection* client = connections_.get(client_fd);
+    if (client == nullptr || client->type != FD_CLIENT || client->data->task.active())
+        return 0;
+    s_client_data& data = *client->data;
+    data.task = ServerTask();
+    if (data.output.empty()) // the coroutine stopped on a exception
+    {
+        data.keep_alive = false;
+        hostOf(*client).responseHandler_.setupResponse(500, data);
+    }
+    data.responding = true;
+    epoll_event event{};
+    event.events = EPOLLOUT | hangupEvents(data) | trigger_mode_;
+    event.data.fd = client_fd;
+    if (doEpollCtl(EPOLL_CTL_MOD, client_fd, &event) != 0)
+    {
+        closeClient(client_fd);
+        return -1;
+    }
+    timers_.arm(client_fd, hostOf(*client).config_->getSendTimeout() * 1000, TIMER_RESPONSE);
+    return 0;
+}
+
+/**
+ * @brief reads into the request from the client and stores it for later handling.
+ * When the request is not complete the client stays in reading mode,
+ * a started header keeps its header timeout and every read of the body renews the body timeout
+ * 
+ * @param fd the client file descriptor
+ * @param conn the connection table entry of the client
+ * @param event the epoll event from the client
+ * @return 0 when request is stored,
+ * @return -1 on eror,
+ * @return -2 on critical error
+ */
+int Server::handleReadEvents(int fd, s_connection& conn, epoll_event& event)
+{
+    configInfo& server = *conn.server;
+    e_reponses function_response = server.requestHandler_.readRequest(fd, quantumOf(conn));
+    configInfo& host = hostOf(conn); // picked from the Host header once the header is read
+    if (function_response == READ_INCOMPLETE || function_response == READ_YIELD)
+    {
+        if (conn.data->parse_state != PARSE_HEADER)
+            timers_.arm(fd, host.config_->getClientBodyTimeout() * 1000, TIMER_BODY);
+        else if (timers_.getPhase(fd) == TIMER_KEEPALIVE && !conn.data->in_buffer.empty())
+            timers_.arm(fd, host.config_->getClientHeaderTimeout() * 1000, TIMER_HEADER);
+        if (function_response == READ_YIELD)
+            yieldClient(fd, conn, EPOLLIN);
+        return 0;
+    }
+    if (function_response != E_ROK)
+    {
+        if (function_response == RECV_EMPTY)
+        {
+            closeClient(fd);
+            return 0;
+        }
+        conn.data->keep_alive = false;
+        if (function_response == READ_HEADER_BODY_TOO_LARGE)
+        {
+            int return_value = host.responseHandler_.setupResponse(413, *conn.data);
+            conn.data->output.flush(fd); // best effort, the client is closed either way
+            closeClient(fd);
+            return return_value;
+        }
+        std::cerr << "function_response is [" << function_response << "]\n";
+        host.responseHandler_.setupResponse(400, *conn.data);
+        conn.data->output.flush(fd); // best effort, the client is closed either way
+        closeClient(fd);
+        return -1;
+    }
+    function_response = server.requestHandler_.handleClient(fd, event);
+    if (function_response == MODIFY_CLIENT_WRITE)
+    {
+        event.events |= EPOLLRDHUP | trigger_mode_;
+        if (doEpollCtl(EPOLL_CTL_MOD, fd, &event) != 0)
+        {
             std::cerr << "modify client in main loop failed\n";
-            it->requestHandler_.removeNodeFromRequest(fd);
-            doEpollCtl(EPOLL_CTL_DEL, fd, &event);
-            close(fd);
+            closeClient(fd);
             return -1;
         }
+        timers_.arm(fd, host.config_->getSendTimeout() * 1000, TIMER_RESPONSE);
         return 0;
     }
     return -2;
 }
 
-configInfo::configInfo(std::shared_ptr<Config>& conf) : requestHandler_(conf.get()->getClientMaxBodySize()), responseHandler_(conf.get()->getLocations(),conf.get()->getRoot(),conf.get()->getErrorPages()), config_(conf)
+/**
+ * @brief builds the response for the client on the first write event
+ * and sends as much of it as the socket accepts,
+ * the rest is send on the following write events
+ * 
+ * @param fd the client file descriptor
+ * @param conn the connection table entry of the client
+ * @param event the epoll event from the client
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::handleWriteEvents(int fd, s_connection& conn, epoll_event& event)
+{
+    configInfo& server = hostOf(conn);
+    s_client_data& data = *conn.data;
+    if (!data.responding)
+    {
+        if (conn.generation != generation_ || draining_) // the config was reloaded or the process is upgraded, let the client go
+            data.keep_alive = false;
+        counters_.requests.fetch_add(1, std::memory_order_relaxed);
+        e_server_request_return nr = server.responseHandler_.handleResponse(data, server.config_->getLocations());
+        // TODO remove if statement for eval
+        if (nr == SRH_DO_TIMEOUT)
+        {
+            event.events = hangupEvents(data) | trigger_mode_;
+            return doEpollCtl(EPOLL_CTL_MOD, fd, &event);
+        }
+        if (nr == SRH_SUSPENDED) // the coroutine has its own deadline, the client only waits for a hang up
+        {
+            timers_.cancel(fd);
+            event.events = hangupEvents(data) | trigger_mode_;
+            return doEpollCtl(EPOLL_CTL_MOD, fd, &event);
+        }
+        if (nr != SRH_OK)
+        {
+            data.keep_alive = false;
+            if (nr == SRH_INCORRECT_HTTP_VERSION)
+                server.responseHandler_.setupResponse(505, data);
+            else if (data.output.empty())
+                server.responseHandler_.setupResponse(500, data);
+        }
+        data.responding = true;
+        // a coroutine that waits on a fd adds it to the table, which can move every entry
+        return flushClient(fd, *connections_.get(fd), event);
+    }
+    return flushClient(fd, conn, event);
+}
+
+/**
+ * @brief sends the queued response of the client until the socket would block.
+ * When everything is send the connection is closed or kept alive,
+ * otherwise the client waits for the next write event with a new send timeout.
+ * With aio threads the next piece of a file is read on a aio thread while the client only waits for a hang up
+ * 
+ * @param fd the client file descriptor
+ * @param conn the connection table entry of the client
+ * @param event the epoll event from the client
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int Server::flushClient(int fd, s_connection& conn, epoll_event& event)
+{
+    s_client_data& data = *conn.data;
+    e_flush_return nr = data.output.flush(fd, !aio_.active(), quantumOf(conn));
+    if (nr == FLUSH_READ)
+    {
+        data.task = readFile(data);
+        timers_.cancel(fd);
+        event.events = hangupEvents(data) | trigger_mode_;
+        return doEpollCtl(EPOLL_CTL_MOD, fd, &event);
+    }
+    if (nr == FLUSH_AGAIN || nr == FLUSH_YIELD)
+    {
+        timers_.arm(fd, hostOf(conn).config_->getSendTimeout() * 1000, TIMER_RESPONSE);
+        if (nr == FLUSH_YIELD)
+            yieldClient(fd, conn, EPOLLOUT);
+        return 0;
+    }
+    if (nr == FLUSH_ERROR)
+    {
+        std::cerr << "sending response to " << fd << " failed\n";
+        closeClient(fd);
+        return -1;
+    }
+    if (!data.keepAlive())
+    {
+        closeClient(fd);
+        return 0;
+    }
+    return keepAliveClient(fd, conn, event);
+}
+
+/**
+ * @brief the bytes a client reads or sends in one turn, the io_quantum of its server block
+ * times the weight of the location that answers its request
+ * 
+ * @param conn the connection table entry of the client
+ * @return the quantum in bytes, 0 for no limit
+ */
+uint64_t Server::quantumOf(s_connection& conn)
+{
+    return hostOf(conn).config_->getIoQuantum() * conn.data->weight;
+}
+
+/**
+ * @brief puts a client that used up its quantum in the run queue.
+ * It goes on in the next round, after the next wait and the clients that are ready with it,
+ * the socket may not report the bytes that are left again with edge triggered epoll or io_uring
+ * 
+ * @param fd the client file descriptor
+ * @param conn the connection table entry of the client
+ * @param events EPOLLIN to go on reading the request, EPOLLOUT to go on sending the response
+ */
+void Server::yieldClient(int fd, s_connection& conn, uint32_t events)
+{
+    conn.data->yielded = run_round_ + 1;
+    epoll_event event{};
+    event.events = events;
+    event.data.fd = fd;
+    run_queue_.push_back(event);
+}
+
+/**
+ * @brief gives the clients taken from the run queue at the start of the round their next turn.
+ * A client that had a event since it yielded already had its turn, a closed one is gone,
+ * a client that uses up its quantum again waits for the next round
+ * 
+ * @return 0 when done,
+ * @return -2 on critical error
+ */
+int Server::runYielded()
+{
+    for (epoll_event& event : run_turn_)
+    {
+        s_connection* conn = connections_.get(event.data.fd);
+        if (conn == nullptr || conn->type != FD_CLIENT || conn->data->yielded != run_round_)
+            continue;
+        if (checkEvents(event) == -2)
+        {
+            run_turn_.clear();
+            return -2;
+        }
+    }
+    run_turn_.clear();
+    return 0;
+}
+
+/**
+ * @brief the server block that answers the current request of a client,
+ * picked from its Host header out of the server blocks on the port it connected to
+ * 
+ * @param conn the connection table entry of the client
+ * @return the server block
+ */
+configInfo& Server::hostOf(s_connection& conn)
+{
+    return conn.generation->servers_[conn.data->server_index];
+}
+
+configInfo::configInfo(std::shared_ptr<Config>& conf) : requestHandler_(), responseHandler_(conf.get()->getLocations(),conf.get()->getRoot(),conf.get()->getErrorPages()), config_(conf)
 {
+    responseHandler_.setFileCache(*conf);
+    responseHandler_.setBundle(*conf);
     std::string root_folder_ = conf.get()->getRoot();
     std::string main_index_ = conf.get()->getIndex();
     locations_ = conf.get()->getLocations();
     error_pages_ = conf.get()->getErrorPages();
     server_fd_ = -1;
-    server_name_ = conf.get()->getServerName();
-    if (server_name_ == "localhost")
-        server_name_ = "127.0.0.1";
+    // the other server names are matched against the Host header, they do not pick a address
+    server_name_ = conf.get()->getServerName() == "localhost" ? "127.0.0.1" : "0.0.0.0";
+    if (!conf.get()->getListenUnix().empty())
+        server_name_ = "unix:" + conf.get()->getListenUnix();
     port_ = conf.get()->getPort();
+    index_ = 0;
+    paused_ = false;
+    inherited_ = false;
 }
 
 std::string Server::epollEventToString(uint32_t events)
@@ -0,0 +1,63 @@
+#include "server/ServerAdmission.hpp"
+
+/**
+ * @param configs the server blocks of the generation
+ * @param previous the admission of the generation before, its clients keep counting for the process
+ */
+ServerAdmission::ServerAdmission(const std::vector<std::shared_ptr<Config>>& configs, const ServerAdmission* previous)
+{
+    if (previous != nullptr)
+        total_ = previous->total_;
+    else
+        total_ = std::make_shared<std::atomic<uint64_t>>(0);
+    max_total_ = configs[0]->getGlobalMaxConnections();
+    per_server_ = std::make_unique<std::atomic<uint64_t>[]>(configs.size());
+    for (size_t i = 0; i < configs.size(); ++i)
+    {
+        max_server_.push_back(configs[i]->getMaxConnections());
+        per_server_[i] = 0;
+    }
+}
+
+ServerAdmission::~ServerAdmission() {};
+
+/**
+ * @brief takes a place for a new client when the process and the server block are below their limit
+ * 
+ * @param server the index of the server block
+ * @return true if the client may be accepted,
+ * @return false when a limit is reached
+ */
+bool ServerAdmission::admit(size_t server)
+{
+    uint64_t total = total_->fetch_add(1, std::memory_order_relaxed) + 1;
+    uint64_t count = per_server_[server].fetch_add(1, std::memory_order_relaxed) + 1;
+    if ((max_total_ != 0 && total > max_total_) || (max_server_[server] != 0 && count > max_server_[server]))
+    {
+        release(server);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief gives the place of a closed client back
+ * 
+ * @param server the index of the server block
+ */
+void ServerAdmission::release(size_t server)
+{
+    total_->fetch_sub(1, std::memory_order_relaxed);
+    per_server_[server].fetch_sub(1, std::memory_order_relaxed);
+}
+
+/**
+ * @param server the index of the server block
+ * @return true if no new client can be admitted to the server block
+ */
+bool ServerAdmission::full(size_t server) const
+{
+    if (max_total_ != 0 && total_->load(std::memory_order_relaxed) >= max_total_)
+        return true;
+    return max_server_[server] != 0 && per_server_[server].load(std::memory_order_relaxed) >= max_server_[server];
+}
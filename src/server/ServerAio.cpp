@@ -0,0 +1,183 @@
+#include "server/ServerAio.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+
+ServerAioQueue::ServerAioQueue() : fd_(-1) {}
+
+ServerAioQueue::~ServerAioQueue()
+{
+    if (fd_ != -1)
+        close(fd_);
+}
+
+/**
+ * @brief makes the eventfd the aio threads wake the worker on
+ *
+ * @return 0 when done,
+ * @return -1 if the eventfd could not be made
+ */
+int ServerAioQueue::setup()
+{
+    fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    return fd_ == -1 ? -1 : 0;
+}
+
+/**
+ * @return the eventfd that is readable while finished jobs wait
+ */
+int ServerAioQueue::fd() const
+{
+    return fd_;
+}
+
+/**
+ * @brief adds a finished job and wakes the worker, called by a aio thread
+ *
+ * @param job the finished job
+ */
+void ServerAioQueue::push(s_aio_job* job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+    uint64_t one = 1;
+    if (write(fd_, &one, sizeof(one)) != sizeof(one))
+        return; // the counter is already set, the worker is woken up anyway
+}
+
+/**
+ * @return the next finished job, nullptr if none is left
+ */
+s_aio_job* ServerAioQueue::pop()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (jobs_.empty())
+        return nullptr;
+    s_aio_job* job = jobs_.front();
+    jobs_.erase(jobs_.begin());
+    return job;
+}
+
+/**
+ * @brief drops a finished job whose coroutine is destroyed before it was resumed
+ *
+ * @param job the job
+ */
+void ServerAioQueue::remove(s_aio_job* job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.erase(std::remove(jobs_.begin(), jobs_.end(), job), jobs_.end());
+}
+
+/**
+ * @brief resets the eventfd before the worker pops the finished jobs
+ */
+void ServerAioQueue::clearEvent()
+{
+    uint64_t count;
+    if (read(fd_, &count, sizeof(count)) != sizeof(count))
+        return;
+}
+
+/**
+ * @brief starts the aio threads with every signal blocked, the signals of the process go to the workers
+ *
+ * @param threads the number of aio threads, 0 for none
+ */
+ServerAioPool::ServerAioPool(size_t threads) : stopping_(false)
+{
+    sigset_t all;
+    sigset_t old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &old);
+    for (size_t i = 0; i < threads; ++i)
+        threads_.emplace_back(&ServerAioPool::run, this);
+    pthread_sigmask(SIG_SETMASK, &old, nullptr);
+}
+
+/**
+ * @brief lets the aio threads finish the job they run and joins them, queued jobs are dropped
+ */
+ServerAioPool::~ServerAioPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (std::thread& thread : threads_)
+        thread.join();
+}
+
+/**
+ * @return true if there are aio threads to offload to
+ */
+bool ServerAioPool::active() const
+{
+    return !threads_.empty();
+}
+
+/**
+ * @brief queues a job for the next free aio thread
+ *
+ * @param job the job, it stays alive until it is resumed or cancelled
+ * @param done the completions of the worker that submits it
+ */
+void ServerAioPool::submit(s_aio_job* job, ServerAioQueue& done)
+{
+    job->done = &done;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(job);
+    }
+    work_ready_.notify_one();
+}
+
+/**
+ * @brief takes back a job whose coroutine is destroyed: a queued job is dropped,
+ * a running one is waited for, a finished one is taken out of the completions of its worker
+ *
+ * @param job the job
+ */
+void ServerAioPool::cancel(s_aio_job* job)
+{
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        std::deque<s_aio_job*>::iterator queued = std::find(queue_.begin(), queue_.end(), job);
+        if (queued != queue_.end())
+        {
+            queue_.erase(queued);
+            return;
+        }
+        work_done_.wait(lock, [this, job]() { return std::find(running_.begin(), running_.end(), job) == running_.end(); });
+    }
+    job->done->remove(job);
+}
+
+// private functions
+
+/**
+ * @brief a aio thread: runs queued jobs and hands them to the worker that submitted them.
+ * The job is pushed before it stops counting as running, so a cancel never misses it
+ */
+void ServerAioPool::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        work_ready_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+        if (stopping_)
+            return;
+        s_aio_job* job = queue_.front();
+        queue_.pop_front();
+        running_.push_back(job);
+        lock.unlock();
+        job->work();
+        lock.lock();
+        job->done->push(job);
+        running_.erase(std::find(running_.begin(), running_.end(), job));
+        work_done_.notify_all();
+    }
+}
@@ -0,0 +1,303 @@
+#include "server/ServerBundle.hpp"
+#include "server/ServerResponseHandler.hpp"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/**
+ * @param base the mapped bundle
+ * @param size the bytes of the mapping
+ * @param root the root the bundle was packed from, relative to the working directory
+ */
+ServerBundle::ServerBundle(const char* base, size_t size, const std::string& root) : base_(base), size_(size), root_(root)
+{
+    header_ = reinterpret_cast<const s_bundle_header*>(base_);
+    slots_ = nullptr;
+    entries_ = nullptr;
+}
+
+ServerBundle::~ServerBundle()
+{
+    munmap(const_cast<char*>(base_), size_);
+}
+
+/**
+ * @brief maps a bundle and checks that every offset in it stays inside the file
+ *
+ * @param bundle_path the bundle file relative to the working directory
+ * @param root the root of the server block relative to the working directory, the paths looked up start with it
+ * @return the bundle,
+ * @return nullptr if it can not be mapped or is no valid bundle
+ */
+std::shared_ptr<const ServerBundle> ServerBundle::map(const std::string& bundle_path, const std::string& root)
+{
+    int fd = open(bundle_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return nullptr;
+    struct stat buffer;
+    if (fstat(fd, &buffer) == -1 || buffer.st_size < static_cast<off_t>(sizeof(s_bundle_header)))
+    {
+        close(fd);
+        return nullptr;
+    }
+    void* base = mmap(nullptr, buffer.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file
+    if (base == MAP_FAILED)
+        return nullptr;
+    std::shared_ptr<ServerBundle> bundle(new ServerBundle(static_cast<const char*>(base), buffer.st_size, root));
+    if (!bundle->check())
+        return nullptr;
+    return bundle;
+}
+
+/**
+ * @brief packs every regular file below root into a bundle, the index is keyed by the path below root.
+ * A file.gz next to a file is packed as the gzip variant of that file instead of as a file of its own.
+ * The bundle is written next to its place and renamed over it, a server that still maps the old one keeps it
+ *
+ * @param root the directory to pack
+ * @param bundle_path the bundle to write
+ * @return 0 when done,
+ * @return -1 if reading the root or writing the bundle failed
+ */
+int ServerBundle::pack(const std::string& root, const std::string& bundle_path)
+{
+    struct s_packed_file
+    {
+        std::string path;
+        std::string body;
+        std::string gzip;
+        bool has_gzip;
+    };
+    std::vector<s_packed_file> files;
+    std::error_code error;
+    std::filesystem::recursive_directory_iterator it(root, error);
+    for (; !error && it != std::filesystem::recursive_directory_iterator(); it.increment(error))
+    {
+        if (!it->is_regular_file())
+            continue;
+        const std::filesystem::path& file = it->path();
+        if (file.extension() == ".gz" && std::filesystem::is_regular_file(file.parent_path() / file.stem()))
+            continue; // packed with the file it belongs to
+        s_packed_file packed{"/" + file.lexically_relative(root).generic_string(), "", "", false};
+        std::ifstream body(file, std::ios::binary);
+        std::ostringstream body_stream;
+        body_stream << body.rdbuf();
+        if (!body)
+        {
+            std::cerr << "reading " << file.string() << " failed\n";
+            return -1;
+        }
+        packed.body = body_stream.str();
+        std::ifstream gzip(file.string() + ".gz", std::ios::binary);
+        if (gzip.is_open())
+        {
+            std::ostringstream gzip_stream;
+            gzip_stream << gzip.rdbuf();
+            packed.gzip = gzip_stream.str();
+            packed.has_gzip = true;
+        }
+        files.push_back(std::move(packed));
+    }
+    if (error)
+    {
+        std::cerr << "reading " << root << " failed: " << error.message() << "\n";
+        return -1;
+    }
+
+    s_bundle_header header{};
+    std::memcpy(header.magic, BUNDLE_MAGIC, sizeof(header.magic));
+    header.entry_count = files.size();
+    header.slot_count = 1;
+    while (header.slot_count < files.size() * 2)
+        header.slot_count *= 2;
+    header.slots_offset = sizeof(s_bundle_header);
+    header.entries_offset = header.slots_offset + header.slot_count * sizeof(uint64_t);
+    uint64_t blob_offset = header.entries_offset + files.size() * sizeof(s_bundle_entry);
+
+    std::vector<uint64_t> slots(header.slot_count, 0);
+    std::vector<s_bundle_entry> entries(files.size());
+    std::string blob;
+    auto add = [&blob, blob_offset](const std::string& bytes, uint64_t& offset, uint64_t& length)
+    {
+        offset = blob_offset + blob.size();
+        length = bytes.size();
+        blob.append(bytes);
+    };
+    size_t gzipped = 0;
+    for (size_t i = 0; i < files.size(); ++i)
+    {
+        const s_packed_file& file = files[i];
+        s_bundle_entry& entry = entries[i];
+        std::string type = ServerResponseHandler::getContentType(file.path);
+        entry.hash = hash(file.path.data(), file.path.size());
+        add(file.path, entry.path_offset, entry.path_length);
+        std::string tag = etag(file.body);
+        std::string headers = "Content-Type: " + type + "\r\nContent-Length: " + std::to_string(file.body.size())
+            + "\r\nETag: " + tag + "\r\n" + (file.has_gzip ? "Vary: Accept-Encoding\r\n" : "") + "\r\n";
+        add(headers, entry.plain.headers_offset, entry.plain.headers_length);
+        add(tag, entry.plain.etag_offset, entry.plain.etag_length);
+        add(file.body, entry.plain.body_offset, entry.plain.body_length);
+        if (file.has_gzip)
+        {
+            tag = etag(file.gzip);
+            headers = "Content-Type: " + type + "\r\nContent-Encoding: gzip\r\nContent-Length: " + std::to_string(file.gzip.size())
+                + "\r\nETag: " + tag + "\r\nVary: Accept-Encoding\r\n\r\n";
+            add(headers, entry.gzip.headers_offset, entry.gzip.headers_length);
+            add(tag, entry.gzip.etag_offset, entry.gzip.etag_length);
+            add(file.gzip, entry.gzip.body_offset, entry.gzip.body_length);
+            ++gzipped;
+        }
+        uint64_t slot = entry.hash & (header.slot_count - 1);
+        while (slots[slot] != 0)
+            slot = (slot + 1) & (header.slot_count - 1);
+        slots[slot] = i + 1;
+    }
+    header.file_size = blob_offset + blob.size();
+
+    std::string temporary = bundle_path + ".tmp";
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(uint64_t));
+    out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(s_bundle_entry));
+    out.write(blob.data(), blob.size());
+    out.close();
+    if (!out || std::rename(temporary.c_str(), bundle_path.c_str()) != 0)
+    {
+        std::cerr << "writing " << bundle_path << " failed\n";
+        std::remove(temporary.c_str());
+        return -1;
+    }
+    std::cout << "packed " << files.size() << " files (" << gzipped << " with a gzip variant) from " << root
+        << " into " << bundle_path << ", " << header.file_size << " bytes\n";
+    return 0;
+}
+
+/**
+ * @brief finds a file by the path the validator and the response handler use
+ *
+ * @param path the path relative to the working directory, it has to start with the root
+ * @return the file,
+ * @return nullptr if the path is outside the root or not in the bundle
+ */
+const s_bundle_entry* ServerBundle::find(const std::string& path) const
+{
+    if (path.compare(0, root_.size(), root_) != 0)
+        return nullptr;
+    if (!root_.empty() && path.size() > root_.size() && path[root_.size()] != '/')
+        return nullptr; // a sibling that starts with the name of the root
+    std::string key;
+    key.reserve(path.size() - root_.size() + 1);
+    key.push_back('/');
+    for (size_t i = root_.size(); i < path.size(); ++i)
+    {
+        if (path[i] != '/' || key.back() != '/') // the config can put a double slash between root and path
+            key.push_back(path[i]);
+    }
+    uint64_t key_hash = hash(key.data(), key.size());
+    uint64_t mask = header_->slot_count - 1;
+    for (uint64_t slot = key_hash & mask; slots_[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const s_bundle_entry& entry = entries_[slots_[slot] - 1];
+        if (entry.hash == key_hash && entry.path_length == key.size() && std::memcmp(base_ + entry.path_offset, key.data(), key.size()) == 0)
+            return &entry;
+    }
+    return nullptr;
+}
+
+/**
+ * @param offset a offset from a entry
+ * @return the bytes at the offset in the mapping
+ */
+const char* ServerBundle::data(uint64_t offset) const
+{
+    return base_ + offset;
+}
+
+// private functions
+
+/**
+ * @brief checks the header, the index and every range of every entry against the size of the mapping
+ *
+ * @return true if the bundle can be used without further checks
+ */
+bool ServerBundle::check() const
+{
+    if (std::memcmp(header_->magic, BUNDLE_MAGIC, sizeof(header_->magic)) != 0 || header_->file_size != size_)
+        return false;
+    uint64_t slots = header_->slot_count;
+    uint64_t entries = header_->entry_count;
+    if (slots == 0 || (slots & (slots - 1)) != 0 || entries >= slots || slots > size_ / sizeof(uint64_t)
+        || entries > size_ / sizeof(s_bundle_entry))
+        return false;
+    if (header_->slots_offset % 8 != 0 || header_->entries_offset % 8 != 0
+        || header_->slots_offset > size_ - slots * sizeof(uint64_t)
+        || header_->entries_offset > size_ - entries * sizeof(s_bundle_entry))
+        return false;
+    const uint64_t* slot_table = reinterpret_cast<const uint64_t*>(base_ + header_->slots_offset);
+    const s_bundle_entry* entry_table = reinterpret_cast<const s_bundle_entry*>(base_ + header_->entries_offset);
+    for (uint64_t i = 0; i < slots; ++i)
+    {
+        if (slot_table[i] > entries)
+            return false;
+    }
+    for (uint64_t i = 0; i < entries; ++i)
+    {
+        const s_bundle_entry& entry = entry_table[i];
+        if (entry.path_offset > size_ || entry.path_length > size_ - entry.path_offset
+            || !checkVariant(entry.plain) || !checkVariant(entry.gzip))
+            return false;
+    }
+    const_cast<ServerBundle*>(this)->slots_ = slot_table;
+    const_cast<ServerBundle*>(this)->entries_ = entry_table;
+    return true;
+}
+
+/**
+ * @param variant a variant of a entry
+ * @return true if its headers, body and ETag are inside the mapping
+ */
+bool ServerBundle::checkVariant(const s_bundle_variant& variant) const
+{
+    return variant.headers_offset <= size_ && variant.headers_length <= size_ - variant.headers_offset
+        && variant.body_offset <= size_ && variant.body_length <= size_ - variant.body_offset
+        && variant.etag_offset <= size_ && variant.etag_length <= size_ - variant.etag_offset;
+}
+
+/**
+ * @brief FNV-1a, for the index and the ETags
+ *
+ * @param data the bytes
+ * @param size the amount of bytes
+ * @return the hash
+ */
+uint64_t ServerBundle::hash(const char* data, size_t size)
+{
+    uint64_t value = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        value ^= static_cast<unsigned char>(data[i]);
+        value *= 1099511628211ULL;
+    }
+    return value;
+}
+
+/**
+ * @param body the bytes of a variant
+ * @return the quoted ETag of it
+ */
+std::string ServerBundle::etag(const std::string& body)
+{
+    std::ostringstream tag;
+    tag << '"' << std::hex << std::setw(16) << std::setfill('0') << hash(body.data(), body.size()) << '"';
+    return tag.str();
+}
@@ -0,0 +1,70 @@
+#include "server/ServerConnectionTable.hpp"
+
+ServerConnectionTable::ServerConnectionTable() : count_(0) {};
+
+ServerConnectionTable::~ServerConnectionTable() {};
+
+/**
+ * @brief registers a fd in the table, the table grows when the fd is larger than the table.
+ * Growing moves every entry, a entry of another fd is looked up again after adding
+ * 
+ * @param fd the file descriptor to register
+ * @param type what kind of fd it is
+ * @param server the server block the fd belongs to
+ * @return the entry of the fd
+ */
+s_connection& ServerConnectionTable::add(int fd, e_fd_type type, configInfo* server)
+{
+    if (static_cast<size_t>(fd) >= table_.size())
+        table_.resize(fd + 1 > 64 ? (fd + 1) * 2 : 64);
+    s_connection& conn = table_[fd];
+    if (conn.type == FD_NONE)
+        ++count_;
+    conn = s_connection();
+    conn.type = type;
+    conn.server = server;
+    return conn;
+}
+
+/**
+ * @brief looks up the entry of a fd
+ * 
+ * @param fd the file descriptor to look up
+ * @return the entry of the fd,
+ * @return nullptr if the fd is not in the table
+ */
+s_connection* ServerConnectionTable::get(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= table_.size() || table_[fd].type == FD_NONE)
+        return nullptr;
+    return &table_[fd];
+}
+
+/**
+ * @brief removes a fd from the table
+ * 
+ * @param fd the file descriptor to remove
+ */
+void ServerConnectionTable::remove(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= table_.size() || table_[fd].type == FD_NONE)
+        return;
+    table_[fd] = s_connection();
+    --count_;
+}
+
+/**
+ * @return the amount of fds in the table
+ */
+size_t ServerConnectionTable::size() const
+{
+    return count_;
+}
+
+/**
+ * @return one past the highest fd the table has room for, to walk over every entry
+ */
+int ServerConnectionTable::end() const
+{
+    return static_cast<int>(table_.size());
+}
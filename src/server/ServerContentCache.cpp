@@ -0,0 +1,255 @@
+#include "server/ServerContentCache.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+// everything that changes, replaces or removes a file of a watched directory, or the directory itself
+#define CONTENT_CACHE_WATCH (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+
+/**
+ * @param size the bytes of file contents kept at most
+ * @param max_file the largest file that is kept
+ */
+ServerContentCache::ServerContentCache(uint64_t size, uint64_t max_file) : size_(size), max_file_(max_file), used_(0), epoch_(0), fd_(-1) {}
+
+ServerContentCache::~ServerContentCache()
+{
+    if (fd_ != -1)
+        close(fd_);
+}
+
+/**
+ * @brief makes the inotify instance the directories of the cached files are watched with
+ *
+ * @return 0 when done,
+ * @return -1 if inotify is not available
+ */
+int ServerContentCache::setup()
+{
+    fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    return fd_ == -1 ? -1 : 0;
+}
+
+/**
+ * @return the inotify fd, readable while changes of cached files wait
+ */
+int ServerContentCache::fd() const
+{
+    return fd_;
+}
+
+/**
+ * @brief looks up a file, a cached one is returned without a system call.
+ * A missing one is read and kept, its directory is watched before it is read
+ * so a change while reading it is not missed
+ *
+ * @param path the path relative to the working directory
+ * @param content_type the Content-Type of the file
+ * @return the file with its header lines,
+ * @return nullptr if the file is too large, can not be read or its directory can not be watched
+ */
+std::shared_ptr<const s_cached_content> ServerContentCache::lookup(const std::string& path, const std::string& content_type)
+{
+    uint64_t epoch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unordered_map<std::string, std::list<s_entry>::iterator>::iterator it = entries_.find(path);
+        if (it != entries_.end())
+        {
+            lru_.splice(lru_.begin(), lru_, it->second);
+            return it->second->content;
+        }
+        size_t slash = path.rfind('/');
+        if (!watch(slash == std::string::npos ? "." : path.substr(0, slash)))
+            return nullptr;
+        epoch = epoch_;
+    }
+    std::shared_ptr<s_cached_content> content = std::make_shared<s_cached_content>();
+    int nr = load(path, content_type, *content);
+    if (nr == -1)
+        return nullptr;
+    if (nr == 1)
+        content = nullptr;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (epoch == epoch_) // no change was reported while the file was read
+        store(path, content, path.size() + (content ? content->headers.size() + content->body.size() : 0));
+    return content;
+}
+
+/**
+ * @brief reads the pending inotify events and drops the files they are about,
+ * a directory that is removed or moved drops every file under it
+ */
+void ServerContentCache::handleEvents()
+{
+    alignas(inotify_event) char buffer[4096];
+    ssize_t length;
+    while ((length = read(fd_, buffer, sizeof(buffer))) > 0)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ++epoch_;
+        for (char* position = buffer; position < buffer + length;)
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+            if (event->mask & IN_Q_OVERFLOW)
+                clear(); // events were lost, nothing cached can be trusted
+            else if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED))
+                dropDirectory(event->wd, !(event->mask & IN_IGNORED));
+            else if (event->len > 0)
+            {
+                std::unordered_map<int, std::vector<std::string>>::iterator it = watches_.find(event->wd);
+                if (it == watches_.end())
+                    continue;
+                for (const std::string& dir : it->second)
+                    drop(dir + "/" + event->name);
+            }
+        }
+    }
+}
+
+// private functions
+
+/**
+ * @brief reads a file and builds its header lines
+ *
+ * @param path the path relative to the working directory
+ * @param content_type the Content-Type of the file
+ * @param content what will hold the file
+ * @return 0 when done,
+ * @return 1 if the file is larger than max_file,
+ * @return -1 if it is no regular file or reading it failed
+ */
+int ServerContentCache::load(const std::string& path, const std::string& content_type, s_cached_content& content)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return -1;
+    struct stat buffer;
+    if (fstat(fd, &buffer) == -1 || !S_ISREG(buffer.st_mode))
+    {
+        close(fd);
+        return -1;
+    }
+    if (static_cast<uint64_t>(buffer.st_size) > max_file_)
+    {
+        close(fd);
+        return 1;
+    }
+    content.body.resize(buffer.st_size);
+    size_t done = 0;
+    while (done < content.body.size())
+    {
+        ssize_t bytes_read = read(fd, &content.body[done], content.body.size() - done);
+        if (bytes_read < 0 && errno == EINTR)
+            continue;
+        if (bytes_read <= 0)
+        {
+            close(fd);
+            return -1;
+        }
+        done += bytes_read;
+    }
+    close(fd);
+    content.headers = "Content-Type: " + content_type + "\r\n";
+    content.headers += "Content-Length: " + std::to_string(content.body.size()) + "\r\n\r\n";
+    return 0;
+}
+
+/**
+ * @brief watches a directory once, called with the lock held.
+ * A directory looked up by another name gets the same watch descriptor, the name is added to it
+ *
+ * @param dir the directory relative to the working directory
+ * @return true if the directory is watched,
+ * @return false if inotify_add_watch() failed, the files of it are not cached then
+ */
+bool ServerContentCache::watch(const std::string& dir)
+{
+    if (watched_dirs_.find(dir) != watched_dirs_.end())
+        return true;
+    int wd = inotify_add_watch(fd_, dir.c_str(), CONTENT_CACHE_WATCH);
+    if (wd == -1)
+        return false;
+    watches_[wd].push_back(dir);
+    watched_dirs_.emplace(dir, wd);
+    return true;
+}
+
+/**
+ * @brief keeps a file as the most recently used one, the least recently used ones go until it fits
+ *
+ * @param path the path of the file
+ * @param content the file, nullptr to remember it is too large
+ * @param bytes what the entry counts against size
+ */
+void ServerContentCache::store(const std::string& path, std::shared_ptr<const s_cached_content> content, uint64_t bytes)
+{
+    if (bytes > size_)
+        return;
+    drop(path);
+    lru_.push_front(s_entry{path, std::move(content), bytes});
+    entries_.emplace(path, lru_.begin());
+    used_ += bytes;
+    while (used_ > size_)
+    {
+        used_ -= lru_.back().bytes;
+        entries_.erase(lru_.back().path);
+        lru_.pop_back();
+    }
+}
+
+/**
+ * @brief drops the entry of a file, responses that are sending it keep their copy
+ *
+ * @param path the path of the file
+ */
+void ServerContentCache::drop(const std::string& path)
+{
+    std::unordered_map<std::string, std::list<s_entry>::iterator>::iterator it = entries_.find(path);
+    if (it == entries_.end())
+        return;
+    used_ -= it->second->bytes;
+    lru_.erase(it->second);
+    entries_.erase(it);
+}
+
+/**
+ * @brief forgets a watched directory that is gone and drops every file under it
+ *
+ * @param wd the watch descriptor of the directory
+ * @param remove_watch true if the kernel still has the watch, a moved directory keeps it
+ */
+void ServerContentCache::dropDirectory(int wd, bool remove_watch)
+{
+    std::unordered_map<int, std::vector<std::string>>::iterator it = watches_.find(wd);
+    if (it == watches_.end())
+        return;
+    for (const std::string& dir : it->second)
+    {
+        std::string prefix = dir + "/";
+        for (std::list<s_entry>::iterator entry = lru_.begin(); entry != lru_.end();)
+        {
+            std::list<s_entry>::iterator next = std::next(entry);
+            if (entry->path.compare(0, prefix.size(), prefix) == 0)
+                drop(entry->path);
+            entry = next;
+        }
+        watched_dirs_.erase(dir);
+    }
+    watches_.erase(it);
+    if (remove_watch)
+        inotify_rm_watch(fd_, wd);
+}
+
+/**
+ * @brief drops every file, the directories stay watched
+ */
+void ServerContentCache::clear()
+{
+    lru_.clear();
+    entries_.clear();
+    used_ = 0;
+}
@@ -0,0 +1,208 @@
+#include "server/ServerCoroutine.hpp"
+#include <iostream>
+#include <exception>
+#include <new>
+#include <sys/epoll.h>
+
+thread_local std::vector<void*> ServerFramePool::free_[FRAME_POOL_CLASSES];
+
+/**
+ * @brief takes a frame of the size class of the coroutine from the free list of the worker
+ *
+ * @param size the frame size the compiler asks for
+ * @return the frame
+ */
+void* ServerFramePool::allocate(size_t size)
+{
+    size_t index = sizeClass(size);
+    if (index == FRAME_POOL_CLASSES)
+        return ::operator new(size);
+    std::vector<void*>& free_list = free_[index];
+    if (free_list.empty())
+        return ::operator new(static_cast<size_t>(FRAME_POOL_MIN) << index);
+    void* frame = free_list.back();
+    free_list.pop_back();
+    return frame;
+}
+
+/**
+ * @brief puts a frame back on the free list of the worker, past FRAME_POOL_KEEP it is freed
+ *
+ * @param frame the frame of a destroyed coroutine
+ * @param size the size it was allocated with
+ */
+void ServerFramePool::release(void* frame, size_t size)
+{
+    size_t index = sizeClass(size);
+    if (index == FRAME_POOL_CLASSES || free_[index].size() >= FRAME_POOL_KEEP)
+    {
+        ::operator delete(frame);
+        return;
+    }
+    free_[index].push_back(frame);
+}
+
+/**
+ * @return the index of the smallest class that fits the size, FRAME_POOL_CLASSES if none does
+ */
+size_t ServerFramePool::sizeClass(size_t size)
+{
+    size_t index = 0;
+    while (index < FRAME_POOL_CLASSES && (static_cast<size_t>(FRAME_POOL_MIN) << index) < size)
+        ++index;
+    return index;
+}
+
+ServerTask ServerTask::promise_type::get_return_object()
+{
+    return ServerTask(std::coroutine_handle<promise_type>::from_promise(*this));
+}
+
+/**
+ * @brief a coroutine ends on a exception it did not catch, the response it was building is left as it is
+ */
+void ServerTask::promise_type::unhandled_exception()
+{
+    try
+    {
+        throw;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "coroutine stopped: " << e.what() << "\n";
+    }
+    catch (...)
+    {
+        std::cerr << "coroutine stopped with a unknown exception\n";
+    }
+}
+
+ServerTask::ServerTask() : handle_(nullptr) {}
+
+ServerTask::ServerTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+ServerTask::~ServerTask()
+{
+    if (handle_)
+        handle_.destroy();
+}
+
+ServerTask::ServerTask(ServerTask&& other) noexcept : handle_(other.handle_)
+{
+    other.handle_ = nullptr;
+}
+
+ServerTask& ServerTask::operator=(ServerTask&& other) noexcept
+{
+    if (this == &other)
+        return *this;
+    if (handle_)
+        handle_.destroy();
+    handle_ = other.handle_;
+    other.handle_ = nullptr;
+    return *this;
+}
+
+/**
+ * @return true while the coroutine is suspended and has not returned yet
+ */
+bool ServerTask::active() const
+{
+    return handle_ && !handle_.done();
+}
+
+/**
+ * @param scheduler the event loop of the worker
+ * @param owner_fd the client the coroutine answers, it is picked up again when the coroutine returns
+ * @param fd the fd to wait for
+ * @param events the epoll events to wait for
+ * @param timeout_ms milliseconds to wait at most, 0 to wait without a timeout
+ * @param other_fd a pipe that wakes the coroutine as well once it can be read, -1 for none
+ */
+ServerAwait::ServerAwait(ServerScheduler& scheduler, int owner_fd, int fd, uint32_t events, uint64_t timeout_ms, int other_fd)
+    : scheduler_(scheduler), owner_fd_(owner_fd), fd_(fd), other_fd_(other_fd), events_(events), timeout_ms_(timeout_ms), watching_(false), handle_(nullptr) {}
+
+ServerAwait::~ServerAwait()
+{
+    if (!watching_)
+        return;
+    scheduler_.unwatch(fd_);
+    if (other_fd_ != -1)
+        scheduler_.unwatch(other_fd_);
+}
+
+/**
+ * @brief hands the fd to the event loop and suspends the coroutine
+ *
+ * @param handle the suspended coroutine
+ * @return true when it waits,
+ * @return false if the fd could not be watched, the coroutine goes on with EPOLLERR
+ */
+bool ServerAwait::await_suspend(std::coroutine_handle<> handle)
+{
+    handle_ = handle;
+    if (scheduler_.watch(owner_fd_, fd_, events_, timeout_ms_, this) != 0)
+    {
+        events_ = EPOLLERR;
+        return false;
+    }
+    if (other_fd_ != -1 && scheduler_.watch(owner_fd_, other_fd_, EPOLLIN, 0, this) != 0)
+    {
+        scheduler_.unwatch(fd_);
+        events_ = EPOLLERR;
+        return false;
+    }
+    watching_ = true;
+    return true;
+}
+
+/**
+ * @brief resumes the coroutine, the event loop stopped watching the fd that woke it up before
+ *
+ * @param fd the fd that woke it up
+ * @param events the events of the fd, 0 if the timeout passed
+ */
+void ServerAwait::wake(int fd, uint32_t events)
+{
+    watching_ = false;
+    if (other_fd_ != -1)
+        scheduler_.unwatch(fd == fd_ ? other_fd_ : fd_);
+    events_ = events;
+    handle_.resume();
+}
+
+/**
+ * @param scheduler the event loop of the worker
+ * @param owner_fd the client the coroutine answers, it is picked up again when the coroutine returns
+ * @param work the blocking work, it runs on a aio thread
+ */
+ServerAioAwait::ServerAioAwait(ServerScheduler& scheduler, int owner_fd, std::function<void()> work) : scheduler_(scheduler)
+{
+    job_.work = std::move(work);
+    job_.handle = nullptr;
+    job_.owner = owner_fd;
+    job_.pending = false;
+    job_.done = nullptr;
+}
+
+ServerAioAwait::~ServerAioAwait()
+{
+    if (job_.pending)
+        scheduler_.cancelOffload(&job_);
+}
+
+/**
+ * @brief hands the work to a aio thread and suspends the coroutine
+ *
+ * @param handle the suspended coroutine
+ * @return true when it waits,
+ * @return false when there are no aio threads, the work is done and the coroutine goes on
+ */
+bool ServerAioAwait::await_suspend(std::coroutine_handle<> handle)
+{
+    job_.handle = handle;
+    if (scheduler_.offload(&job_) == 0)
+        return true;
+    job_.work();
+    return false;
+}
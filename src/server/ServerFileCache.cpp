@@ -0,0 +1,173 @@
+#include "server/ServerFileCache.hpp"
+#include "server/ServerTimerWheel.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * @param max the number of paths kept at most
+ * @param inactive_ms how long a entry stays without being used
+ * @param valid_ms how long a entry is trusted before stat() checks it again
+ * @param errors true to cache paths that do not exist
+ */
+ServerFileCache::ServerFileCache(size_t max, uint64_t inactive_ms, uint64_t valid_ms, bool errors)
+    : max_(max), inactive_ms_(inactive_ms), valid_ms_(valid_ms), errors_(errors) {}
+
+ServerFileCache::~ServerFileCache() {};
+
+/**
+ * @brief looks up a path, a valid entry is returned without a system call,
+ * a missing or outdated one is loaded from the file system and stored
+ *
+ * @param path the path relative to the working directory, the way stat() gets it
+ * @return what is known about the path
+ */
+s_file_info ServerFileCache::lookup(const std::string& path)
+{
+    uint64_t now = ServerTimerWheel::nowMs();
+    s_file_info previous{};
+    bool cached = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        expire(now);
+        std::unordered_map<std::string, std::list<s_entry>::iterator>::iterator it = entries_.find(path);
+        if (it != entries_.end())
+        {
+            s_entry& entry = *it->second;
+            entry.used_at = now;
+            lru_.splice(lru_.begin(), lru_, it->second);
+            if (entry.checked_at + valid_ms_ > now) // another thread can have stored a later time than now
+                return entry.info;
+            previous = entry.info;
+            cached = true;
+        }
+    }
+    // the file system is checked without the lock, the other threads keep using the cache meanwhile
+    s_file_info info = load(path, cached ? &previous : nullptr);
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (info.found || errors_)
+        store(path, info, now);
+    else
+        drop(path);
+    return info;
+}
+
+/**
+ * @brief keeps the headers a response built for a file, unless the entry changed meanwhile
+ *
+ * @param path the path of the file
+ * @param info what lookup() returned for the path
+ * @param headers the Content-Type and Content-Length lines
+ */
+void ServerFileCache::setHeaders(const std::string& path, const s_file_info& info, const std::string& headers)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::unordered_map<std::string, std::list<s_entry>::iterator>::iterator it = entries_.find(path);
+    if (it != entries_.end() && it->second->info.file == info.file && it->second->info.mtime == info.mtime)
+        it->second->info.headers = headers;
+}
+
+/**
+ * @brief drops the entry of a path that the server changed itself, like a deleted file.
+ * Responses that hold its fd still finish sending it
+ *
+ * @param path the path
+ */
+void ServerFileCache::forget(const std::string& path)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    drop(path);
+}
+
+/**
+ * @brief stat()s a path and opens it if it is a regular file.
+ * A file that did not change since the previous lookup keeps its fd and headers
+ *
+ * @param path the path relative to the working directory
+ * @param previous what was cached before, nullptr if nothing
+ * @return what is known about the path, found is false when stat() failed
+ */
+s_file_info ServerFileCache::load(const std::string& path, const s_file_info* previous)
+{
+    s_file_info info{};
+    struct stat buffer;
+    if (stat(path.c_str(), &buffer) == -1)
+        return info;
+    info.found = true;
+    info.mode = buffer.st_mode;
+    info.size = buffer.st_size;
+    info.mtime = buffer.st_mtime;
+    info.inode = buffer.st_ino;
+    info.device = buffer.st_dev;
+    if (previous != nullptr && previous->found && previous->inode == info.inode && previous->device == info.device
+        && previous->mtime == info.mtime && previous->size == info.size && previous->mode == info.mode)
+        return *previous;
+    if (!S_ISREG(info.mode))
+        return info;
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd != -1)
+        info.file = std::make_shared<s_file_fd>(fd);
+    return info;
+}
+
+// private functions
+
+/**
+ * @brief adds or replaces the entry of a path as the most recently used one,
+ * the least recently used one is dropped when there are more than max
+ *
+ * @param path the path
+ * @param info what is known about it
+ * @param now the time of the lookup
+ */
+void ServerFileCache::store(const std::string& path, const s_file_info& info, uint64_t now)
+{
+    std::unordered_map<std::string, std::list<s_entry>::iterator>::iterator it = entries_.find(path);
+    if (it != entries_.end())
+    {
+        it->second->info = info;
+        it->second->checked_at = now;
+        it->second->used_at = now;
+        lru_.splice(lru_.begin(), lru_, it->second);
+        return;
+    }
+    lru_.push_front(s_entry{path, info, now, now});
+    entries_.emplace(path, lru_.begin());
+    while (lru_.size() > max_)
+    {
+        entries_.erase(lru_.back().path);
+        lru_.pop_back();
+    }
+}
+
+/**
+ * @brief drops the entry of a path, called with the lock held
+ *
+ * @param path the path
+ */
+void ServerFileCache::drop(const std::string& path)
+{
+    std::unordered_map<std::string, std::list<s_entry>::iterator>::iterator it = entries_.find(path);
+    if (it == entries_.end())
+        return;
+    lru_.erase(it->second);
+    entries_.erase(it);
+}
+
+/**
+ * @brief drops up to two entries from the end of the LRU that were not used for inactive_ms,
+ * a few per lookup keeps the cost of a lookup fixed
+ *
+ * @param now the time of the lookup
+ */
+void ServerFileCache::expire(uint64_t now)
+{
+    for (int i = 0; i < 2 && !lru_.empty(); ++i)
+    {
+        s_entry& oldest = lru_.back();
+        if (oldest.used_at + inactive_ms_ > now) // used_at can be later than now, it is read before the lock
+            return;
+        entries_.erase(oldest.path);
+        lru_.pop_back();
+    }
+}
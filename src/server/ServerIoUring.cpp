@@ -0,0 +1,616 @@
+#include "server/ServerIoUring.hpp"
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <signal.h>
+#include <cstring>
+#include <errno.h>
+#include <iostream>
+#ifdef HAVE_IO_URING
+# include <linux/io_uring.h>
+#endif
+
+#define URING_KIND_INTERNAL 0ULL // completions of removals, nothing to report
+#define URING_KIND_POLL 1ULL
+#define URING_KIND_ACCEPT 2ULL
+#define URING_GEN_MASK 0x3fffffffU
+
+ServerIoUring::ServerIoUring() : ring_fd_(-1), sq_entries_(0), sq_ptr_(MAP_FAILED), sq_size_(0), cq_ptr_(MAP_FAILED), cq_size_(0),
+    sqes_(nullptr), sqes_size_(0), sq_head_(nullptr), sq_tail_(nullptr), sq_mask_(nullptr), sq_array_(nullptr),
+    cq_head_(nullptr), cq_tail_(nullptr), cq_mask_(nullptr), cqes_(nullptr), sq_local_tail_(0), to_submit_(0), batch_(0), fixed_listeners_(false), accept_by_poll_(false) {};
+
+ServerIoUring::~ServerIoUring()
+{
+    teardown();
+};
+
+/**
+ * @return true if the ring is set up and used instead of epoll
+ */
+bool ServerIoUring::active() const
+{
+    return ring_fd_ != -1;
+}
+
+/**
+ * @return the clients accepted by the multishot accepts during the last wait(), as (listener fd, client fd)
+ */
+const std::vector<std::pair<int, int>>& ServerIoUring::accepted() const
+{
+    return accepted_;
+}
+
+#ifdef HAVE_IO_URING
+
+/**
+ * @brief creates the ring and maps the submission and completion queues.
+ * The kernel needs to support waiting with a timeout (5.11) and must not drop completions
+ * 
+ * @return 0 when done,
+ * @return -1 if io_uring is not available, the caller falls back to epoll
+ */
+int ServerIoUring::setup()
+{
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE;
+    params.cq_entries = URING_ENTRIES * 4;
+    ring_fd_ = syscall(__NR_io_uring_setup, URING_ENTRIES, &params);
+    if (ring_fd_ < 0)
+    {
+        ring_fd_ = -1;
+        std::cerr << "io_uring_setup failed: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP))
+    {
+        std::cerr << "io_uring of this kernel is too old\n";
+        teardown();
+        return -1;
+    }
+    sq_entries_ = params.sq_entries;
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+    {
+        if (cq_size_ > sq_size_)
+            sq_size_ = cq_size_;
+        cq_size_ = sq_size_;
+    }
+    sq_ptr_ = mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ptr_ == MAP_FAILED)
+    {
+        std::cerr << "mmap of io_uring submission queue failed\n";
+        teardown();
+        return -1;
+    }
+    if (single_mmap)
+        cq_ptr_ = sq_ptr_;
+    else
+    {
+        cq_ptr_ = mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED)
+        {
+            std::cerr << "mmap of io_uring completion queue failed\n";
+            teardown();
+            return -1;
+        }
+    }
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        std::cerr << "mmap of io_uring submission entries failed\n";
+        teardown();
+        return -1;
+    }
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ptr_);
+    char* cq = static_cast<char*>(cq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    sq_local_tail_ = *sq_tail_;
+    return 0;
+}
+
+/**
+ * @brief does what epoll_ctl() would do, as multishot poll requests.
+ * A changed interest removes the old poll and arms a new one, both are send with the next wait()
+ * 
+ * @param mode EPOLL_CTL_ADD, EPOLL_CTL_MOD or EPOLL_CTL_DEL
+ * @param fd the file descriptor the action is taken on
+ * @param event the new events for the fd (unused for EPOLL_CTL_DEL)
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::control(int mode, int fd, epoll_event* event)
+{
+    if (fd < 0)
+        return -1;
+    if (entry(fd).armed && removePoll(fd) != 0)
+        return -1;
+    if (mode == EPOLL_CTL_DEL)
+        return 0;
+    return armPoll(fd, event->events);
+}
+
+/**
+ * @brief registers the listening sockets with the ring and starts a multishot accept on each
+ * 
+ * @param listener_fds the listening sockets of the worker
+ * @return 0 when done,
+ * @return -1 on error
+ */
+int ServerIoUring::addListeners(const std::vector<int>& listener_fds)
+{
+    listeners_ = listener_fds;
+    accepting_.assign(listeners_.size(), false);
+    listener_slots_.assign(listeners_.size(), -1);
+    fixed_listeners_ = syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES, listeners_.data(), listeners_.size()) == 0;
+    if (!fixed_listeners_)
+        std::cerr << "registering listeners with io_uring failed, using plain fds\n";
+    for (size_t i = 0; fixed_listeners_ && i < listeners_.size(); ++i)
+        listener_slots_[i] = i;
+    for (int fd : listeners_)
+    {
+        if (startAccept(fd) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief adds a listening socket of a new config generation and starts accepting on it
+ * 
+ * @param listener_fd the listening socket
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::addListener(int listener_fd)
+{
+    listeners_.push_back(listener_fd);
+    listener_slots_.push_back(-1);
+    accepting_.push_back(false);
+    return startAccept(listener_fd);
+}
+
+/**
+ * @brief stops accepting on a listener that is not in the config anymore.
+ * A registered listener is dropped from the registered files, otherwise the ring keeps the socket open
+ * 
+ * @param listener_fd the listening socket
+ */
+void ServerIoUring::removeListener(int listener_fd)
+{
+    size_t index = listenerIndex(listener_fd);
+    if (index == listeners_.size())
+        return;
+    stopAccept(listener_fd);
+    if (listener_slots_[index] != -1)
+    {
+        int none = -1;
+        io_uring_files_update update;
+        std::memset(&update, 0, sizeof(update));
+        update.offset = listener_slots_[index];
+        update.fds = reinterpret_cast<uint64_t>(&none);
+        if (syscall(__NR_io_uring_register, ring_fd_, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0)
+            std::cerr << "removing listener " << listener_fd << " from the registered files failed\n";
+    }
+    listeners_.erase(listeners_.begin() + index);
+    listener_slots_.erase(listener_slots_.begin() + index);
+    accepting_.erase(accepting_.begin() + index);
+}
+
+/**
+ * @brief (re)starts accepting clients on a listener
+ * 
+ * @param listener_fd the listening socket
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::startAccept(int listener_fd)
+{
+    size_t index = listenerIndex(listener_fd);
+    if (index == listeners_.size() || accepting_[index])
+        return 0;
+    int nr = accept_by_poll_ ? armPoll(listener_fd, EPOLLIN) : armAccept(listener_fd);
+    if (nr == 0)
+        accepting_[index] = true;
+    return nr;
+}
+
+/**
+ * @brief stops accepting clients on a listener, clients that are already accepted are still reported
+ * 
+ * @param listener_fd the listening socket
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::stopAccept(int listener_fd)
+{
+    size_t index = listenerIndex(listener_fd);
+    if (index == listeners_.size() || !accepting_[index])
+        return 0;
+    if (accept_by_poll_)
+    {
+        if (removePoll(listener_fd) != 0)
+            return -1;
+        accepting_[index] = false;
+        return 0;
+    }
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = userData(URING_KIND_ACCEPT, 0, listener_fd);
+    sqe->user_data = userData(URING_KIND_INTERNAL, 0, listener_fd);
+    pushSqe();
+    accepting_[index] = false;
+    return 0;
+}
+
+/**
+ * @brief sends the queued requests to the kernel and waits for completions,
+ * poll completions are written to events like epoll_wait() does and accepted clients are stored
+ * 
+ * @param events the array that will hold the ready fds
+ * @param max_events the size of events
+ * @param timeout_ms max time to wait in milliseconds, -1 waits until a completion arrives
+ * @return the amount of events,
+ * @return -1 on error
+ */
+int ServerIoUring::wait(epoll_event events[], int max_events, int timeout_ms)
+{
+    accepted_.clear();
+    if (*cq_head_ == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE))
+    {
+        if (timeout_ms == 0 && to_submit_ == 0) // a spinning poll only looks at the shared completion queue
+            return 0;
+        if (enter(1, timeout_ms) != 0)
+            return -1;
+    }
+    else if (to_submit_ > 0 && enter(0, 0) != 0)
+        return -1;
+
+    ++batch_;
+    int count = 0;
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    while (head != tail && count < max_events)
+    {
+        handleCompletion(cqes_[head & *cq_mask_], events, count);
+        ++head;
+    }
+    __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+    return count;
+}
+
+// private functions
+
+/**
+ * @brief unmaps the queues and closes the ring
+ * 
+ */
+void ServerIoUring::teardown()
+{
+    if (sqes_ != nullptr)
+        munmap(sqes_, sqes_size_);
+    if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_)
+        munmap(cq_ptr_, cq_size_);
+    if (sq_ptr_ != MAP_FAILED)
+        munmap(sq_ptr_, sq_size_);
+    if (ring_fd_ != -1)
+        close(ring_fd_);
+    sqes_ = nullptr;
+    cq_ptr_ = MAP_FAILED;
+    sq_ptr_ = MAP_FAILED;
+    ring_fd_ = -1;
+}
+
+/**
+ * @brief gets the next free submission entry, when the queue is full the queued entries are submitted first.
+ * The entry is handed to the kernel after pushSqe()
+ * 
+ * @return the cleared entry,
+ * @return nullptr if the queue stays full
+ */
+io_uring_sqe* ServerIoUring::getSqe()
+{
+    if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+    {
+        if (enter(0, 0) != 0 || sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_)
+        {
+            std::cerr << "io_uring submission queue is full\n";
+            return nullptr;
+        }
+    }
+    unsigned index = sq_local_tail_ & *sq_mask_;
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    return sqe;
+}
+
+/**
+ * @brief publishes the entry from getSqe() so the next io_uring_enter() submits it
+ * 
+ */
+void ServerIoUring::pushSqe()
+{
+    ++sq_local_tail_;
+    ++to_submit_;
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief submits the queued entries and optionally waits for completions
+ * 
+ * @param min_complete the amount of completions to wait for, 0 only submits
+ * @param timeout_ms max time to wait in milliseconds, -1 waits without limit
+ * @return 0 when done or on timeout,
+ * @return -1 on error
+ */
+int ServerIoUring::enter(unsigned min_complete, int timeout_ms)
+{
+    unsigned flags = 0;
+    io_uring_getevents_arg arg;
+    __kernel_timespec timeout;
+    std::memset(&arg, 0, sizeof(arg));
+    if (min_complete > 0)
+    {
+        flags = IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG;
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeout_ms >= 0)
+        {
+            timeout.tv_sec = timeout_ms / 1000;
+            timeout.tv_nsec = (timeout_ms % 1000) * 1000000L;
+            arg.ts = reinterpret_cast<uint64_t>(&timeout);
+        }
+    }
+    int submitted = syscall(__NR_io_uring_enter, ring_fd_, to_submit_, min_complete, flags, min_complete > 0 ? &arg : nullptr, sizeof(arg));
+    if (submitted < 0)
+    {
+        if (errno == ETIME || errno == EINTR || errno == EAGAIN || errno == EBUSY)
+            return 0;
+        std::cerr << "io_uring_enter failed: " << std::strerror(errno) << "\n";
+        return -1;
+    }
+    to_submit_ -= submitted;
+    return 0;
+}
+
+/**
+ * @brief queues a multishot poll for the fd, earlier completions of the fd are ignored from now on
+ * 
+ * @param fd the file descriptor to poll
+ * @param events the epoll events to poll for
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::armPoll(int fd, uint32_t events)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return -1;
+    s_uring_fd& poll = entry(fd);
+    poll.gen = (poll.gen + 1) & URING_GEN_MASK;
+    poll.events = events & (EPOLLIN | EPOLLOUT | EPOLLPRI | EPOLLRDHUP | EPOLLERR | EPOLLHUP);
+    poll.armed = true;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = poll.events;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = userData(URING_KIND_POLL, poll.gen, fd);
+    pushSqe();
+    return 0;
+}
+
+/**
+ * @brief queues the removal of the poll of the fd
+ * 
+ * @param fd the file descriptor whose poll is removed
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::removePoll(int fd)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return -1;
+    s_uring_fd& poll = entry(fd);
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = userData(URING_KIND_POLL, poll.gen, fd);
+    sqe->user_data = userData(URING_KIND_INTERNAL, 0, fd);
+    poll.gen = (poll.gen + 1) & URING_GEN_MASK;
+    poll.armed = false;
+    pushSqe();
+    return 0;
+}
+
+/**
+ * @brief queues a multishot accept on a listener, each accepted client gives one completion
+ * 
+ * @param listener_fd the listening socket
+ * @return 0 when done,
+ * @return -1 if the submission queue is full
+ */
+int ServerIoUring::armAccept(int listener_fd)
+{
+    io_uring_sqe* sqe = getSqe();
+    if (sqe == nullptr)
+        return -1;
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listener_fd;
+    int slot = listener_slots_[listenerIndex(listener_fd)];
+    if (slot != -1)
+    {
+        sqe->fd = slot;
+        sqe->flags = IOSQE_FIXED_FILE;
+    }
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = userData(URING_KIND_ACCEPT, 0, listener_fd);
+    pushSqe();
+    return 0;
+}
+
+/**
+ * @brief turns one completion into a epoll event or a accepted client.
+ * Completions of removed polls are dropped, polls and accepts the kernel ended are armed again.
+ * Multiple completions for one fd in the same wait are merged into one event
+ * 
+ * @param cqe the completion
+ * @param events the array with the events of this wait
+ * @param count the amount of events in the array
+ */
+void ServerIoUring::handleCompletion(const io_uring_cqe& cqe, epoll_event events[], int& count)
+{
+    uint64_t kind = cqe.user_data >> 62;
+    uint32_t gen = (cqe.user_data >> 32) & URING_GEN_MASK;
+    int fd = static_cast<int>(static_cast<uint32_t>(cqe.user_data));
+    bool more = cqe.flags & IORING_CQE_F_MORE;
+
+    if (kind == URING_KIND_ACCEPT)
+    {
+        size_t index = listenerIndex(fd);
+        if (index == listeners_.size())
+        {
+            if (cqe.res >= 0) // accepted just before the listener was removed, the server closes it
+                accepted_.push_back({fd, cqe.res});
+            return;
+        }
+        bool out_of_fds = cqe.res == -EMFILE || cqe.res == -ENFILE;
+        if (cqe.res >= 0 || out_of_fds)
+            accepted_.push_back({fd, cqe.res});
+        else if (cqe.res == -EINVAL && !more && accepting_[index])
+        {
+            // kernel without multishot accept, report the listener as readable instead
+            std::cerr << "multishot accept not supported, polling listener " << fd << "\n";
+            accept_by_poll_ = true;
+            armPoll(fd, EPOLLIN);
+            return;
+        }
+        else if (cqe.res != -ECANCELED)
+            std::cerr << "io_uring accept error: " << std::strerror(-cqe.res) << "\n";
+        if (!more && accepting_[index] && !out_of_fds && cqe.res != -ECANCELED)
+            armAccept(fd);
+        else if (!more)
+            accepting_[index] = false; // the server starts it again when it has room
+        return;
+    }
+    if (kind != URING_KIND_POLL)
+        return;
+    s_uring_fd& poll = entry(fd);
+    if (!poll.armed || poll.gen != gen)
+        return;
+    uint32_t ready = cqe.res < 0 ? static_cast<uint32_t>(EPOLLERR) : static_cast<uint32_t>(cqe.res);
+    if (!more && cqe.res >= 0)
+        armPoll(fd, poll.events);
+    else if (!more)
+        poll.armed = false;
+    if (poll.batch == batch_)
+    {
+        events[poll.slot].events |= ready;
+        return;
+    }
+    poll.batch = batch_;
+    poll.slot = count;
+    events[count].events = ready;
+    events[count].data.fd = fd;
+    ++count;
+}
+
+/**
+ * @brief gets the poll state of a fd, the table grows with the highest fd
+ * 
+ * @param fd the file descriptor
+ * @return the poll state of the fd
+ */
+ServerIoUring::s_uring_fd& ServerIoUring::entry(int fd)
+{
+    if (static_cast<size_t>(fd) >= fds_.size())
+        fds_.resize(fd + 1 > 64 ? (fd + 1) * 2 : 64);
+    return fds_[fd];
+}
+
+/**
+ * @param listener_fd the listening socket
+ * @return the index of the listener, the amount of listeners if it is unknown
+ */
+size_t ServerIoUring::listenerIndex(int listener_fd) const
+{
+    for (size_t i = 0; i < listeners_.size(); ++i)
+    {
+        if (listeners_[i] == listener_fd)
+            return i;
+    }
+    return listeners_.size();
+}
+
+/**
+ * @brief packs what a completion belongs to in its user data
+ * 
+ * @param kind URING_KIND_POLL, URING_KIND_ACCEPT or URING_KIND_INTERNAL
+ * @param gen the generation of the poll, so completions of a removed poll can be recognized
+ * @param fd the file descriptor
+ * @return the user data
+ */
+uint64_t ServerIoUring::userData(uint64_t kind, uint32_t gen, int fd)
+{
+    return (kind << 62) | (static_cast<uint64_t>(gen & URING_GEN_MASK) << 32) | static_cast<uint32_t>(fd);
+}
+
+#else
+
+int ServerIoUring::setup()
+{
+    std::cerr << "webserv is build without io_uring support\n";
+    return -1;
+}
+
+int ServerIoUring::control(int, int, epoll_event*)
+{
+    return -1;
+}
+
+int ServerIoUring::addListeners(const std::vector<int>&)
+{
+    return -1;
+}
+
+int ServerIoUring::addListener(int)
+{
+    return -1;
+}
+
+void ServerIoUring::removeListener(int) {}
+
+int ServerIoUring::startAccept(int)
+{
+    return -1;
+}
+
+int ServerIoUring::stopAccept(int)
+{
+    return -1;
+}
+
+int ServerIoUring::wait(epoll_event[], int, int)
+{
+    return -1;
+}
+
+void ServerIoUring::teardown() {}
+
+#endif
@@ -0,0 +1,150 @@
+#include "server/ServerListenFds.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/un.h>
+
+/**
+ * @brief takes over the sockets of LISTEN_FDS when LISTEN_PID is this process.
+ * The variables are removed so CGI scripts do not see them
+ */
+ServerListenFds::ServerListenFds()
+{
+    const char* pid = std::getenv("LISTEN_PID");
+    const char* count = std::getenv("LISTEN_FDS");
+    if (pid != nullptr && count != nullptr && std::strtol(pid, nullptr, 10) == getpid())
+    {
+        long fds = std::strtol(count, nullptr, 10);
+        for (long i = 0; i < fds; ++i)
+            inherit(LISTEN_FDS_START + static_cast<int>(i));
+    }
+    unsetenv("LISTEN_PID");
+    unsetenv("LISTEN_FDS");
+    unsetenv("LISTEN_FDNAMES");
+}
+
+ServerListenFds::~ServerListenFds() {};
+
+/**
+ * @brief finds the inherited socket for a listener, a socket no worker uses yet comes first
+ *
+ * @param address the address the listener binds to
+ * @param port the port of the listener
+ * @return the file descriptor of the socket,
+ * @return -1 if no inherited socket has this address and port
+ */
+int ServerListenFds::take(const std::string& address, uint16_t port)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    s_listen_fd* shared = nullptr;
+    for (s_listen_fd& listen_fd : fds_)
+    {
+        if (listen_fd.address != address || listen_fd.port != port)
+            continue;
+        if (listen_fd.users == 0)
+        {
+            listen_fd.users = 1;
+            return listen_fd.fd;
+        }
+        if (shared == nullptr || listen_fd.users < shared->users)
+            shared = &listen_fd;
+    }
+    if (shared == nullptr)
+        return -1;
+    ++shared->users;
+    return shared->fd;
+}
+
+/**
+ * @brief adds a socket a worker created, the workers that come after it take it instead of binding again
+ *
+ * @param fd the listening socket
+ * @param address the address it is bound to
+ * @param port the port it is bound to
+ */
+void ServerListenFds::share(int fd, const std::string& address, uint16_t port)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    s_listen_fd listen_fd;
+    listen_fd.fd = fd;
+    listen_fd.address = address;
+    listen_fd.port = port;
+    listen_fd.users = 1;
+    fds_.push_back(listen_fd);
+}
+
+/**
+ * @return every socket held, in the order they were inherited or shared
+ */
+std::vector<int> ServerListenFds::fds()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<int> fds;
+    for (const s_listen_fd& listen_fd : fds_)
+        fds.push_back(listen_fd.fd);
+    return fds;
+}
+
+// private functions
+
+/**
+ * @brief checks that a inherited fd is a listening stream socket and reads its address.
+ * A IPv6 socket on every address counts as "0.0.0.0", it takes IPv4 clients too.
+ * Other fds are logged and left alone
+ *
+ * @param fd the inherited file descriptor
+ */
+void ServerListenFds::inherit(int fd)
+{
+    int type = 0;
+    int listening = 0;
+    socklen_t len = sizeof(type);
+    if (getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len) < 0 || type != SOCK_STREAM)
+    {
+        std::cerr << "inherited fd " << fd << " is not a stream socket, ignoring it\n";
+        return;
+    }
+    len = sizeof(listening);
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) < 0 || !listening)
+    {
+        std::cerr << "inherited fd " << fd << " is not listening, ignoring it\n";
+        return;
+    }
+    sockaddr_storage addr{};
+    len = sizeof(addr);
+    if (getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) < 0)
+        return;
+    s_listen_fd listen_fd;
+    listen_fd.fd = fd;
+    listen_fd.users = 0;
+    if (addr.ss_family == AF_INET)
+    {
+        sockaddr_in* in = reinterpret_cast<sockaddr_in*>(&addr);
+        char address[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &in->sin_addr, address, sizeof(address));
+        listen_fd.address = address;
+        listen_fd.port = ntohs(in->sin_port);
+    }
+    else if (addr.ss_family == AF_INET6 && IN6_IS_ADDR_UNSPECIFIED(&reinterpret_cast<sockaddr_in6*>(&addr)->sin6_addr))
+    {
+        listen_fd.address = "0.0.0.0";
+        listen_fd.port = ntohs(reinterpret_cast<sockaddr_in6*>(&addr)->sin6_port);
+    }
+    else if (addr.ss_family == AF_UNIX && len > offsetof(sockaddr_un, sun_path) && reinterpret_cast<sockaddr_un*>(&addr)->sun_path[0] != '\0')
+    {
+        listen_fd.address = std::string("unix:") + reinterpret_cast<sockaddr_un*>(&addr)->sun_path;
+        listen_fd.port = 0;
+    }
+    else
+    {
+        std::cerr << "inherited fd " << fd << " has a address family that is not supported, ignoring it\n";
+        return;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fds_.push_back(listen_fd);
+    std::cerr << "inherited listening socket " << listen_fd.address << ":" << listen_fd.port << " on fd " << fd << "\n";
+}
@@ -0,0 +1,347 @@
+#include "server/ServerMaster.hpp"
+#include "server/ServerWorkerPool.hpp"
+#include "server/ServerTimerWheel.hpp"
+#include "Server.hpp"
+#include <iostream>
+#include <algorithm>
+#include <new>
+#include <cerrno>
+#include <unistd.h>
+#include <signal.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+
+/**
+ * @param configs the server blocks loaded at the start
+ * @param config_path the config file given at the start, nullptr for the default file
+ * @param listen_fds the sockets inherited with socket activation, the master adds the ones it makes
+ */
+ServerMaster::ServerMaster(std::vector<std::shared_ptr<Config>>& configs, const char* config_path, ServerListenFds& listen_fds)
+    : config_path_(config_path), listen_fds_(listen_fds), reload_(config_path, configs), upgrade_(config_path, configs[0]->getWorkerProcesses())
+{
+    size_t count = configs[0]->getWorkerProcesses();
+    workers_.resize(count, s_worker_process{-1, 0, 0});
+    void* shared = mmap(nullptr, count * sizeof(s_worker_counters), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED)
+        throw std::runtime_error("failed to map the worker counters");
+    counters_ = static_cast<s_worker_counters*>(shared);
+    for (size_t i = 0; i < count; ++i)
+        new (&counters_[i]) s_worker_counters{};
+    pid_ = getpid();
+    signal_fd_ = -1;
+    upgrade_fd_ = -1;
+    stopping_ = false;
+    restarts_ = 0;
+}
+
+ServerMaster::~ServerMaster()
+{
+    munmap(counters_, workers_.size() * sizeof(s_worker_counters));
+    if (signal_fd_ != -1)
+        close(signal_fd_);
+    if (upgrade_fd_ != -1)
+        close(upgrade_fd_);
+}
+
+/**
+ * @brief makes the listening sockets, starts the worker processes and supervises them until it is stopped
+ *
+ * @return 0 when every worker process is stopped,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int ServerMaster::run()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    for (int signo : {SIGHUP, SIGUSR1, SIGUSR2, SIGQUIT, SIGTERM, SIGINT, SIGCHLD})
+        sigaddset(&signals, signo);
+    sigprocmask(SIG_BLOCK, &signals, nullptr);
+    signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd_ == -1)
+    {
+        std::cerr << "creating the signalfd of the master failed\n";
+        return -2;
+    }
+    openListeners();
+    upgrade_.notifyReady(); // before the fork, so no worker process holds the pipe of the old process
+    for (size_t i = 0; i < workers_.size(); ++i)
+        startWorker(i);
+    while (!stopping_ || running())
+    {
+        pollfd fds[2] = {{signal_fd_, POLLIN, 0}, {upgrade_fd_, POLLIN, 0}}; // poll skips a upgrade fd of -1
+        if (poll(fds, 2, restartTimeout()) == -1 && errno != EINTR)
+        {
+            std::cerr << "poll in the master failed\n";
+            signalWorkers(SIGTERM);
+            return -1;
+        }
+        if (fds[0].revents != 0)
+            handleSignal();
+        if (fds[1].revents != 0)
+            handleUpgrade();
+        restartWorkers();
+    }
+    std::cerr << "every worker process stopped, master exits\n";
+    return 0;
+}
+
+// private functions
+
+/**
+ * @brief makes the listening sockets of every server block once, the way a worker does,
+ * and shares them so every worker process takes them instead of binding its own
+ */
+void ServerMaster::openListeners()
+{
+    ServerAioPool aio(0);
+    Server listeners(reload_, listen_fds_, upgrade_, aio, counters_[0]);
+    listeners.shareListeners();
+}
+
+/**
+ * @brief forks a worker process, a fork that fails is tried again after WORKER_RESPAWN_MS
+ *
+ * @param index the number of the worker process
+ */
+void ServerMaster::startWorker(size_t index)
+{
+    s_worker_process& worker = workers_[index];
+    counters_[index].active.store(0, std::memory_order_relaxed);
+    uint64_t now = ServerTimerWheel::nowMs();
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        std::cerr << "starting worker process " << index << " failed\n";
+        worker.restart_at = now + WORKER_RESPAWN_MS;
+        return;
+    }
+    if (pid == 0)
+        _exit(runWorker(index));
+    worker.pid = pid;
+    worker.started_at = now;
+    std::cerr << "started worker process " << index << " as pid " << pid << "\n";
+}
+
+/**
+ * @brief the worker process after the fork: it runs a worker pool on the newest config generation
+ * and never returns to the caller of the master
+ *
+ * @param index the number of the worker process
+ * @return the exit status of the worker process
+ */
+int ServerMaster::runWorker(size_t index)
+{
+    close(signal_fd_);
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    if (getppid() != pid_) // the master died before the death signal was set
+        return 1;
+    signal(SIGUSR2, SIG_IGN); // the master does the upgrades
+    signal(SIGUSR1, SIG_IGN); // the master reports the counters, a signal to the whole group must not kill the workers
+    sigset_t signals;
+    sigemptyset(&signals);
+    for (int signo : {SIGTERM, SIGINT, SIGCHLD})
+        sigaddset(&signals, signo);
+    sigprocmask(SIG_UNBLOCK, &signals, nullptr);
+    try
+    {
+        std::vector<std::shared_ptr<Config>> configs = reload_.current()->configs;
+        ServerWorkerPool workers(configs, config_path_, listen_fds_, counters_[index], index * configs[0]->getWorkerThreads());
+        return -workers.run();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "worker process " << index << " failed: " << e.what() << "\n";
+        return 1;
+    }
+}
+
+/**
+ * @brief collects the worker processes that exited, unless the master stops they are started again.
+ * One that died within WORKER_RESPAWN_MS of its start waits for the rest of it,
+ * so a worker that crashes right away does not keep the master forking
+ */
+void ServerMaster::reapWorkers()
+{
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+    {
+        for (size_t i = 0; i < workers_.size(); ++i)
+        {
+            s_worker_process& worker = workers_[i];
+            if (worker.pid != pid)
+                continue;
+            worker.pid = -1;
+            counters_[i].active.store(0, std::memory_order_relaxed);
+            std::cerr << "worker process " << i << " pid " << pid;
+            if (WIFSIGNALED(status))
+                std::cerr << " killed by signal " << WTERMSIG(status);
+            else
+                std::cerr << " exited with " << WEXITSTATUS(status);
+            if (stopping_)
+            {
+                std::cerr << "\n";
+                break;
+            }
+            std::cerr << ", restarting it\n";
+            ++restarts_;
+            worker.restart_at = std::max(ServerTimerWheel::nowMs(), worker.started_at + WORKER_RESPAWN_MS);
+            break;
+        }
+    }
+}
+
+/**
+ * @brief starts the worker processes whose restart is due
+ */
+void ServerMaster::restartWorkers()
+{
+    if (stopping_)
+        return;
+    uint64_t now = ServerTimerWheel::nowMs();
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        if (workers_[i].pid == -1 && workers_[i].restart_at <= now)
+            startWorker(i);
+    }
+}
+
+/**
+ * @return the milliseconds until the next restart is due, -1 if none is waiting
+ */
+int ServerMaster::restartTimeout()
+{
+    if (stopping_)
+        return -1;
+    uint64_t now = ServerTimerWheel::nowMs();
+    int timeout = -1;
+    for (const s_worker_process& worker : workers_)
+    {
+        if (worker.pid != -1)
+            continue;
+        int wait = worker.restart_at > now ? static_cast<int>(worker.restart_at - now) : 0;
+        if (timeout == -1 || wait < timeout)
+            timeout = wait;
+    }
+    return timeout;
+}
+
+/**
+ * @return true while a worker process is running
+ */
+bool ServerMaster::running()
+{
+    for (const s_worker_process& worker : workers_)
+    {
+        if (worker.pid != -1)
+            return true;
+    }
+    return false;
+}
+
+/**
+ * @param signo the signal every running worker process gets
+ */
+void ServerMaster::signalWorkers(int signo)
+{
+    for (const s_worker_process& worker : workers_)
+    {
+        if (worker.pid != -1)
+            kill(worker.pid, signo);
+    }
+}
+
+/**
+ * @brief stops the worker processes and exits when the last one is gone
+ *
+ * @param signo SIGQUIT to let them finish their clients, SIGTERM to stop them right away
+ */
+void ServerMaster::stop(int signo)
+{
+    stopping_ = true;
+    signalWorkers(signo);
+}
+
+/**
+ * @brief reads the pending signals of the master
+ *
+ * @return 0 when done
+ */
+int ServerMaster::handleSignal()
+{
+    signalfd_siginfo info;
+    while (read(signal_fd_, &info, sizeof(info)) == sizeof(info))
+    {
+        switch (info.ssi_signo)
+        {
+            case SIGCHLD:
+                reapWorkers();
+                break;
+            case SIGHUP:
+                // the master keeps the new config for the worker processes it restarts
+                std::cerr << "SIGHUP received, reloading the config\n";
+                if (reload_.reload() == 0)
+                    signalWorkers(SIGHUP);
+                break;
+            case SIGUSR2:
+                std::cerr << "SIGUSR2 received, upgrading the binary\n";
+                if (upgrade_fd_ == -1 && !stopping_)
+                    upgrade_fd_ = upgrade_.start(listen_fds_.fds());
+                break;
+            case SIGQUIT:
+                std::cerr << "SIGQUIT received, the worker processes finish their clients\n";
+                stop(SIGQUIT);
+                break;
+            case SIGTERM:
+            case SIGINT:
+                std::cerr << "stopping the worker processes\n";
+                stop(SIGTERM);
+                break;
+            case SIGUSR1:
+                logCounters();
+                break;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief reads the startup report of the new master, once it is ready the worker processes drain
+ */
+void ServerMaster::handleUpgrade()
+{
+    e_upgrade_status status = upgrade_.readStatus(upgrade_fd_);
+    if (status == UPGRADE_PENDING)
+        return;
+    close(upgrade_fd_);
+    upgrade_fd_ = -1;
+    if (status == UPGRADE_READY)
+        stop(SIGQUIT);
+}
+
+/**
+ * @brief logs the counters of every worker process and their sum
+ */
+void ServerMaster::logCounters()
+{
+    uint64_t accepted = 0;
+    uint64_t requests = 0;
+    uint64_t active = 0;
+    for (size_t i = 0; i < workers_.size(); ++i)
+    {
+        uint64_t worker_accepted = counters_[i].accepted.load(std::memory_order_relaxed);
+        uint64_t worker_requests = counters_[i].requests.load(std::memory_order_relaxed);
+        uint64_t worker_active = counters_[i].active.load(std::memory_order_relaxed);
+        std::cerr << "worker process " << i << " pid " << workers_[i].pid << ": accepted " << worker_accepted
+            << ", requests " << worker_requests << ", active " << worker_active << "\n";
+        accepted += worker_accepted;
+        requests += worker_requests;
+        active += worker_active;
+    }
+    std::cerr << workers_.size() << " worker processes, " << restarts_ << " restarts: accepted " << accepted
+        << ", requests " << requests << ", active " << active << "\n";
+}
@@ -0,0 +1,349 @@
+#include "server/ServerOutputQueue.hpp"
+#include <sys/socket.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sstream>
+#include <algorithm>
+#include <iostream>
+
+/**
+ * @param file_fd the opened file, closed with the last reference
+ */
+s_file_fd::s_file_fd(int file_fd) : fd(file_fd) {}
+
+s_file_fd::~s_file_fd()
+{
+    if (fd != -1)
+        close(fd);
+}
+
+ServerOutputQueue::ServerOutputQueue() : offset_(0), file_remaining_(0), file_chunked_(false), file_attached_(false), file_failed_(false), file_offset_(0), advised_(0), max_chunk_(0), content_(nullptr), content_size_(0), content_offset_(0) {};
+
+ServerOutputQueue::~ServerOutputQueue() {};
+
+/**
+ * @brief queues bytes to be send after everything that is already queued
+ * 
+ * @param data the bytes to send
+ */
+void ServerOutputQueue::append(const std::string& data)
+{
+    buffer_.append(data);
+}
+
+/**
+ * @brief queues bytes to be send after everything that is already queued
+ * 
+ * @param data the bytes to send
+ * @param size the amount of bytes
+ */
+void ServerOutputQueue::append(const char* data, size_t size)
+{
+    buffer_.append(data, size);
+}
+
+/**
+ * @brief queues the content of a file after the queued bytes, the file is read while sending
+ * 
+ * @param file_stream the opened file, the queue takes ownership
+ * @param size the amount of bytes to send from the file
+ * @param chunked true if the file is send with chunked transfer encoding
+ */
+void ServerOutputQueue::attachFile(std::ifstream&& file_stream, uint64_t size, bool chunked)
+{
+    file_stream_ = std::move(file_stream);
+    file_remaining_ = size;
+    file_chunked_ = chunked;
+    file_attached_ = true;
+}
+
+/**
+ * @brief queues a file after the queued bytes that is send with sendfile(),
+ * the kernel is told the file is read from start to end and to read ahead of the socket
+ * 
+ * @param file the opened file, it stays open while the queue holds it
+ * @param size the amount of bytes to send from the file
+ * @param max_chunk bytes of the file to send per flush(), 0 for no limit
+ */
+void ServerOutputQueue::attachFd(std::shared_ptr<s_file_fd> file, uint64_t size, uint64_t max_chunk)
+{
+    file_fd_ = std::move(file);
+    file_offset_ = 0;
+    advised_ = 0;
+    max_chunk_ = max_chunk;
+    file_remaining_ = size;
+    file_chunked_ = false;
+    file_attached_ = true;
+    if (size > FILE_READAHEAD)
+        posix_fadvise(file_fd_->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    adviseReadahead();
+}
+
+/**
+ * @brief queues a file kept in memory after the queued bytes, it is sent from there without a copy
+ * 
+ * @param owner what keeps the memory alive while it is sent, the content cache entry or the bundle
+ * @param content the file
+ * @param size the bytes of the file
+ */
+void ServerOutputQueue::attachContent(std::shared_ptr<const void> owner, const char* content, size_t size)
+{
+    content_owner_ = std::move(owner);
+    content_ = content;
+    content_size_ = size;
+    content_offset_ = 0;
+}
+
+/**
+ * @brief sends as much of the queue as the socket accepts
+ * 
+ * @param client_fd the file descriptor of the client
+ * @param read_file false to leave reading the next piece of the file to readFile()
+ * @param quantum bytes to send at most before the other clients get their turn, 0 for no limit
+ * @return FLUSH_DONE when everything is send,
+ * @return FLUSH_AGAIN when the socket would block and the rest has to wait for EPOLLOUT,
+ * @return FLUSH_READ when the next piece of the file has to be read with readFile(),
+ * @return FLUSH_YIELD when the quantum or the sendfile_max_chunk is used up and the rest waits for the next turn,
+ * @return FLUSH_ERROR when send() or reading the file failed
+ */
+e_flush_return ServerOutputQueue::flush(int client_fd, bool read_file, uint64_t quantum)
+{
+    if (file_failed_)
+        return FLUSH_ERROR;
+    if (content_ != nullptr)
+        return sendContent(client_fd, quantum);
+    uint64_t sent = 0;
+    while (true)
+    {
+        if (offset_ == buffer_.size())
+        {
+            buffer_.clear();
+            offset_ = 0;
+            if (!file_attached_)
+                return FLUSH_DONE;
+            if (file_fd_)
+                return sendFromFd(client_fd, quantum, sent);
+            if (!read_file && file_remaining_ > 0)
+                return FLUSH_READ;
+            if (!refill())
+                return FLUSH_ERROR;
+            if (buffer_.empty())
+                continue;
+        }
+        if (quantum != 0 && sent >= quantum)
+            return FLUSH_YIELD;
+        ssize_t bytes_send = send(client_fd, buffer_.data() + offset_, buffer_.size() - offset_, MSG_NOSIGNAL);
+        if (bytes_send < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return FLUSH_AGAIN;
+            if (errno == EINTR)
+                continue;
+            return FLUSH_ERROR;
+        }
+        offset_ += bytes_send;
+        sent += bytes_send;
+    }
+}
+
+/**
+ * @brief reads the next piece of the file into the empty buffer, a failed read makes the next flush() fail
+ */
+void ServerOutputQueue::readFile()
+{
+    if (!refill())
+        file_failed_ = true;
+}
+
+/**
+ * @return true if nothing is waiting to be send
+ */
+bool ServerOutputQueue::empty() const
+{
+    return offset_ == buffer_.size() && !file_attached_ && content_ == nullptr;
+}
+
+/**
+ * @brief drops everything that is still queued and closes the file
+ * 
+ */
+void ServerOutputQueue::clear()
+{
+    buffer_.clear();
+    offset_ = 0;
+    if (file_stream_.is_open())
+        file_stream_.close();
+    file_fd_.reset();
+    content_owner_.reset();
+    content_ = nullptr;
+    content_offset_ = 0;
+    file_remaining_ = 0;
+    file_chunked_ = false;
+    file_attached_ = false;
+    file_failed_ = false;
+}
+
+// private functions
+
+/**
+ * @brief reads the next piece of the file into the empty buffer,
+ * with chunked transfer encoding the piece is framed as a chunk
+ * and the last chunk is added once the file is done
+ * 
+ * @return true when done,
+ * @return false if reading the file failed
+ */
+bool ServerOutputQueue::refill()
+{
+    if (file_remaining_ == 0)
+    {
+        if (file_chunked_)
+            buffer_.append("0\r\n\r\n");
+        file_stream_.close();
+        file_attached_ = false;
+        return true;
+    }
+    size_t piece = file_remaining_ < OUTPUT_BUDGET ? file_remaining_ : OUTPUT_BUDGET;
+    std::string chunk_size;
+    if (file_chunked_)
+    {
+        std::ostringstream chunk;
+        chunk << std::hex << piece << "\r\n"; // chunk size in hex
+        chunk_size = chunk.str();
+    }
+    buffer_.resize(chunk_size.size() + piece);
+    buffer_.replace(0, chunk_size.size(), chunk_size);
+    if (!file_stream_.read(&buffer_[chunk_size.size()], piece) || file_stream_.gcount() != static_cast<std::streamsize>(piece))
+    {
+        std::cerr << "reading file for response failed\n";
+        buffer_.clear();
+        return false;
+    }
+    if (file_chunked_)
+        buffer_.append("\r\n");
+    file_remaining_ -= piece;
+    return true;
+}
+
+/**
+ * @brief sends the attached fd with sendfile() until the socket would block,
+ * the quantum is used up or max_chunk bytes of the file are send
+ * 
+ * @param client_fd the file descriptor of the client
+ * @param quantum bytes to send at most in this flush(), 0 for no limit
+ * @param sent bytes already send in this flush()
+ * @return FLUSH_DONE when the whole file is send,
+ * @return FLUSH_AGAIN when the socket would block,
+ * @return FLUSH_YIELD when the rest waits for the next turn,
+ * @return FLUSH_ERROR when sendfile() failed or the file got shorter
+ */
+e_flush_return ServerOutputQueue::sendFromFd(int client_fd, uint64_t quantum, uint64_t sent)
+{
+    uint64_t limit = max_chunk_;
+    if (quantum != 0)
+    {
+        uint64_t left = sent < quantum ? quantum - sent : 0;
+        if (limit == 0 || left < limit)
+            limit = left;
+        if (limit == 0)
+            return FLUSH_YIELD;
+    }
+    uint64_t file_sent = 0;
+    while (file_remaining_ > 0)
+    {
+        if (limit != 0 && file_sent >= limit)
+            return FLUSH_YIELD;
+        size_t count = file_remaining_;
+        if (limit != 0 && count > limit - file_sent)
+            count = limit - file_sent;
+        adviseReadahead();
+        ssize_t bytes_send = sendfile(client_fd, file_fd_->fd, &file_offset_, count);
+        if (bytes_send < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return FLUSH_AGAIN;
+            if (errno == EINTR)
+                continue;
+            return FLUSH_ERROR;
+        }
+        if (bytes_send == 0)
+        {
+            std::cerr << "file for response got shorter while sending\n";
+            return FLUSH_ERROR;
+        }
+        file_remaining_ -= bytes_send;
+        file_sent += bytes_send;
+    }
+    file_fd_.reset();
+    file_attached_ = false;
+    return FLUSH_DONE;
+}
+
+/**
+ * @brief sends the queued bytes and the file in memory behind them with sendmsg(),
+ * one system call for the header and the body, until the socket would block or the quantum is used up
+ * 
+ * @param client_fd the file descriptor of the client
+ * @param quantum bytes to send at most before the other clients get their turn, 0 for no limit
+ * @return FLUSH_DONE when everything is send,
+ * @return FLUSH_AGAIN when the socket would block,
+ * @return FLUSH_YIELD when the rest waits for the next turn,
+ * @return FLUSH_ERROR when sendmsg() failed
+ */
+e_flush_return ServerOutputQueue::sendContent(int client_fd, uint64_t quantum)
+{
+    uint64_t sent = 0;
+    while (true)
+    {
+        size_t head = buffer_.size() - offset_;
+        size_t body = content_size_ - content_offset_;
+        if (head == 0 && body == 0)
+        {
+            buffer_.clear();
+            offset_ = 0;
+            content_owner_.reset();
+            content_ = nullptr;
+            return FLUSH_DONE;
+        }
+        if (quantum != 0 && sent >= quantum)
+            return FLUSH_YIELD;
+        iovec parts[2];
+        parts[0].iov_base = &buffer_[offset_];
+        parts[0].iov_len = head;
+        parts[1].iov_base = const_cast<char*>(content_ + content_offset_);
+        parts[1].iov_len = body;
+        msghdr message{};
+        message.msg_iov = parts;
+        message.msg_iovlen = 2;
+        ssize_t bytes_send = sendmsg(client_fd, &message, MSG_NOSIGNAL);
+        if (bytes_send < 0)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                return FLUSH_AGAIN;
+            if (errno == EINTR)
+                continue;
+            return FLUSH_ERROR;
+        }
+        size_t from_head = static_cast<size_t>(bytes_send) < head ? bytes_send : head;
+        offset_ += from_head;
+        content_offset_ += bytes_send - from_head;
+        sent += bytes_send;
+    }
+}
+
+/**
+ * @brief asks the kernel to read the next FILE_READAHEAD bytes of the sendfile() file
+ * once the socket gets close to the part that was asked for last, so sendfile() finds it in the page cache
+ */
+void ServerOutputQueue::adviseReadahead()
+{
+    off_t end = file_offset_ + static_cast<off_t>(file_remaining_);
+    advised_ = std::max(advised_, file_offset_); // a turn without a limit can send past what was advised
+    if (advised_ >= end || advised_ - file_offset_ > FILE_READAHEAD / 2)
+        return;
+    posix_fadvise(file_fd_->fd, advised_, FILE_READAHEAD, POSIX_FADV_WILLNEED);
+    advised_ += FILE_READAHEAD;
+}
@@ -0,0 +1,85 @@
+#include "server/ServerReload.hpp"
+#include <iostream>
+#include <unistd.h>
+
+/**
+ * @param config_path the config file given at the start, nullptr for the default file
+ * @param configs the server blocks loaded at the start, they become generation 1
+ */
+ServerReload::ServerReload(const char* config_path, std::vector<std::shared_ptr<Config>>& configs) : config_path_(config_path)
+{
+    std::shared_ptr<s_config_generation> generation = std::make_shared<s_config_generation>();
+    generation->number = 1;
+    generation->configs = configs;
+    generation->admission = std::make_shared<ServerAdmission>(configs);
+    current_ = generation;
+}
+
+ServerReload::~ServerReload() {};
+
+/**
+ * @return the newest config generation
+ */
+std::shared_ptr<const s_config_generation> ServerReload::current() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return current_;
+}
+
+/**
+ * @brief registers the eventfd a worker wants to be woken up on when there is a new generation
+ *
+ * @param wake_fd the eventfd of the worker
+ */
+void ServerReload::addWorker(int wake_fd)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    wake_fds_.push_back(wake_fd);
+}
+
+/**
+ * @brief loads and validates the config file again and makes it the current generation.
+ * Settings of the main context that shape the workers (worker_threads, worker_processes, aio_threads, content_cache, epoll_mode, event_backend)
+ * only change with a restart
+ *
+ * @return 0 when the workers are told about the new generation,
+ * @return -1 if the config file has errors, the current generation stays
+ */
+int ServerReload::reload()
+{
+    std::vector<std::shared_ptr<Config>> configs;
+    try
+    {
+        configs = ConfigLoader::load(config_path_);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "reload failed, keeping the running config: " << e.what() << "\n";
+        return -1;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::shared_ptr<s_config_generation> generation = std::make_shared<s_config_generation>();
+        generation->number = current_->number + 1;
+        generation->configs = configs;
+        generation->admission = std::make_shared<ServerAdmission>(configs, current_->admission.get());
+        current_ = generation;
+        std::cerr << "loaded config generation " << generation->number << "\n";
+    }
+    wakeWorkers();
+    return 0;
+}
+
+/**
+ * @brief wakes every worker through its eventfd, after a reload or when a upgrade took over
+ */
+void ServerReload::wakeWorkers()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint64_t one = 1;
+    for (int fd : wake_fds_)
+    {
+        if (write(fd, &one, sizeof(one)) != sizeof(one))
+            std::cerr << "waking worker failed\n";
+    }
+}
@@ -5,22 +5,72 @@
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sstream>
+#include <cctype>
+#include <cstdlib>
+#include <algorithm>
+#include <errno.h>
 
 s_client_data::s_client_data(std::shared_ptr<Config>& conf) : config_(conf) {}
 
 s_client_data::s_client_data(const s_client_data& other) : config_(other.config_)
 {
+    server_index = other.server_index;
+    fd = other.fd;
     request_type = other.request_type;
     request_header = other.request_header;
     request_body = other.request_body;
     request_method = other.request_method;
     request_source = other.request_source;
+    http_version = other.http_version;
     chunked = other.chunked;
+    keep_alive = other.keep_alive;
+    requests_served = other.requests_served;
+    responding = other.responding;
+    in_buffer = other.in_buffer;
+    parse_state = other.parse_state;
+    body_remaining = other.body_remaining;
+    weight = other.weight;
+    // pending output and a running coroutine are owned by the original, the copy starts without them
 }
 
-ServerRequestHandler::ServerRequestHandler(uint64_t client_body_size) 
+/**
+ * @brief clears the data of the last request so the connection can be reused for the next one.
+ * Bytes of a pipelined next request stay in in_buffer
+ * 
+ */
+void s_client_data::reset()
+{
+    request_type.clear();
+    request_header.clear();
+    request_body.clear();
+    request_method.clear();
+    request_source.clear();
+    http_version.clear();
+    chunked = false;
+    keep_alive = true;
+    responding = false;
+    parse_state = PARSE_HEADER;
+    body_remaining = 0;
+    weight = 1;
+    output.clear();
+    ++requests_served;
+}
+
+/**
+ * @brief checks if the connection stays open after the current response
+ * 
+ * @return true if the client and the config both allow keep-alive
+ */
+bool s_client_data::keepAlive() const
+{
+    if (!keep_alive || config_.get()->getKeepaliveTimeout() == 0)
+        return false;
+    return requests_served + 1 < config_.get()->getKeepaliveRequests();
+}
+
+ServerRequestHandler::ServerRequestHandler()
 {
-    max_size_ = client_body_size;
+    hosts_ = nullptr;
     stdout_pipe_[0] = -1;
     stdout_pipe_[1] = -1;
     stderr_pipe_[0] = -1;
@@ -52,59 +102,108 @@ void ServerRequestHandler::setStderrPipe(int stderr_pipe[])
     stderr_pipe_[1] = stderr_pipe[1];
 }
 
-void ServerRequestHandler::setConfigForClient(std::shared_ptr<Config>& conf, int client_fd)
+s_client_data* ServerRequestHandler::setConfigForClient(std::shared_ptr<Config>& conf, int client_fd)
 {
     if (request_.find(client_fd) == request_.end())
     {
         s_client_data node(conf);
+        node.fd = client_fd;
         request_.emplace(client_fd, node);
     }
+    return &request_.at(client_fd);
 }
 
 /**
- * @brief reads the request comming from the client
+ * @brief sets the table the server block of a request is picked from,
+ * only the server block that owns the listening socket of a port has one
+ * 
+ * @param hosts the server names of all server blocks on the port
+ */
+void ServerRequestHandler::setVirtualHosts(const ServerVirtualHosts* hosts)
+{
+    hosts_ = hosts;
+}
+
+/**
+ * @brief reads what the client has send so far and continues parsing the request where the last read stopped.
+ * The received bytes are kept in the client data, so a request can come in over multiple epoll events
  * 
  * @param client_fd the file descriptor of the client
- * @param request_buffer the string that will hold the entire request of the client
- * @return E_ROK when done,
+ * @param quantum bytes to receive at most before the other clients get their turn, 0 for no limit
+ * @return E_ROK when the request is complete,
+ * @return READ_INCOMPLETE when the rest of the request has not arrived yet,
+ * @return READ_YIELD when the quantum is used up before the request is complete,
  * @return NO_CONTENT_TYPE if no content type is in the header,
- * @return CLIENT_REQUEST_DATA_EMPTY if the headers doesnt have a mehtod, source or HTTPVersion,
- * @return READ_HEADER_BODY_TOO_LARGE if the content length of the body is larger than what we allow,
- * @return READ_REQUEST_EMPTY if the client sends a empty request
+ * @return CLIENT_REQUEST_DATA_EMPTY if the request could not be parsed,
+ * @return READ_HEADER_BODY_TOO_LARGE if the header or the body is larger than what we allow,
+ * @return READ_REQUEST_EMPTY if the client closed the connection in the middle of a request,
+ * @return RECV_EMPTY if the client closed the connection without sending anything,
+ * @return RECV_FAILED if recv() failed
  */
-e_reponses ServerRequestHandler::readRequest(int client_fd, std::string& request_buffer)
+e_reponses ServerRequestHandler::readRequest(int client_fd, uint64_t quantum)
 {
-    char buffer[BUFFER_SIZE] = {0};
-    ssize_t bytes_recieved = 0;
+    char buffer[BUFFER_SIZE];
     if (client_fd == stdout_pipe_[0] || client_fd == stderr_pipe_[0])
         return HANDLE_COUT_CERR_OUTPUT;
-    while ((bytes_recieved = recv(client_fd, buffer, BUFFER_SIZE, 0)) > 0)
+    s_client_data* data = getRequest(client_fd);
+    if (data == nullptr)
+        return CLIENT_REQUEST_DATA_EMPTY;
+
+    // a pipelined request can already be complete without reading
+    e_reponses nr = parseRequest(*data, client_fd);
+    uint64_t received = 0;
+    while (nr == READ_INCOMPLETE)
     {
-        request_buffer.append(buffer, bytes_recieved);
-        size_t header_end = request_buffer.find("\r\n\r\n");
-        if (header_end != std::string::npos)
-            return readHeader(request_buffer, header_end, client_fd, buffer);
+        size_t want = BUFFER_SIZE;
+        if (quantum != 0)
+        {
+            if (received >= quantum)
+                return READ_YIELD;
+            want = std::min<uint64_t>(want, quantum - received);
+        }
+        ssize_t bytes_recieved = recv(client_fd, buffer, want, 0);
+        if (bytes_recieved > 0)
+        {
+            data->in_buffer.append(buffer, bytes_recieved);
+            received += bytes_recieved;
+            nr = parseRequest(*data, client_fd);
+            continue;
+        }
+        if (bytes_recieved == 0)
+        {
+            if (data->parse_state == PARSE_HEADER && data->in_buffer.empty())
+                return RECV_EMPTY;
+            std::cerr << "client closed connection in the middle of a request\n";
+            return READ_REQUEST_EMPTY;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK)
+            return READ_INCOMPLETE;
+        if (errno != EINTR)
+        {
+            std::cerr << "recv failed and returned -1\n";
+            return RECV_FAILED;
+        }
     }
-    std::cerr << "read request empty at end\n";
-    return READ_REQUEST_EMPTY;
+    return nr;
 }
 
 /**
  * @brief modifies the client to let epoll know we are done reading and are ready to write to the client fd
  * 
  * @param client_fd the file descriptor of the client
- * @param request_buffer the string holding the request from the client
+ * @param event the epoll event of the client
  * @return MODIFY_CLIENT_WRITE when everything is good and we are ready to change the event to a write event in epoll.
- * @return HANDLE_CLIENT_EMPTY request_buffer is empty error
+ * @return HANDLE_CLIENT_EMPTY when the request is not complete
  */
-e_reponses ServerRequestHandler::handleClient(std::string& request_buffer, epoll_event& event)
+e_reponses ServerRequestHandler::handleClient(int client_fd, epoll_event& event)
 {
     event.events = EPOLLOUT;
-    if (!request_buffer.empty())
+    s_client_data* data = getRequest(client_fd);
+    if (data != nullptr && data->parse_state == PARSE_DONE)
         return MODIFY_CLIENT_WRITE;
     else
     {
-        std::cerr << "handle client request buffer is empty\n";
+        std::cerr << "handle client request is not complete\n";
         return HANDLE_CLIENT_EMPTY;
     }
 }
@@ -112,48 +211,91 @@ e_reponses ServerRequestHandler::handleClient(std::string& request_buffer, epoll
 // private functions
 
 /**
- * @brief reads the header from the client and sets the info in the reqeust map
+ * @brief parses as much of the received bytes as possible, moving from the header to the body
+ * 
+ * @param data the data of the client
+ * @param client_fd the file descriptor of the client
+ * @return E_ROK when the request is complete,
+ * @return READ_INCOMPLETE when more bytes are needed,
+ * @return other e_reponses values from the header and body parsing on error
+ */
+e_reponses ServerRequestHandler::parseRequest(s_client_data& data, int client_fd)
+{
+    if (data.parse_state == PARSE_HEADER)
+    {
+        size_t header_end = data.in_buffer.find("\r\n\r\n");
+        if (header_end == std::string::npos)
+        {
+            if (data.in_buffer.size() > MAX_HEADER_SIZE)
+                return READ_HEADER_BODY_TOO_LARGE;
+            return READ_INCOMPLETE;
+        }
+        e_reponses nr = readHeader(data.in_buffer, header_end, client_fd);
+        if (nr != E_ROK)
+            return nr;
+    }
+    if (data.parse_state == PARSE_BODY_LENGTH)
+        return handleContentLength(data);
+    if (data.parse_state == PARSE_BODY_CHUNKED)
+        return handleChunkedRequest(data);
+    if (data.parse_state == PARSE_CHUNK_TRAILER)
+        return handleChunkTrailer(data);
+    return E_ROK;
+}
+
+/**
+ * @brief reads the header from the client and sets the info in the reqeust map,
+ * the header is removed from the buffer and the parser moves on to the body
  * 
  * @param request_buffer the string holding header info
  * @param header_end position of where the header ands
  * @param client_fd the file descriptor of the header
- * @param buffer the last bytes read
  * @return E_ROK when done,
  * @return NO_CONTENT_TYPE if no content type is in the header,
  * @return CLIENT_REQUEST_DATA_EMPTY if the headers doesnt have a mehtod, source or HTTPVersion,
  * @return READ_HEADER_BODY_TOO_LARGE if the content length of the body is larger than what we allow
  */
-e_reponses ServerRequestHandler::readHeader(std::string& request_buffer, size_t header_end, int client_fd, char buffer[])
+e_reponses ServerRequestHandler::readHeader(std::string& request_buffer, size_t header_end, int client_fd)
 {
-    std::cout << request_buffer << std::endl;
+    std::string headers = request_buffer.substr(0, header_end);
+    std::cout << headers << std::endl;
 
-    if (setMethodSourceHttpVersion(request_buffer, client_fd) == CLIENT_REQUEST_DATA_EMPTY)
+    if (setMethodSourceHttpVersion(headers, client_fd) == CLIENT_REQUEST_DATA_EMPTY)
         return CLIENT_REQUEST_DATA_EMPTY;
 
-    if (setContentTypeRequest(request_buffer, header_end, client_fd) == NO_CONTENT_TYPE)
+    if (setContentTypeRequest(headers, header_end, client_fd) == NO_CONTENT_TYPE)
         return NO_CONTENT_TYPE;
 
-    std::string headers = request_buffer.substr(0, header_end);
-    getRequest(client_fd)->request_header = headers;
-    size_t body_start = header_end + 4; // Skip \r\n\r\n
+    s_client_data* data = getRequest(client_fd);
+    data->request_header = headers;
+    setVirtualHost(headers, client_fd);
+    setConnectionRequest(headers, client_fd);
+    request_buffer.erase(0, header_end + 4); // Skip \r\n\r\n
+    data->parse_state = PARSE_DONE;
 
     // check if it's chunked transfer encoding
     if (headers.find("Transfer-Encoding: chunked") != std::string::npos || headers.find("TE: chunked") != std::string::npos)
-        return handleChunkedRequest(body_start, request_buffer, client_fd, buffer);
+    {
+        data->parse_state = PARSE_BODY_CHUNKED;
+        data->body_remaining = 0;
+        return E_ROK;
+    }
     size_t content_length_body = headers.find("Content-Length: ");
     if (content_length_body != std::string::npos)
     {
         size_t start = content_length_body + 16;
         std::stringstream stream(headers.substr(start));
         uint64_t size;
-        stream >> size;
-        if (size > max_size_)
+        if (!(stream >> size))
+            return CLIENT_REQUEST_DATA_EMPTY;
+        if (size > data->config_->getClientMaxBodySize())
             return READ_HEADER_BODY_TOO_LARGE;
-        return handleContentLength(size, request_buffer, body_start, client_fd, buffer);
+        data->body_remaining = size;
+        if (size > 0)
+            data->parse_state = PARSE_BODY_LENGTH;
     }
     return E_ROK;
 }
-
 /**
  * @brief checks what the content type of the request from the client is
  * 
@@ -193,126 +335,182 @@ e_reponses ServerRequestHandler::setMethodSourceHttpVersion(std::string& request
 }
 
 /**
- * @brief un chunks the chunked request for better handeling later
+ * @brief checks if the client wants the connection closed after the response.
+ * HTTP/1.1 connections are persistent unless the client sends "Connection: close"
  * 
- * @param body_start position where the body of the request starts
- * @param request_buffer the string holding the entire request
+ * @param headers the header part of the request
  * @param client_fd the file descriptor of the client
- * @param buffer the buffer being used to read into the request
- * @return E_ROK when done,
- * @return RECV_FAILED when reading ussing recv() failed 
  */
-e_reponses ServerRequestHandler::handleChunkedRequest(size_t body_start, std::string& request_buffer, int client_fd, char buffer[])
+void ServerRequestHandler::setConnectionRequest(const std::string& headers, int client_fd)
 {
-    std::string decoded_body = "";
-    size_t pos = body_start;
-    while(true)
+    s_client_data* data = getRequest(client_fd);
+    if (data->http_version != "HTTP/1.1")
     {
-        // read chunk size
-        size_t chunk_size_end = request_buffer.find("\r\n", pos);
-        if (chunk_size_end == std::string::npos)
-        {
-            if (useRecv(client_fd, buffer, request_buffer) == -1) return RECV_FAILED;
-            continue;
-        }
-        std::string chunk_size_hex = request_buffer.substr(pos, chunk_size_end - pos);
-        int chunk_size = std::stoi(chunk_size_hex, nullptr, 16);
-        pos = chunk_size_end + 2; // move past \r\n
-        if (chunk_size == 0) break; // end of chunks
-
-        // ensure the full chunk is recieved
-        while (request_buffer.size() < pos + chunk_size + 2)
-        {
-            int recv_return = useRecv(client_fd, buffer, request_buffer);
-            if (recv_return == -1) return RECV_FAILED;
-            if (recv_return == 0) break;
-        }
-
-        // extract chunk data
-        std::string chunk_data = request_buffer.substr(pos, chunk_size);
-        decoded_body.append(chunk_data);
-        pos += chunk_size + 2; // move past \r\n
+        data->keep_alive = false;
+        return;
     }
-    getRequest(client_fd)->request_body = decoded_body;
-    getRequest(client_fd)->chunked = true;
-    return E_ROK;
+    size_t pos = headers.find("\r\nConnection: ");
+    if (pos == std::string::npos)
+        return;
+    pos += 14; // skip past "\r\nConnection: "
+    std::string value = headers.substr(pos, headers.find("\r\n", pos) - pos);
+    for (char& ch : value)
+        ch = std::tolower(static_cast<unsigned char>(ch));
+    if (value.find("close") != std::string::npos)
+        data->keep_alive = false;
 }
 
 /**
- * @brief uses recv to read with buffer in the the request from the client and stores it into request_buffer
+ * @brief picks the server block of the request from its Host header,
+ * a request without a Host header goes to the default server of the port
  * 
- * @param client_fd the file descriptor from the client
- * @param buffer the buffer used to read into the request from the client
- * @param request_buffer the string holding the entire request from the client
- * @return 0 when done,
- * @return -1 if recv() fails or std::length_error happens
+ * @param headers the header part of the request
+ * @param client_fd the file descriptor of the client
  */
-int ServerRequestHandler::useRecv(int client_fd, char buffer[], std::string& request_buffer)
+void ServerRequestHandler::setVirtualHost(const std::string& headers, int client_fd)
 {
-    ssize_t bytes_recieved = recv(client_fd, buffer, BUFFER_SIZE - 1, MSG_DONTWAIT);
-    if (bytes_recieved < 0)
-        return -1;
-    if (bytes_recieved == 0)
-        return 0;
-    try
-    {
-        request_buffer.append(buffer, bytes_recieved);
-    }
-    catch(std::length_error& e)
+    if (hosts_ == nullptr)
+        return;
+    std::string host;
+    size_t pos = headers.find("\r\nHost:");
+    if (pos != std::string::npos)
     {
-        std::cerr << "str append error\n";
-        std::cerr << e.what() << "\n";
-        return -1;
+        pos += 7; // skip past "\r\nHost:"
+        host = headers.substr(pos, headers.find("\r\n", pos) - pos);
     }
-    return 0;
+    const s_virtual_host& match = hosts_->find(host);
+    s_client_data* data = getRequest(client_fd);
+    data->config_ = match.config;
+    data->server_index = match.server;
 }
 
 /**
- * @brief reads into the request to read max n size to get the body of the request
+ * @brief un chunks the chunked request for better handeling later,
+ * every complete chunk in the buffer is added to the body and the rest waits for the next read.
+ * The data of a chunk has to be followed by exactly \r\n, anything else could shift bytes into the next request
  * 
- * @param size the max size we need to read
- * @param request_buffer the string holding the entire request
- * @param body_start the position where the body starts in request_buffer
- * @param client_fd the file descriptor of the client
- * @param buffer the buffer being used to read the request body from the client
- * @return E_ROK when done,
- * @return RECV_FAILED if useRecv() failed 
+ * @param data the data of the client
+ * @return E_ROK when the last chunk is read,
+ * @return READ_INCOMPLETE when more chunks are needed,
+ * @return READ_HEADER_BODY_TOO_LARGE if the body gets larger than what we allow,
+ * @return CLIENT_REQUEST_DATA_EMPTY if a chunk size is not valid or a chunk does not end with \r\n
  */
-e_reponses ServerRequestHandler::handleContentLength(size_t size, std::string& request_buffer, size_t body_start, int client_fd, char buffer[])
+e_reponses ServerRequestHandler::handleChunkedRequest(s_client_data& data)
 {
-    // std::cout << "BODY START AT BEGIN IS [" << body_start << "] SIZE AT START IS [" << size << "]\n";
     while (true)
     {
-        // std::cout << "body_start + size is [" << body_start + size << "] request_buffer.size() is [" << request_buffer.size() << "]\n";;
-        if (request_buffer.size() < body_start + size)
+        if (data.body_remaining == 0)
         {
-            ssize_t bytes_read = recv(client_fd, buffer, BUFFER_SIZE - 1, MSG_DONTWAIT);
-            if (bytes_read == -1)
+            // read chunk size
+            size_t chunk_size_end = data.in_buffer.find("\r\n");
+            if (chunk_size_end == std::string::npos)
             {
-                std::cerr << "recv failed and returned -1\n";
-                return RECV_FAILED;
+                if (data.in_buffer.size() > MAX_CHUNK_LINE)
+                    return CLIENT_REQUEST_DATA_EMPTY;
+                return READ_INCOMPLETE;
             }
-            else if (bytes_read == 0)
-                break;
-            else
+            uint64_t chunk_size = 0;
+            if (!parseChunkSize(data.in_buffer.substr(0, chunk_size_end), chunk_size))
+                return CLIENT_REQUEST_DATA_EMPTY;
+            data.in_buffer.erase(0, chunk_size_end + 2); // move past \r\n
+            if (chunk_size == 0) // end of chunks
             {
-                try
-                {
-                    request_buffer.append(buffer, bytes_read);
-                    if (request_buffer.size() >= size + body_start)
-                        break;
-                }
-                catch (std::exception& e)
-                {
-                    std::cerr << "append failed with message: " << e.what() << "\n";
-                    return EXCEPTION;
-                }
+                data.parse_state = PARSE_CHUNK_TRAILER;
+                return handleChunkTrailer(data);
             }
+            uint64_t max_size = data.config_->getClientMaxBodySize();
+            if (chunk_size > max_size || data.request_body.size() + chunk_size > max_size)
+                return READ_HEADER_BODY_TOO_LARGE;
+            data.body_remaining = chunk_size + 2; // chunk data and its \r\n
         }
-        else
-            break;
+
+        // take what has arrived of the chunk
+        size_t chunk_data = data.body_remaining > 2 ? std::min<uint64_t>(data.body_remaining - 2, data.in_buffer.size()) : 0;
+        data.request_body.append(data.in_buffer, 0, chunk_data);
+        data.in_buffer.erase(0, chunk_data);
+        data.body_remaining -= chunk_data;
+        if (data.body_remaining > 2)
+            return READ_INCOMPLETE;
+
+        // the \r\n after the chunk data, its two bytes can arrive in different reads
+        const char* line_end = &"\r\n"[2 - data.body_remaining];
+        size_t take = std::min<uint64_t>(data.body_remaining, data.in_buffer.size());
+        if (data.in_buffer.compare(0, take, line_end, take) != 0)
+            return CLIENT_REQUEST_DATA_EMPTY;
+        data.in_buffer.erase(0, take);
+        data.body_remaining -= take;
+        if (data.body_remaining > 0)
+            return READ_INCOMPLETE;
     }
-    getRequest(client_fd)->request_body = request_buffer.substr(body_start, size);
-    // std::cout << "request body at and is [" << getRequest(client_fd).request_body << "]" << std::endl;
+}
+
+/**
+ * @brief reads the size of a chunk, only hex digits are allowed, a chunk extension after a ; is ignored
+ * 
+ * @param line the chunk size line without its \r\n
+ * @param chunk_size will hold the size
+ * @return true if the size is valid,
+ * @return false if there are no digits, anything else than a extension after them or the size does not fit
+ */
+bool ServerRequestHandler::parseChunkSize(const std::string& line, uint64_t& chunk_size)
+{
+    size_t digits = 0;
+    chunk_size = 0;
+    for (; digits < line.size() && std::isxdigit(static_cast<unsigned char>(line[digits])); ++digits)
+    {
+        if (digits == 16) // more than 64 bits
+            return false;
+        char digit = std::tolower(static_cast<unsigned char>(line[digits]));
+        chunk_size = chunk_size * 16 + (std::isdigit(static_cast<unsigned char>(digit)) ? digit - '0' : digit - 'a' + 10);
+    }
+    return digits > 0 && (digits == line.size() || line[digits] == ';');
+}
+
+/**
+ * @brief skips the trailer after the last chunk, the request is complete after it
+ * 
+ * @param data the data of the client
+ * @return E_ROK when done,
+ * @return READ_INCOMPLETE when the end of the trailer has not arrived yet,
+ * @return READ_HEADER_BODY_TOO_LARGE if the trailer is larger than what we allow
+ */
+e_reponses ServerRequestHandler::handleChunkTrailer(s_client_data& data)
+{
+    size_t trailer_end = 0;
+    if (data.in_buffer.compare(0, 2, "\r\n") == 0)
+        trailer_end = 2;
+    else
+    {
+        trailer_end = data.in_buffer.find("\r\n\r\n");
+        if (trailer_end == std::string::npos)
+        {
+            if (data.in_buffer.size() > MAX_HEADER_SIZE)
+                return READ_HEADER_BODY_TOO_LARGE;
+            return READ_INCOMPLETE;
+        }
+        trailer_end += 4;
+    }
+    data.in_buffer.erase(0, trailer_end);
+    data.chunked = true;
+    data.parse_state = PARSE_DONE;
     return E_ROK;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief moves the body bytes that have arrived from the buffer into the request body
+ * 
+ * @param data the data of the client
+ * @return E_ROK when the whole body is read,
+ * @return READ_INCOMPLETE when more of the body is needed
+ */
+e_reponses ServerRequestHandler::handleContentLength(s_client_data& data)
+{
+    size_t take = std::min<uint64_t>(data.body_remaining, data.in_buffer.size());
+    data.request_body.append(data.in_buffer, 0, take);
+    data.in_buffer.erase(0, take);
+    data.body_remaining -= take;
+    if (data.body_remaining > 0)
+        return READ_INCOMPLETE;
+    data.parse_state = PARSE_DONE;
+    return E_ROK;
+}
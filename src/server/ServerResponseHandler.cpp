@@ -7,14 +7,17 @@
 #include <fstream>
 #include <sys/stat.h>
 #include <cstring>
+#include <strings.h>
 #include <fcntl.h>
 #include <unistd.h>
 #include <filesystem>
+#include "server/ServerTimerWheel.hpp"
 
 ServerResponseHandler::ServerResponseHandler(const std::vector<std::shared_ptr<Location>>& locations, const std::string& root, const std::map<uint16_t, std::string>& error_map) : SRV_(locations, root), error_pages_(error_map)
 {
     stdout_pipe_[0] = -1;
     stdout_pipe_[1] = -1;
+    scheduler_ = nullptr;
     fillStatusCodes();
 }
 
@@ -25,20 +28,63 @@ void ServerResponseHandler::setStdoutPipe(int stdout_pipe[])
     stdout_pipe_[0] = stdout_pipe[0];
 }
 
+/**
+ * @brief sets the event loop the coroutines of the responses wait in
+ * 
+ * @param scheduler the worker of the server block
+ */
+void ServerResponseHandler::setScheduler(ServerScheduler* scheduler)
+{
+    scheduler_ = scheduler;
+}
+
+/**
+ * @brief makes the open file cache of the server block when open_file_cache is on,
+ * the validator looks files up in the same cache
+ * 
+ * @param config the server block
+ */
+void ServerResponseHandler::setFileCache(const Config& config)
+{
+    if (config.getOpenFileCacheMax() == 0)
+        return;
+    file_cache_ = std::make_shared<ServerFileCache>(config.getOpenFileCacheMax(), config.getOpenFileCacheInactive() * 1000,
+        config.getOpenFileCacheValid() * 1000, config.getOpenFileCacheErrors());
+    SRV_.setFileCache(file_cache_);
+}
+
+/**
+ * @brief maps the bundle of the server block, the files in it are served from memory.
+ * A bundle that can not be mapped is reported and the root is served from disk
+ * 
+ * @param config the server block
+ */
+void ServerResponseHandler::setBundle(const Config& config)
+{
+    if (config.getBundle().empty())
+        return;
+    bundle_ = ServerBundle::map(config.getBundle().substr(1), config.getRoot().substr(1));
+    if (!bundle_)
+    {
+        std::cerr << "bundle " << config.getBundle() << " can not be mapped, serving " << config.getRoot() << " from disk\n";
+        return;
+    }
+    SRV_.setBundle(bundle_);
+}
+
 /**
  * @brief checks if everything from the request is good. The right http version,
  * Is the method alowed on the location the client wants.
  * Check for redirects.
  * Is auto indexing on and the index page missing.
- * And send the response to the client
+ * And queue the response for the client
  * 
- * @param client_fd the file descriptor of the client
  * @param client_data the data of the client from the request is send
  * @param locations all locations known to the server and there info
- * @return RVR_OK if all info is good and response has been send,
+ * @return RVR_OK if all info is good and response has been queued,
  * @return SRH_INCORRECT_HTTP_VERSION if the HTTPVersion in the request is not supported
  */
-e_server_request_return ServerResponseHandler::handleResponse(int client_fd, s_client_data& client_data, std::vector<std::shared_ptr<Location>> locations)
+e_server_request_return ServerResponseHandler::handleResponse(s_client_data& client_data, std::vector<std::shared_ptr<Location>> locations)
 {
     std::string file_path = "";
     std::vector<std::shared_ptr<Location>>::const_iterator location_it = locations.begin();
@@ -51,7 +97,7 @@ e_server_request_return ServerResponseHandler::handleResponse(int client_fd, s_c
     if (nr != RVR_OK)
     {
         if (nr != RVR_IS_REGEX)
-            return handleReturns(client_fd, nr, client_data, location_it);
+            return handleReturns(nr, client_data, location_it);
         else
         {
             file_path = client_data.config_.get()->getRoot() + location_it->get()->getRoot() + client_data.request_source;
@@ -67,29 +113,45 @@ e_server_request_return ServerResponseHandler::handleResponse(int client_fd, s_c
 
     nr = SRV_.checkAllowedMethods(location_it, client_data.request_method);
     if (nr != RVR_OK)
-        return handleReturns(client_fd, nr, client_data, location_it);
+        return handleReturns(nr, client_data, location_it);
+    client_data.weight = location_it->get()->getWeight();
     
     // Check for CGI before file handling
     if (location_it->get()->hasCGI()) {
         std::string ext = getContentType(file_path);
         if (location_it->get()->isCGIExtension(ext)) {
-            return handleCGI(client_fd, client_data, *location_it->get(), file_path);
+            return handleCGI(client_data, *location_it, file_path);
         }
     }
 
-    // check delete
-    if (client_data.request_method == "DELETE")
+    // TODO remove when done with project is for testing timeout
+    if (client_data.request_method != "DELETE" && location_it->get()->getPath() == "/timeout")
     {
-        return removeFile(client_fd, client_data);
+        return SRH_DO_TIMEOUT;
     }
+    return handleDisk(client_data, location_it, file_path);
+}
 
-    // TODO remove when done with project is for testing timeout
-    if (location_it->get()->getPath() == "/timeout")
+/**
+ * @brief the part of the response that touches the disk: deleting the file,
+ * looking up the file or index, listing the directory and opening the file to send.
+ * It runs on a aio thread when there are aio threads, so it only touches the client and read only config
+ * 
+ * @param client_data the data of the client from the request
+ * @param location_it the location that matched the request, in the locations of the config
+ * @param file_path the file the request asks for
+ * @return SRH_OK when the response is queued,
+ * @return SRH_FSTREAM_ERROR when the file could not be opened
+ */
+e_server_request_return ServerResponseHandler::respondFromDisk(s_client_data& client_data, std::vector<std::shared_ptr<Location>>::const_iterator location_it, std::string& file_path)
+{
+    // check delete
+    if (client_data.request_method == "DELETE")
     {
-        return SRH_DO_TIMEOUT;
+        return removeFile(client_data);
     }
 
-    nr = SRV_.checkFile(file_path, location_it);
+    e_responeValReturn nr = SRV_.checkFile(file_path, location_it);
     if (nr != RVR_OK)
     {
         if (nr == RVR_AUTO_INDEX_ON)
@@ -98,20 +160,20 @@ e_server_request_return ServerResponseHandler::handleResponse(int client_fd, s_c
             if (nr != RVR_SHOW_DIRECTORY)
             {
                 if (nr == RVR_NOT_FOUND)
-                    return setupResponse(client_fd, 404, client_data);
+                    return setupResponse(404, client_data);
                 else if (nr == RVR_NO_FILE_PERMISSION)
-                    return setupResponse(client_fd, 403, client_data);
+                    return setupResponse(403, client_data);
                 }
             std::string body = "";
             e_server_request_return response = buildDirectoryResponse(SRV_.getRoot().substr(1) + location_it->get()->getRoot(), body);
             if (response != SRH_OK)
-                return handleReturns(client_fd, RVR_DIR_FAILED, client_data, location_it);
-            return sendResponse(client_fd, "200 Ok", body, client_data, true);
+                return handleReturns(RVR_DIR_FAILED, client_data, location_it);
+            return sendResponse("200 Ok", body, client_data, true);
         }
         else
-            return handleReturns(client_fd, nr, client_data, location_it);
+            return handleReturns(nr, client_data, location_it);
     }
-    return setupResponse(client_fd, 200, client_data, file_path);
+    return setupResponse(200, client_data, file_path);
 }
 
 /**
@@ -119,13 +181,12 @@ e_server_request_return ServerResponseHandler::handleResponse(int client_fd, s_c
  * If the code is a error code it looks if the config has a error page with the coresponding code,
  * or that a fall back error page is needed
  * 
- * @param client_fd the file descriptor of the client
  * @param code the code we send in the return
  * @param data the request data from the client
  * @param location the location where the page is located (can be empty)
  * @return SRH_OK when done
  */
-e_server_request_return ServerResponseHandler::setupResponse(int client_fd, uint16_t code, const s_client_data& data, std::string location)
+e_server_request_return ServerResponseHandler::setupResponse(uint16_t code, s_client_data& data, std::string location)
 {
     size_t dot_pos = 0;
     // handle redirects
@@ -133,7 +194,7 @@ e_server_request_return ServerResponseHandler::setupResponse(int client_fd, uint
     {  
         dot_pos = location.find(".", 0);
         if (dot_pos == std::string::npos)
-            return sendRedirectResponse(client_fd, code, location);
+            return sendRedirectResponse(code, location, data);
     }
     std::string status_text = "";
     if (status_codes_.find(code) != status_codes_.end())
@@ -152,7 +213,7 @@ e_server_request_return ServerResponseHandler::setupResponse(int client_fd, uint
         status_text = "500 Internal Server Error";
     if (code == 200)
     {
-        return sendResponse(client_fd, status_text, location, data);
+        return sendResponse(status_text, location, data);
     }
     else
     {
@@ -162,12 +223,12 @@ e_server_request_return ServerResponseHandler::setupResponse(int client_fd, uint
             std::string fall_back = "/example/errorPages/";
             fall_back.append(std::to_string(code));
             fall_back.append(".html");
-            return sendResponse(client_fd, status_text, fall_back, data);
+            return sendResponse(status_text, fall_back, data);
         }
         else
         {
             location.insert(0UL, SRV_.getRoot());
-            return sendResponse(client_fd, status_text, location + "/" + error_page->second, data);
+            return sendResponse(status_text, location + "/" + error_page->second, data);
         }
     }
     return SRH_OK;
@@ -200,37 +261,36 @@ void ServerResponseHandler::handleCoutErrOutput(int fd)
 /**
  * @brief handles different returnn messages
  * 
- * @param client_fd the file descriptor of the client
  * @param nr what e_responseValRetun varlue is used
  * @param data the request data from the user
  * @return SRH_OK when done
  */
-e_server_request_return ServerResponseHandler::handleReturns(int client_fd, e_responeValReturn nr, s_client_data& data, std::vector<std::shared_ptr<Location>>::const_iterator& location_it)
+e_server_request_return ServerResponseHandler::handleReturns(e_responeValReturn nr, s_client_data& data, std::vector<std::shared_ptr<Location>>::const_iterator& location_it)
 {
     switch (nr)
     {
         case RVR_RETURN:
             std::cout << "return code is " << location_it->get()->getReturn().code << " return body is " << location_it->get()->getReturn().body << " location is " << location_it->get()->getRoot() << std::endl;
-            setupResponse(client_fd, location_it->get()->getReturn().code, data, location_it->get()->getReturn().body);
+            setupResponse(location_it->get()->getReturn().code, data, location_it->get()->getReturn().body);
             break;
         case RVR_NOT_FOUND:
-            setupResponse(client_fd, 404, data);
+            setupResponse(404, data);
             break;
         case RVR_BUFFER_NOT_EMPTY:
-            setupResponse(client_fd, 500, data);
+            setupResponse(500, data);
             break;
         case RVR_METHOD_NOT_ALLOWED:
-            setupResponse(client_fd, 405, data);
+            setupResponse(405, data);
             break;
         case RVR_NO_FILE_PERMISSION:
-            setupResponse(client_fd, 403, data);
+            setupResponse(403, data);
             break;
         case RVR_DIR_FAILED:
-            setupResponse(client_fd, 500, data);
+            setupResponse(500, data);
             break;
         default:
             std::cerr << "unkown respone validator error " << nr << '\n';
-            setupResponse(client_fd, 500, data);
+            setupResponse(500, data);
             break;
     }
     return SRH_OK;
@@ -267,79 +327,269 @@ e_server_request_return ServerResponseHandler::buildDirectoryResponse(const std:
 }
 
 /**
- * @brief Builds the response header and the body to be send to the client
+ * @brief Builds the response header and the body and queues them for the client,
+ * the file itself is read while the response is being send.
+ * With sendfile on a file is queued as a fd for sendfile(), a chunked response still goes through the buffer
  * 
- * @param client_fd file descriptor of the client
  * @param status the string holding the status of the response 
  * @param file_location where the file holding the respone is locaded
  * @param data the request data from the client
  * @param d_list true if we need to show directory listing
  * @return SRH_OK when done,
- * @return SRH_SEND_ERROR when send() failes,
  * @return SRH_FSTREAM_ERROR when file stream failed to open 
  */
-e_server_request_return ServerResponseHandler::sendResponse(int client_fd, const std::string& status, const std::string& file_location, const s_client_data& data, bool d_list)
+e_server_request_return ServerResponseHandler::sendResponse(const std::string& status, const std::string& file_location, s_client_data& data, bool d_list)
 {
-    bool content = false;
     std::ostringstream response;
     response << "HTTP/1.1 " << status << "\r\n";
-    response << "Connection: close\r\n";
+    response << connectionHeader(data);
 
     if (d_list)
     {
         response << "Content-Type: " << getContentType("x.html") << "\r\n";
         response << "Content-Length: " << file_location.size() << "\r\n\r\n";
         response << file_location;
-        if (send(client_fd, response.str().c_str(), response.str().size(), 0) <= 0)
-            return SRH_SEND_ERROR;
+        data.output.append(response.str());
         return SRH_OK;
     }
 
+    if (!data.chunked && queueBundled(status, file_location, data))
+        return SRH_OK;
+    if (!data.chunked && queueCached(response, file_location, data))
+        return SRH_OK;
+    if (data.config_->getSendfile() && !data.chunked)
+        return queueFd(response, status, file_location, data);
     response << "Content-Type: " << getContentType(file_location) << "\r\n";
     std::ifstream file_stream("." + file_location, std::ios::binary);
     if (!file_stream.is_open())
+        return openFailed(response, status, file_location, data);
+
+    std::streamsize file_size = 0;
+    if (file_stream.good())
     {
-        std::string content = status;
-        response << "Content-Length: " << content.size() << "\r\n\r\n";
-        response << content;
-        std::cerr << "file_stream open: " << file_location << std::endl;
-        if (send(client_fd, response.str().c_str(), response.str().size(), 0) <= 0)
-            return SRH_SEND_ERROR;
-        return SRH_FSTREAM_ERROR;
+        std::cout << "locations is: " << file_location << std::endl;
+        file_stream.seekg(0, std::ios::end);
+        file_size = file_stream.tellg();
+        file_stream.seekg(0, std::ios::beg);
+        if (file_size < 0)
+            file_size = 0;
     }
-
     if (data.chunked)
-    {
         response << "Transfer-Encoding: chunked\r\n\r\n";
-        if (send(client_fd, response.str().c_str(), response.str().size(), 0) <= 0)
-            return SRH_SEND_ERROR;
-        if (sendChunkedResponse(client_fd, file_stream)!= SRH_OK)
-            return SRH_SEND_ERROR;
-    }
     else
+        response << "Content-Length: " << file_size << "\r\n\r\n";
+    data.output.append(response.str());
+    if (file_size > 0 || data.chunked)
+        data.output.attachFile(std::move(file_stream), file_size, data.chunked);
+    return SRH_OK;
+}
+
+/**
+ * @brief opens the file of a response for sendfile() and queues it after the header.
+ * With open_file_cache on a hot file comes from the cache with its fd and headers, without a system call
+ * 
+ * @param response the response header so far
+ * @param status the string holding the status of the response
+ * @param file_location where the file holding the respone is locaded
+ * @param data the request data from the client
+ * @return SRH_OK when done,
+ * @return SRH_FSTREAM_ERROR when the file failed to open
+ */
+e_server_request_return ServerResponseHandler::queueFd(std::ostringstream& response, const std::string& status, const std::string& file_location, s_client_data& data)
+{
+    std::string path = diskPath(file_location);
+    s_file_info file = file_cache_ ? file_cache_->lookup(path) : ServerFileCache::load(path);
+    if (!file.file)
+    {
+        response << "Content-Type: " << getContentType(file_location) << "\r\n";
+        return openFailed(response, status, file_location, data);
+    }
+    if (file.headers.empty())
     {
-        std::streamsize file_size;
-        if (file_stream.good())
+        file.headers = "Content-Type: " + getContentType(file_location) + "\r\n";
+        file.headers += "Content-Length: " + std::to_string(file.size) + "\r\n\r\n";
+        if (file_cache_)
+            file_cache_->setHeaders(path, file, file.headers);
+    }
+    response << file.headers;
+    data.output.append(response.str());
+    if (file.size > 0)
+        data.output.attachFd(file.file, file.size, data.config_->getSendfileMaxChunk());
+    return SRH_OK;
+}
+
+/**
+ * @brief queues a file from the content cache of the worker after the header, without touching the disk on a hit
+ * 
+ * @param response the response header so far
+ * @param file_location where the file holding the respone is locaded
+ * @param data the request data from the client
+ * @return true when the file is queued,
+ * @return false if there is no content cache or it does not keep the file
+ */
+bool ServerResponseHandler::queueCached(std::ostringstream& response, const std::string& file_location, s_client_data& data)
+{
+    ServerContentCache* cache = scheduler_ != nullptr ? scheduler_->contentCache() : nullptr;
+    if (cache == nullptr)
+        return false;
+    std::shared_ptr<const s_cached_content> content = cache->lookup(diskPath(file_location), getContentType(file_location));
+    if (!content)
+        return false;
+    response << content->headers;
+    data.output.append(response.str());
+    if (!content->body.empty())
+        data.output.attachContent(content, content->body.data(), content->body.size());
+    return true;
+}
+
+/**
+ * @brief queues a file of the bundle with its prebuilt headers, the body is sent straight from the mapping.
+ * The gzip variant goes to a client that accepts it, a 200 whose If-None-Match holds the ETag becomes a 304 without a body
+ * 
+ * @param status the string holding the status of the response
+ * @param file_location where the file holding the respone is locaded
+ * @param data the request data from the client
+ * @return true when the response is queued,
+ * @return false if there is no bundle or the file is not in it
+ */
+bool ServerResponseHandler::queueBundled(const std::string& status, const std::string& file_location, s_client_data& data)
+{
+    const s_bundle_entry* entry = bundle_ ? bundle_->find(diskPath(file_location)) : nullptr;
+    if (entry == nullptr)
+        return false;
+    const s_bundle_variant* variant = &entry->plain;
+    if (entry->gzip.headers_length > 0 && acceptsGzip(headerValue(data.request_header, "Accept-Encoding")))
+        variant = &entry->gzip;
+    std::string etag(bundle_->data(variant->etag_offset), variant->etag_length);
+    std::string response = "HTTP/1.1 ";
+    if (status.compare(0, 3, "200") == 0 && headerValue(data.request_header, "If-None-Match") == etag)
+    {
+        response += status_codes_.at(304) + "\r\n" + connectionHeader(data);
+        response += "ETag: " + etag + "\r\n\r\n";
+        data.output.append(response);
+        return true;
+    }
+    response += status + "\r\n" + connectionHeader(data);
+    response.append(bundle_->data(variant->headers_offset), variant->headers_length);
+    data.output.append(response);
+    if (variant->body_length > 0)
+        data.output.attachContent(bundle_, bundle_->data(variant->body_offset), variant->body_length);
+    return true;
+}
+
+/**
+ * @brief finds a header of the request the same way the Host header is found
+ * 
+ * @param headers the raw header lines of the request
+ * @param name the name of the header
+ * @return the value without the spaces around it,
+ * @return a empty string if the request does not have the header
+ */
+std::string ServerResponseHandler::headerValue(const std::string& headers, const std::string& name)
+{
+    size_t start = headers.find("\r\n" + name + ":");
+    if (start == std::string::npos)
+        return "";
+    start = headers.find_first_not_of(" \t", start + name.size() + 3);
+    if (start == std::string::npos)
+        return "";
+    size_t end = headers.find("\r\n", start);
+    if (end == std::string::npos)
+        end = headers.size();
+    end = headers.find_last_not_of(" \t", end - 1);
+    return headers.substr(start, end - start + 1);
+}
+
+/**
+ * @brief checks the comma separated codings of a Accept-Encoding header for gzip.
+ * A coding with q=0 is refused, a * stands for gzip when gzip is not listed itself
+ * 
+ * @param accept_encoding the value of the header
+ * @return true if the client takes a gzip body
+ */
+bool ServerResponseHandler::acceptsGzip(const std::string& accept_encoding)
+{
+    bool gzip = false;
+    bool any = false;
+    bool listed = false;
+    size_t start = 0;
+    while (start < accept_encoding.size())
+    {
+        size_t end = accept_encoding.find(',', start);
+        if (end == std::string::npos)
+            end = accept_encoding.size();
+        std::string coding = accept_encoding.substr(start, end - start);
+        start = end + 1;
+        bool accepted = true;
+        size_t param = coding.find(';');
+        if (param != std::string::npos)
         {
-            std::cout << "locations is: " << file_location << std::endl;
-            file_stream.seekg(0, std::ios::end);
-            file_size = file_stream.tellg();
-            file_stream.seekg(0, std::ios::beg);
-            response << "Content-Length: " << file_size << "\r\n\r\n";
-            if (file_size > 0)
-                content = true;
+            std::string q = coding.substr(param + 1);
+            q.erase(0, q.find_first_not_of(" \t"));
+            q.erase(q.find_last_not_of(" \t") + 1);
+            if (q.size() > 2 && (q[0] == 'q' || q[0] == 'Q') && q[1] == '=' && q[2] == '0'
+                && q.find_first_not_of("0.", 2) == std::string::npos)
+                accepted = false; // q=0, q=0.0 and so on
+            coding.erase(param);
         }
-        else
-            response << "Content-Length: 0\r\n\r\n";
-        if (send(client_fd, response.str().c_str(), response.str().size(), 0) <= 0)
-            return SRH_SEND_ERROR;
-        if (content)
+        size_t first = coding.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            continue;
+        coding = coding.substr(first, coding.find_last_not_of(" \t") - first + 1);
+        if (strcasecmp(coding.c_str(), "gzip") == 0 || strcasecmp(coding.c_str(), "x-gzip") == 0)
         {
-            if (sendFile(client_fd, file_stream, file_size) != SRH_OK)
-                return SRH_SEND_ERROR;
+            gzip = accepted;
+            listed = true;
         }
+        else if (coding == "*")
+            any = accepted;
     }
-    return SRH_OK;
+    return listed ? gzip : any;
+}
+
+/**
+ * @brief the path of a response file relative to the working directory, the way the validator looks it up
+ * 
+ * @param file_location where the file holding the respone is locaded
+ * @return the path to open
+ */
+std::string ServerResponseHandler::diskPath(const std::string& file_location)
+{
+    if (!file_location.empty() && file_location.front() == '/')
+        return file_location.substr(1);
+    return "." + file_location;
+}
+
+/**
+ * @brief answers with the status alone when the file of a response could not be opened
+ * 
+ * @param response the response header so far
+ * @param status the string holding the status of the response
+ * @param file_location where the file holding the respone is locaded
+ * @param data the request data from the client
+ * @return SRH_FSTREAM_ERROR
+ */
+e_server_request_return ServerResponseHandler::openFailed(std::ostringstream& response, const std::string& status, const std::string& file_location, s_client_data& data)
+{
+    response << "Content-Length: " << status.size() << "\r\n\r\n";
+    response << status;
+    std::cerr << "file_stream open: " << file_location << std::endl;
+    data.output.append(response.str());
+    return SRH_FSTREAM_ERROR;
+}
+
+/**
+ * @brief builds the connection header for the response,
+ * keep-alive when the connection will be reused for a next request
+ * 
+ * @param data the request data from the client
+ * @return a string holding the Connection (and Keep-Alive) header lines
+ */
+std::string ServerResponseHandler::connectionHeader(const s_client_data& data)
+{
+    if (!data.keepAlive())
+        return "Connection: close\r\n";
+    return "Connection: keep-alive\r\nKeep-Alive: timeout=" + std::to_string(data.config_.get()->getKeepaliveTimeout()) + "\r\n";
 }
 
 /**
@@ -381,52 +631,6 @@ std::string ServerResponseHandler::getContentType(const std::string& file_path)
     return "application/octet-stream"; // Default for unknown types
 }
 
-/**
- * @brief chunks the response data and send it chunk by chunk to the client
- * 
- * @param client_fd file descriptor of the client
- * @param file_stream the file stream holding the respone for the client
- * @return SRH_OK when done,
- * @return SRH_SEND_ERROR is send() fails
- */
-e_server_request_return ServerResponseHandler::sendChunkedResponse(int client_fd, std::ifstream& file_stream)
-{
-    char buffer[BUFFER_SIZE];
-    while (file_stream.read(buffer, BUFFER_SIZE) || file_stream.gcount() > 0)
-    {
-        std::ostringstream chunk;
-        chunk << std::hex << file_stream.gcount() << "\r\n"; // chunk size in hex
-        if (send(client_fd, chunk.str().c_str(), chunk.str().size(), 0) <= 0)
-            return SRH_SEND_ERROR;
-        if (send(client_fd, buffer, file_stream.gcount(), 0) <= 0)
-            return SRH_SEND_ERROR;
-        if (send(client_fd, "\r\n\r\n", 2, 0) < 0)
-            return SRH_SEND_ERROR;
-    }
-    if (send(client_fd, "0\r\n\r\n", 5, 0) <= 0)
-        return SRH_SEND_ERROR;
-    return SRH_OK;
-}
-
-/**
- * @brief sends the body with the info from the file to the client
- * 
- * @param client_fd the file descriptor of the client
- * @param file_stream tje stream holding the response for the cloent
- * @return SRH_OK when done,
- * @return SRH_SEND_ERROR when send() fails
- */
-e_server_request_return ServerResponseHandler::sendFile(int client_fd, std::ifstream& file_stream, std::streamsize size)
-{
-    char buffer[BUFFER_SIZE] = {0};
-    while(file_stream.read(buffer, size) || file_stream.gcount() > 0)
-    {
-        if (send(client_fd, buffer, file_stream.gcount(), MSG_NOSIGNAL) <= 0)
-            return SRH_SEND_ERROR;
-    }
-    return SRH_OK;
-}
-
 /**
  * @brief puts the request source from the client in chunks to check if previous defined less precise have a redirect
  * 
@@ -481,6 +685,8 @@ void ServerResponseHandler::logMsg(const char* msg, int fd)
     }
     file.insert(0,"logs/");
     int file_fd = open(file.c_str(), O_CREAT | O_APPEND | O_WRONLY, S_IRUSR | S_IWUSR);
+    if (file_fd == -1) // out of file descriptors, the message is dropped
+        return;
     if (write(file_fd, msg, strlen(msg)) <= 0)
     {
         close(file_fd);
@@ -490,33 +696,50 @@ void ServerResponseHandler::logMsg(const char* msg, int fd)
 }
 
 /**
- * @brief Handle CGI request processing
+ * @brief Handle CGI request processing, the script runs in a coroutine
+ * so the worker serves other clients while it waits for the script
  *
- * @param client_fd the file descriptor of the client
  * @param client_data the data of the client from the request
  * @param location location info used for CGI configuration
  * @param script_path path to the CGI script
- * @return SRH_OK when done,
- * @return SRH_CGI_ERROR if CGI processing fails
+ * @return SRH_SUSPENDED while the script runs,
+ * @return SRH_OK when the response is already queued, the script could not be started
  */
 e_server_request_return ServerResponseHandler::handleCGI(
-    int client_fd,
-    const s_client_data& client_data,
-    const Location& location,
+    s_client_data& client_data,
+    const std::shared_ptr<Location>& location,
     const std::string& script_path)
 {
+    client_data.task = runCGI(client_data, location, script_path);
+    if (client_data.task.active())
+        return SRH_SUSPENDED;
+    client_data.task = ServerTask();
+    return SRH_OK;
+}
+
+/**
+ * @brief runs a CGI script as a coroutine: writes the request body to it, reads its output
+ * and waits for it to exit, suspending whenever a pipe is not ready.
+ * The whole script gets CGI_TIMEOUT_MS, after that it is killed and the client gets a 504.
+ * When the client is closed first the coroutine is destroyed, which kills the script
+ *
+ * @param client_data the data of the client from the request, it outlives the coroutine
+ * @param location location info used for CGI configuration, held by the coroutine
+ * @param script_path path to the CGI script
+ */
+ServerTask ServerResponseHandler::runCGI(s_client_data& client_data, std::shared_ptr<Location> location, std::string script_path)
+{
+    uint64_t deadline = ServerTimerWheel::nowMs() + CGI_TIMEOUT_MS;
+    CGIHandler handler(*location);
+    CGIExecutor& script = handler.executor();
     try {
-        CGIHandler handler(location);
-        
         // Extract query string if present
         std::string query_string;
         size_t query_pos = client_data.request_source.find('?');
         if (query_pos != std::string::npos) {
             query_string = client_data.request_source.substr(query_pos + 1);
         }
-
-        // Execute CGI script
-        auto [status_code, response] = handler.handleRequest(
+        handler.start(
             script_path,
             client_data.request_method,
             client_data.request_body,
@@ -524,44 +747,147 @@ e_server_request_return ServerResponseHandler::handleCGI(
             client_data.config_.get()->getServerName(),
             client_data.config_.get()->getPort()
         );
+    }
+    catch (const std::exception& e) {
+        std::cerr << "CGI error: " << e.what() << std::endl;
+        setupResponse(500, client_data);
+        co_return;
+    }
 
-        if (status_code == -2) {
-            return setupResponse(client_fd, 504, client_data);
-        }
-        else if (status_code != 0) {
-            return setupResponse(client_fd, 500, client_data);
+    // Write the request body, a script that stops reading its input gets the rest cut off
+    std::string error;
+    const std::string& body = client_data.request_body;
+    size_t written = 0;
+    while (written < body.size())
+    {
+        ssize_t len = write(script.inputFd(), body.data() + written, body.size() - written);
+        if (len > 0)
+            written += len;
+        else if (len == -1 && errno == EAGAIN)
+        {
+            if (co_await ServerAwait(*scheduler_, client_data.fd, script.inputFd(), EPOLLOUT, timeLeft(deadline), script.errorFd()) == 0)
+            {
+                setupResponse(504, client_data);
+                co_return;
+            }
+            script.readError(error);
         }
+        else
+            break;
+    }
+    script.closeInput();
 
-        // Format and send response with CGI output
-        std::ostringstream headers;
-        headers << "HTTP/1.1 200 OK\r\n"
-                << "Connection: close\r\n"
-                << "Content-Type: text/html\r\n"
-                << "Content-Length: " << response.length() << "\r\n\r\n"
-                << response;
-
-        if (send(client_fd, headers.str().c_str(), headers.str().length(), 0) <= 0) {
-            return SRH_SEND_ERROR;
+    // Read the output until the script closes it, its errors are read on the way so it never blocks on them
+    std::string response;
+    while (true)
+    {
+        script.readError(error);
+        ssize_t len = script.readOutput(response);
+        if (len == 0)
+            break;
+        if (len > 0)
+            continue;
+        if (co_await ServerAwait(*scheduler_, client_data.fd, script.outputFd(), EPOLLIN, timeLeft(deadline), script.errorFd()) == 0)
+        {
+            setupResponse(504, client_data);
+            co_return;
         }
+    }
+    script.readError(error);
 
-        return SRH_OK;
+    int status_code = script.reap(false);
+    if (status_code == static_cast<int>(CGIExitStatus::Running) && script.exitFd() == -1)
+        status_code = script.reap(true); // no pidfd to wait on, the script closed its output and is about to exit
+    while (status_code == static_cast<int>(CGIExitStatus::Running))
+    {
+        if (co_await ServerAwait(*scheduler_, client_data.fd, script.exitFd(), EPOLLIN, timeLeft(deadline), script.errorFd()) == 0)
+        {
+            setupResponse(504, client_data);
+            co_return;
+        }
+        script.readError(error);
+        status_code = script.reap(false);
     }
-    catch (const std::exception& e) {
-        std::cerr << "CGI error: " << e.what() << std::endl;
-        return setupResponse(client_fd, 500, client_data);
+    if (status_code != 0) {
+        std::cerr << "CGI error: " << script_path << " exited with " << status_code << ": " << error << std::endl;
+        setupResponse(500, client_data);
+        co_return;
     }
+    if (response.empty())
+        response = error;
+
+    // Format and queue response with CGI output
+    std::ostringstream headers;
+    headers << "HTTP/1.1 200 OK\r\n"
+            << connectionHeader(client_data)
+            << "Content-Type: text/html\r\n"
+            << "Content-Length: " << response.length() << "\r\n\r\n"
+            << response;
+    client_data.output.append(headers.str());
+}
+
+/**
+ * @brief answers from the disk, on a aio thread in a coroutine when there are aio threads
+ * so the worker serves other clients while the disk is slow
+ *
+ * @param client_data the data of the client from the request
+ * @param location_it the location that matched the request, the config of the client keeps it alive
+ * @param file_path the file the request asks for, moved into the coroutine
+ * @return SRH_SUSPENDED while a aio thread works on it,
+ * @return the result of respondFromDisk without aio threads
+ */
+e_server_request_return ServerResponseHandler::handleDisk(s_client_data& client_data, std::vector<std::shared_ptr<Location>>::const_iterator location_it, std::string& file_path)
+{
+    if (scheduler_ == nullptr || !scheduler_->offloading())
+        return respondFromDisk(client_data, location_it, file_path);
+    client_data.task = runDisk(client_data, location_it, std::move(file_path));
+    if (client_data.task.active())
+        return SRH_SUSPENDED;
+    client_data.task = ServerTask();
+    return SRH_OK;
+}
+
+/**
+ * @brief waits for respondFromDisk on a aio thread, a failure is handled the way the worker does it
+ * for a response that is built right away
+ *
+ * @param client_data the data of the client from the request, it outlives the coroutine
+ * @param location_it the location that matched the request
+ * @param file_path the file the request asks for
+ */
+ServerTask ServerResponseHandler::runDisk(s_client_data& client_data, std::vector<std::shared_ptr<Location>>::const_iterator location_it, std::string file_path)
+{
+    e_server_request_return nr = SRH_OK;
+    co_await ServerAioAwait(*scheduler_, client_data.fd, [&]() { nr = respondFromDisk(client_data, location_it, file_path); });
+    if (nr != SRH_OK)
+    {
+        client_data.keep_alive = false;
+        if (client_data.output.empty())
+            setupResponse(500, client_data);
+    }
+}
+
+/**
+ * @brief the milliseconds a coroutine may still wait before its deadline, at least 1 so it never waits without a timeout
+ *
+ * @param deadline the deadline in ServerTimerWheel::nowMs() time
+ * @return the milliseconds left
+ */
+uint64_t ServerResponseHandler::timeLeft(uint64_t deadline)
+{
+    uint64_t now = ServerTimerWheel::nowMs();
+    return deadline > now ? deadline - now : 1;
 }
 
 /**
  * @brief handles the response for the client if the location as a redirect/return
  * 
- * @param client_fd the file descriptor of the client
  * @param code the code that redirect/return has defined in its location
  * @param location where the redirect will go to
- * @return SRH_OK when response is send,
- * @return SRH_SEND_ERROR if send function has a error
+ * @param data the request data from the client
+ * @return SRH_OK when response is queued
  */
-e_server_request_return ServerResponseHandler::sendRedirectResponse(int client_fd, uint16_t code, std::string& location)
+e_server_request_return ServerResponseHandler::sendRedirectResponse(uint16_t code, std::string& location, s_client_data& data)
 {
     std::string status;
     if (status_codes_.find(code) != status_codes_.end())
@@ -581,14 +907,12 @@ e_server_request_return ServerResponseHandler::sendRedirectResponse(int client_f
 
     std::ostringstream response;
     response << "HTTP/1.1 " << status << "\r\n";
-    response << "Connection: close\r\n";
+    response << connectionHeader(data);
 
     response << "Content-Type: " << getContentType("x.html") << "\r\n";
     response << "Location: " << location << "\r\n";
     response << "Content-Length: 0\r\n\r\n";
-    
-    if (send(client_fd, response.str().c_str(), response.str().size(), 0) <= 0)
-        return SRH_SEND_ERROR;
+    data.output.append(response.str());
     return SRH_OK;
 }
 
@@ -663,13 +987,15 @@ void ServerResponseHandler::fillStatusCodes()
 }
 
 
-e_server_request_return ServerResponseHandler::removeFile(int client_fd, s_client_data& client_data)
+e_server_request_return ServerResponseHandler::removeFile(s_client_data& client_data)
 {
     if (!SRV_.fileExists(client_data.config_.get()->getRoot().substr(1) + client_data.request_source))
-        return setupResponse(client_fd, 404, client_data);
+        return setupResponse(404, client_data);
     if (!SRV_.filePermission(client_data.config_.get()->getRoot().substr(1) + client_data.request_source))
-        return setupResponse(client_fd, 403, client_data);
+        return setupResponse(403, client_data);
     if (!std::filesystem::remove(client_data.config_.get()->getRoot().substr(1) + client_data.request_source))
-        return setupResponse(client_fd, 500, client_data);
-    return setupResponse(client_fd, 200, client_data, "/");
+        return setupResponse(500, client_data);
+    if (file_cache_)
+        file_cache_->forget(client_data.config_.get()->getRoot().substr(1) + client_data.request_source);
+    return setupResponse(200, client_data, "/");
 }
\ No newline at end of file
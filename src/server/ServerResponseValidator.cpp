@@ -168,9 +168,10 @@ e_responeValReturn ServerResponseValidator::checkFile(std::string& file_path, st
         erased = true;
         file_path.erase(0, 1);
     }
-    if (fileExists(file_path))
+    s_file_info file = statFile(file_path);
+    if (file.found && S_ISREG(file.mode))
     {
-        if (filePermission(file_path))
+        if (file.mode & S_IROTH)
         {
             std::cout << "file_path: " << file_path << std::endl;
             if (erased)
@@ -182,9 +183,10 @@ e_responeValReturn ServerResponseValidator::checkFile(std::string& file_path, st
     }
     else if (location_it->get()->getAutoindex())
         return RVR_AUTO_INDEX_ON;
-    else if (fileExists(root_ + location_it->get()->getIndex()))
+    s_file_info index = statFile(root_ + location_it->get()->getIndex());
+    if (index.found && S_ISREG(index.mode))
     {
-        if (filePermission(root_ + location_it->get()->getIndex()))
+        if (index.mode & S_IROTH)
         {
             file_path = root_ + location_it->get()->getIndex();
             if (erased)
@@ -212,9 +214,8 @@ e_responeValReturn ServerResponseValidator::checkFile(std::string& file_path, st
  */
 bool ServerResponseValidator::filePermission(const std::string& path)
 {
-    struct stat buffer;
-    stat(path.c_str(), &buffer);
-    return buffer.st_mode & S_IROTH;
+    s_file_info file = statFile(path);
+    return file.found && (file.mode & S_IROTH);
 }
 
 /**
@@ -227,10 +228,10 @@ bool ServerResponseValidator::filePermission(const std::string& path)
  */
 e_responeValReturn ServerResponseValidator::checkAutoIndexing(std::vector<std::shared_ptr<Location>>::const_iterator& location_it)
 {
-    std::string path = root_.substr(1) + location_it->get()->getRoot();
-    if (!isDirectory(path))
+    s_file_info dir = statFile(root_.substr(1) + location_it->get()->getRoot());
+    if (!dir.found || !S_ISDIR(dir.mode))
         return RVR_NOT_FOUND;
-    if (!filePermission(path))
+    if (!(dir.mode & S_IROTH))
         return RVR_NO_FILE_PERMISSION;
     return RVR_SHOW_DIRECTORY;
 }
@@ -257,6 +258,26 @@ const std::string& ServerResponseValidator::getRoot() const
     return root_;
 }
 
+/**
+ * @brief gives the validator the open file cache of its server block
+ * 
+ * @param file_cache the cache, nullptr to stat() every path
+ */
+void ServerResponseValidator::setFileCache(std::shared_ptr<ServerFileCache> file_cache)
+{
+    file_cache_ = std::move(file_cache);
+}
+
+/**
+ * @brief gives the validator the bundle of its server block, a file in it is never stat()ed
+ * 
+ * @param bundle the bundle, nullptr to look every path up on disk
+ */
+void ServerResponseValidator::setBundle(std::shared_ptr<const ServerBundle> bundle)
+{
+    bundle_ = std::move(bundle);
+}
+
 // private functions
 
 /**
@@ -304,8 +325,38 @@ void ServerResponseValidator::setPossibleLocation(size_t token_size, std::vector
  */
 bool ServerResponseValidator::fileExists(const std::string& path)
 {
+    s_file_info file = statFile(path);
+    return file.found && S_ISREG(file.mode);
+}
+
+/**
+ * @brief stat()s a path once for every check on it, a file of the bundle is a readable regular file without a system call,
+ * anything else goes through the open file cache when there is one
+ * 
+ * @param path path to the file or directory
+ * @return what is known about the path, found is false if it does not exist
+ */
+s_file_info ServerResponseValidator::statFile(const std::string& path)
+{
+    const s_bundle_entry* entry = bundle_ ? bundle_->find(path) : nullptr;
+    if (entry != nullptr)
+    {
+        s_file_info file{};
+        file.found = true;
+        file.mode = S_IFREG | 0444;
+        file.size = entry->plain.body_length;
+        return file;
+    }
+    if (file_cache_)
+        return file_cache_->lookup(path);
+    s_file_info file{};
     struct stat buffer;
-    return stat(path.c_str(), &buffer) == 0 && S_ISREG(buffer.st_mode);
+    if (stat(path.c_str(), &buffer) == -1)
+        return file;
+    file.found = true;
+    file.mode = buffer.st_mode;
+    file.size = buffer.st_size;
+    return file;
 }
 
 void ServerResponseValidator::setPossibleRegexLocation(std::map<size_t, std::shared_ptr<Location>>& found_location, s_client_data& client_data)
@@ -0,0 +1,167 @@
+#include "server/ServerTimerWheel.hpp"
+#include <time.h>
+
+ServerTimerWheel::ServerTimerWheel() : slots_(TIMER_WHEEL_SLOTS, -1), count_(0)
+{
+    current_tick_ = nowMs() / TIMER_TICK_MS;
+};
+
+ServerTimerWheel::~ServerTimerWheel() {};
+
+/**
+ * @brief (re)starts the timer of a fd, a timer that is already running is replaced
+ * 
+ * @param fd the file descriptor the timer is for
+ * @param timeout_ms time until the timer expires in milliseconds
+ * @param phase in what phase the connection is, used to decide what to do on expiry
+ */
+void ServerTimerWheel::arm(int fd, uint64_t timeout_ms, e_timer_phase phase)
+{
+    if (static_cast<size_t>(fd) >= nodes_.size())
+        nodes_.resize(fd + 1 > 64 ? (fd + 1) * 2 : 64);
+    if (nodes_[fd].armed)
+        unlink(fd);
+    s_timer_node& node = nodes_[fd];
+    uint64_t deadline = (nowMs() + timeout_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    if (deadline < current_tick_)
+        deadline = current_tick_;
+    node.deadline_tick = deadline;
+    node.phase = phase;
+    node.armed = true;
+
+    int& head = slots_[deadline % TIMER_WHEEL_SLOTS];
+    node.prev = -1;
+    node.next = head;
+    if (head != -1)
+        nodes_[head].prev = fd;
+    head = fd;
+    ++count_;
+}
+
+/**
+ * @brief stops the timer of a fd
+ * 
+ * @param fd the file descriptor the timer is for
+ */
+void ServerTimerWheel::cancel(int fd)
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= nodes_.size() || !nodes_[fd].armed)
+        return;
+    unlink(fd);
+}
+
+/**
+ * @brief walks the slots from the last handled tick up to now and collects every fd
+ * that passed its deadline. Expired timers are disarmed but keep their phase
+ * 
+ * @param expired will hold the fds whose timer expired
+ */
+void ServerTimerWheel::expire(std::vector<int>& expired)
+{
+    uint64_t now_tick = nowMs() / TIMER_TICK_MS;
+    if (now_tick < current_tick_)
+        return;
+    uint64_t steps = now_tick - current_tick_ + 1;
+    if (steps > TIMER_WHEEL_SLOTS)
+        steps = TIMER_WHEEL_SLOTS;
+    for (uint64_t i = 0; i < steps; ++i)
+    {
+        int fd = slots_[(current_tick_ + i) % TIMER_WHEEL_SLOTS];
+        while (fd != -1)
+        {
+            int next = nodes_[fd].next;
+            if (nodes_[fd].deadline_tick <= now_tick)
+            {
+                unlink(fd);
+                expired.push_back(fd);
+            }
+            fd = next;
+        }
+    }
+    current_tick_ = now_tick + 1;
+}
+
+/**
+ * @brief calculates how long epoll_wait can sleep before the next slot with timers is due
+ * 
+ * @return the time in milliseconds,
+ * @return -1 if no timers are running
+ */
+int ServerTimerWheel::nextTimeout() const
+{
+    if (count_ == 0)
+        return -1;
+    uint64_t now = nowMs();
+    for (uint64_t i = 0; i < TIMER_WHEEL_SLOTS; ++i)
+    {
+        if (slots_[(current_tick_ + i) % TIMER_WHEEL_SLOTS] != -1)
+        {
+            uint64_t wake = (current_tick_ + i) * TIMER_TICK_MS;
+            if (wake <= now)
+                return 0;
+            return static_cast<int>(wake - now);
+        }
+    }
+    return -1;
+}
+
+/**
+ * @param fd the file descriptor the timer is for
+ * @return the phase the timer was last armed with
+ */
+e_timer_phase ServerTimerWheel::getPhase(int fd) const
+{
+    if (fd < 0 || static_cast<size_t>(fd) >= nodes_.size())
+        return TIMER_HEADER;
+    return nodes_[fd].phase;
+}
+
+/**
+ * @return the amount of running timers
+ */
+size_t ServerTimerWheel::size() const
+{
+    return count_;
+}
+
+// private functions
+
+/**
+ * @brief takes the timer of the fd out of its slot
+ * 
+ * @param fd the file descriptor the timer is for
+ */
+void ServerTimerWheel::unlink(int fd)
+{
+    s_timer_node& node = nodes_[fd];
+    if (node.prev != -1)
+        nodes_[node.prev].next = node.next;
+    else
+        slots_[node.deadline_tick % TIMER_WHEEL_SLOTS] = node.next;
+    if (node.next != -1)
+        nodes_[node.next].prev = node.prev;
+    node.prev = -1;
+    node.next = -1;
+    node.armed = false;
+    --count_;
+}
+
+/**
+ * @return the current monotonic time in milliseconds
+ */
+uint64_t ServerTimerWheel::nowMs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @return the current monotonic time in microseconds
+ */
+uint64_t ServerTimerWheel::nowUs()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
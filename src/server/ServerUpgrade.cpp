@@ -0,0 +1,201 @@
+#include "server/ServerUpgrade.hpp"
+#include "server/ServerListenFds.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <signal.h>
+
+extern char** environ;
+
+/**
+ * @brief remembers the binary the process runs, the upgrade executes whatever is installed there by then.
+ * A process that is itself started by a upgrade takes the fd it reports its startup on
+ *
+ * @param config_path the config file given at the start, nullptr for the default file
+ * @param workers the number of workers that have to finish before the old process exits
+ */
+ServerUpgrade::ServerUpgrade(const char* config_path, size_t workers) : config_path_(config_path), ready_fd_(-1), child_(-1), draining_(false), running_workers_(workers)
+{
+    char path[PATH_MAX];
+    ssize_t len = readlink("/proc/self/exe", path, sizeof(path) - 1);
+    if (len > 0)
+        binary_.assign(path, len);
+    const char* ready = std::getenv(UPGRADE_READY_ENV);
+    if (ready != nullptr)
+    {
+        ready_fd_ = static_cast<int>(std::strtol(ready, nullptr, 10));
+        fcntl(ready_fd_, F_SETFD, FD_CLOEXEC);
+    }
+    unsetenv(UPGRADE_READY_ENV);
+}
+
+ServerUpgrade::~ServerUpgrade()
+{
+    if (ready_fd_ != -1)
+        close(ready_fd_);
+};
+
+/**
+ * @brief starts the new process with the listening sockets.
+ * Everything the child needs is prepared before the fork,
+ * between fork and exec it only moves fds around and fills in its pid
+ *
+ * @param listeners the listening sockets, they become fd 3 and up in the new process
+ * @return the fd the startup of the new process is reported on,
+ * @return -1 if a upgrade is already running or the new process could not be started
+ */
+int ServerUpgrade::start(const std::vector<int>& listeners)
+{
+    if (child_ != -1 || draining_)
+    {
+        std::cerr << "a upgrade is already running\n";
+        return -1;
+    }
+    if (binary_.empty() || listeners.empty())
+        return -1;
+    int status_pipe[2];
+    if (pipe2(status_pipe, O_CLOEXEC | O_NONBLOCK) == -1)
+        return -1;
+
+    int count = static_cast<int>(listeners.size());
+    std::vector<std::string> env_strings;
+    for (char** env = environ; *env != nullptr; ++env)
+    {
+        if (std::strncmp(*env, "LISTEN_", 7) != 0 && std::strncmp(*env, UPGRADE_READY_ENV "=", sizeof(UPGRADE_READY_ENV)) != 0)
+            env_strings.push_back(*env);
+    }
+    env_strings.push_back("LISTEN_FDS=" + std::to_string(count));
+    env_strings.push_back(std::string(UPGRADE_READY_ENV) + "=" + std::to_string(LISTEN_FDS_START + count));
+    char listen_pid[32] = "LISTEN_PID=";
+    std::vector<char*> envp;
+    for (std::string& env : env_strings)
+        envp.push_back(env.data());
+    envp.push_back(listen_pid);
+    envp.push_back(nullptr);
+    std::vector<char*> argv;
+    argv.push_back(binary_.data());
+    if (config_path_ != nullptr)
+        argv.push_back(const_cast<char*>(config_path_));
+    argv.push_back(nullptr);
+    std::vector<int> copies(count + 1, -1);
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(status_pipe[0]);
+        close(status_pipe[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        // copy the fds above the range they go to first, so none is overwritten
+        int base = LISTEN_FDS_START + count + 1;
+        for (int i = 0; i < count; ++i)
+            copies[i] = fcntl(listeners[i], F_DUPFD, base);
+        copies[count] = fcntl(status_pipe[1], F_DUPFD, base);
+        for (int i = 0; i <= count; ++i)
+        {
+            if (copies[i] == -1 || dup2(copies[i], LISTEN_FDS_START + i) == -1)
+                _exit(127);
+        }
+        closefrom(base);
+        // the signals read from a signalfd here are blocked, the new process starts with none blocked
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigprocmask(SIG_SETMASK, &signals, nullptr);
+        // write the pid into LISTEN_PID without anything that allocates
+        char digits[16];
+        int len = 0;
+        for (pid_t self = getpid(); self > 0; self /= 10)
+            digits[len++] = static_cast<char>('0' + self % 10);
+        char* end = listen_pid + std::strlen(listen_pid);
+        while (len > 0)
+            *end++ = digits[--len];
+        *end = '\0';
+        execve(argv[0], argv.data(), envp.data());
+        _exit(127);
+    }
+    close(status_pipe[1]);
+    child_ = pid;
+    std::cerr << "started upgrade to " << binary_ << " as pid " << pid << "\n";
+    return status_pipe[0];
+}
+
+/**
+ * @brief reads the startup report of the new process. When it is ready this process starts draining,
+ * when it exited before that the upgrade is rolled back and this process keeps serving
+ *
+ * @param status_fd the fd returned by start, the caller closes it once the report is no longer pending
+ * @return UPGRADE_READY when the new process serves the listening sockets,
+ * @return UPGRADE_FAILED when the new process did not start,
+ * @return UPGRADE_PENDING when there is nothing to read yet
+ */
+e_upgrade_status ServerUpgrade::readStatus(int status_fd)
+{
+    char ready;
+    ssize_t len = read(status_fd, &ready, 1);
+    if (len == -1 && (errno == EAGAIN || errno == EINTR))
+        return UPGRADE_PENDING;
+    if (len == 1)
+    {
+        std::cerr << "upgrade pid " << child_ << " is ready, draining the old process\n";
+        draining_ = true;
+        return UPGRADE_READY;
+    }
+    int status = 0;
+    waitpid(child_, &status, 0);
+    std::cerr << "upgrade pid " << child_ << " failed to start, rolling back\n";
+    child_ = -1;
+    return UPGRADE_FAILED;
+}
+
+/**
+ * @brief tells the old process that this process is set up and takes over the listening sockets
+ */
+void ServerUpgrade::notifyReady()
+{
+    if (ready_fd_ == -1)
+        return;
+    char ready = 1;
+    if (write(ready_fd_, &ready, 1) != 1)
+        std::cerr << "reporting the upgrade as ready failed\n";
+    close(ready_fd_);
+    ready_fd_ = -1;
+}
+
+/**
+ * @brief drains the process without a new process taking over, the workers finish their clients and it exits
+ */
+void ServerUpgrade::stop()
+{
+    draining_ = true;
+}
+
+/**
+ * @return true once a new process took over, the workers stop accepting and finish their clients
+ */
+bool ServerUpgrade::draining() const
+{
+    return draining_;
+}
+
+/**
+ * @brief marks a worker as done with its clients after the upgrade
+ */
+void ServerUpgrade::finishWorker()
+{
+    --running_workers_;
+}
+
+/**
+ * @return true once every worker finished its clients, the process can exit
+ */
+bool ServerUpgrade::finished() const
+{
+    return running_workers_ == 0;
+}
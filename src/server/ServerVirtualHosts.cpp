@@ -0,0 +1,94 @@
+#include "server/ServerVirtualHosts.hpp"
+#include <cctype>
+
+/**
+ * @param default_server the index of the server block that gets the requests no name matches
+ * @param default_config the config of that server block
+ */
+ServerVirtualHosts::ServerVirtualHosts(size_t default_server, const std::shared_ptr<Config>& default_config)
+{
+    default_.server = default_server;
+    default_.config = default_config;
+}
+
+ServerVirtualHosts::~ServerVirtualHosts() {};
+
+/**
+ * @brief adds a server_name of a server block, the first server block with a name keeps it
+ *
+ * @param name a exact name, a name starting with "*." or a name ending with ".*",
+ * a name starting with "." is the same as the name itself and the name with "*." in front
+ * @param server the index of the server block
+ * @param config the config of the server block
+ */
+void ServerVirtualHosts::add(const std::string& name, size_t server, const std::shared_ptr<Config>& config)
+{
+    std::string key = normalize(name);
+    s_virtual_host host;
+    host.server = server;
+    host.config = config;
+    if (key.size() > 2 && key.compare(0, 2, "*.") == 0)
+        leading_.emplace(key.substr(2), host);
+    else if (key.size() > 1 && key[0] == '.')
+    {
+        exact_.emplace(key.substr(1), host);
+        leading_.emplace(key.substr(1), host);
+    }
+    else if (key.size() > 2 && key.compare(key.size() - 2, 2, ".*") == 0)
+        trailing_.emplace(key.substr(0, key.size() - 2), host);
+    else
+        exact_.emplace(key, host);
+}
+
+/**
+ * @brief looks up the server block for the value of a Host header
+ *
+ * @param host the Host header, it may hold a port and a trailing dot
+ * @return the matching server block, the default server if no name matches
+ */
+const s_virtual_host& ServerVirtualHosts::find(const std::string& host) const
+{
+    std::string key = normalize(host);
+    if (key.empty())
+        return default_;
+    auto exact = exact_.find(key);
+    if (exact != exact_.end())
+        return exact->second;
+    // a.b.example.com tries b.example.com, then example.com, then com
+    for (size_t dot = key.find('.'); !leading_.empty() && dot != std::string::npos; dot = key.find('.', dot + 1))
+    {
+        auto leading = leading_.find(key.substr(dot + 1));
+        if (leading != leading_.end())
+            return leading->second;
+    }
+    // www.example.com tries www.example, then www
+    for (size_t dot = key.rfind('.'); !trailing_.empty() && dot != std::string::npos && dot > 0; dot = key.rfind('.', dot - 1))
+    {
+        auto trailing = trailing_.find(key.substr(0, dot));
+        if (trailing != trailing_.end())
+            return trailing->second;
+    }
+    return default_;
+}
+
+// private functions
+
+/**
+ * @brief lower cases a host name and strips the port and the trailing dot
+ *
+ * @param host the host name
+ * @return the host as it is used as key
+ */
+std::string ServerVirtualHosts::normalize(const std::string& host)
+{
+    size_t start = host.find_first_not_of(" \t");
+    if (start == std::string::npos)
+        return "";
+    size_t end = host.find_first_of(": \t\r", start);
+    std::string key = host.substr(start, end == std::string::npos ? std::string::npos : end - start);
+    if (!key.empty() && key.back() == '.')
+        key.pop_back();
+    for (char& ch : key)
+        ch = std::tolower(static_cast<unsigned char>(ch));
+    return key;
+}
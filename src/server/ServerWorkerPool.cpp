@@ -0,0 +1,114 @@
+#include "server/ServerWorkerPool.hpp"
+#include <iostream>
+#include <thread>
+#include <sched.h>
+#include <signal.h>
+#include <unistd.h>
+
+/**
+ * @param configs the server blocks loaded at the start
+ * @param config_path the config file given at the start, nullptr for the default file
+ * @param listen_fds the inherited listening sockets, and those of the master process
+ * @param counters the counters the workers add to
+ * @param first_cpu the CPU the first worker is pinned to with worker_cpu_affinity
+ */
+ServerWorkerPool::ServerWorkerPool(std::vector<std::shared_ptr<Config>>& configs, const char* config_path, ServerListenFds& listen_fds, s_worker_counters& counters, size_t first_cpu) : listen_fds_(listen_fds), reload_(config_path, configs), upgrade_(config_path, configs[0]->getWorkerThreads()), aio_(configs[0]->getAioThreads()), first_cpu_(first_cpu)
+{
+    worker_count_ = configs[0]->getWorkerThreads();
+    pin_cpus_ = configs[0]->getWorkerCpuAffinity();
+    workers_.reserve(worker_count_);
+    for (size_t i = 0; i < worker_count_; ++i)
+        workers_.push_back(std::make_unique<Server>(reload_, listen_fds_, upgrade_, aio_, counters, i));
+}
+
+ServerWorkerPool::~ServerWorkerPool()
+{
+    stopWorkers();
+}
+
+/**
+ * @brief sets up the epoll of every worker and starts their event loops.
+ * The first worker runs on the calling thread, the others get their own thread.
+ * SIGHUP, SIGUSR2 and SIGQUIT are blocked before the threads start, the first worker reads them from a signalfd.
+ * A process started by a upgrade reports that it is ready once every worker is set up.
+ * When the first worker returns, after a drain or on a error, the other workers are stopped and joined
+ * 
+ * @return 0 when done,
+ * @return -1 on error,
+ * @return -2 on critical error
+ */
+int ServerWorkerPool::run()
+{
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGHUP);
+    sigaddset(&signals, SIGUSR2);
+    sigaddset(&signals, SIGQUIT);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    for (size_t i = 0; i < worker_count_; ++i)
+    {
+        int nr = workers_[i]->setupEpoll();
+        if (nr != 0)
+        {
+            std::cerr << "setting up worker " << i << " failed\n";
+            return nr;
+        }
+    }
+    upgrade_.notifyReady();
+    threads_.reserve(worker_count_ - 1);
+    for (size_t i = 1; i < worker_count_; ++i)
+    {
+        threads_.emplace_back([this, i]()
+        {
+            int nr = workers_[i]->serverLoop();
+            if (nr != 0)
+                std::cerr << "worker " << i << " stopped with " << nr << "\n";
+        });
+        if (pin_cpus_)
+            pinToCpu(threads_.back().native_handle(), i);
+    }
+    if (pin_cpus_)
+        pinToCpu(pthread_self(), 0);
+    int nr = workers_[0]->serverLoop();
+    stopWorkers();
+    return nr;
+}
+
+// private functions
+
+/**
+ * @brief stops the workers that still run and waits for their threads,
+ * a drained worker already left its loop and only gets joined
+ */
+void ServerWorkerPool::stopWorkers()
+{
+    for (size_t i = 0; i < threads_.size(); ++i)
+    {
+        if (threads_[i].joinable())
+            workers_[i + 1]->stop();
+    }
+    for (std::thread& thread : threads_)
+    {
+        if (thread.joinable())
+            thread.join();
+    }
+    threads_.clear();
+}
+
+/**
+ * @brief pins a worker thread to one CPU, workers wrap around when there are more workers than CPUs
+ * 
+ * @param thread the thread of the worker
+ * @param worker_id the number of the worker
+ */
+void ServerWorkerPool::pinToCpu(pthread_t thread, size_t worker_id)
+{
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus <= 0)
+        return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET((first_cpu_ + worker_id) % cpus, &set);
+    if (pthread_setaffinity_np(thread, sizeof(set), &set) != 0)
+        std::cerr << "pinning worker " << worker_id << " to a CPU failed\n";
+}